@@ -77,7 +77,7 @@ void call_subset(tmstring smeas, tmstring sdata_s, tmstring sdata_d) {
 }
 
 void call_simulate(tmstring sstim, tmstring ssys, tmstring sdata, fnum prec,
-                   inum maxiter, inum trace) {
+                   inum maxiter, inum nbroyden, inum cont, inum trace) {
     dbnode node;
     stimtemplate stimt;
     systemtemplate syst;
@@ -126,7 +126,8 @@ void call_simulate(tmstring sstim, tmstring ssys, tmstring sdata, fnum prec,
     write_numblock(numb, "simin.nb"); /* DEBUGGING CODE */
 #endif
 
-    if (simulate(numb, prec, maxiter, trace) == FALSE) {
+    if (simulate(numb, datat->data, prec, maxiter, nbroyden, cont, trace) ==
+        FALSE) {
         fputs("Simulation failed\n", error_stream);
     } else {
         fputs("Simulation done\n", error_stream);
@@ -141,7 +142,8 @@ void call_simulate(tmstring sstim, tmstring ssys, tmstring sdata, fnum prec,
 }
 
 void call_extract(tmstring ssys, tmstring sdata, fnum prec, fnum tol,
-                  opttype opt, fnum sens, inum maxiter, inum trace) {
+                  opttype opt, fnum sens, inum maxiter, inum nprune,
+                  inum nstart, inum trace) {
     dbnode node;
     systemtemplate syst;
     datatemplate datat;
@@ -175,7 +177,8 @@ void call_extract(tmstring ssys, tmstring sdata, fnum prec, fnum tol,
     write_numblock(numb, "extin.nb"); /* DEBUGGING CODE */
 #endif
 
-    if (extract(numb, prec, tol, opt, sens, maxiter, trace) == FALSE) {
+    if (extract(numb, prec, tol, opt, sens, maxiter, nprune, nstart, trace) ==
+        FALSE) {
         fputs("Extraction failed\n", error_stream);
     } else {
         fputs("Extraction done\n", error_stream);
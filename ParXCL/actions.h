@@ -32,10 +32,12 @@ extern void show_status(void);
 extern void call_subset(tmstring smeas, tmstring sdata_s, tmstring sdata_d);
 
 extern void call_simulate(tmstring sstim, tmstring ssys, tmstring sdata,
-                          fnum prec, inum maxiter, inum trace);
+                          fnum prec, inum maxiter, inum nbroyden, inum cont,
+                          inum trace);
 
 extern void call_extract(tmstring ssys, tmstring sdata, fnum prec, fnum tol,
-                         opttype opt, fnum sens, inum maxiter, inum trace);
+                         opttype opt, fnum sens, inum maxiter, inum nprune,
+                         inum nstart, inum trace);
 
 extern void print(parxsymbol_list sl, tmstring fname);
 extern void plot(parxsymbol_list sl, tmstring fname);
@@ -0,0 +1,427 @@
+/*
+ * ParX - binio.c
+ * Binary I/O for data tables
+ *
+ * Copyright (c) 2026 M.G.Middelhoek <martin@middelhoek.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "binio.h"
+#include "datatpl.h"
+#include "error.h"
+#include "parx.h"
+
+#include <stdint.h>
+
+#if defined(WINDOWS) || defined(WIN32) || defined(WIN64)
+#define BIN_NOMAP /* read the file into memory */
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define BIN_MAGIC "ParXdat" /* 8 bytes with the terminating zero */
+#define BIN_HEAD 32         /* size of the fixed header */
+#define BIN_PAD(n) (((n) + 7) & ~(size_t)7)
+
+/***********************************************************************/
+
+/* little-endian encoding, independent of the host byte order */
+
+static void bin_put32(unsigned char *p, uint32_t v) {
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static void bin_put64(unsigned char *p, uint64_t v) {
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static uint32_t bin_get32(const unsigned char *p) {
+    return ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+            ((uint32_t)p[3] << 24));
+}
+
+static uint64_t bin_get64(const unsigned char *p) {
+    return ((uint64_t)bin_get32(p) | ((uint64_t)bin_get32(p + 4) << 32));
+}
+
+static void bin_putf(unsigned char *p, fnum f) {
+    double d;
+    uint64_t v;
+
+    d = (double)f;
+    memcpy(&v, &d, sizeof(v));
+    bin_put64(p, v);
+}
+
+static fnum bin_getf(const unsigned char *p) {
+    double d;
+    uint64_t v;
+
+    v = bin_get64(p);
+    memcpy(&d, &v, sizeof(d));
+    return ((fnum)d);
+}
+
+/* write n bytes of string s, padded with zeros to a multiple of 8 */
+
+static void bin_string(FILE *fp, const char *s, size_t n) {
+    static const char zero[8] = {0};
+
+    fwrite(s, 1, n, fp);
+    fwrite(zero, 1, BIN_PAD(n) - n, fp);
+}
+
+/***********************************************************************/
+
+/*
+ * Make the file contents available. The pages of a mapped file are shared
+ * between processes until they are written, writes stay private.
+ */
+
+static unsigned char *bin_map(FILE *fp, size_t *len) {
+#ifdef BIN_NOMAP
+    unsigned char *p;
+    long n;
+
+    fseek(fp, 0, SEEK_END);
+    n = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (n <= 0) {
+        return (NULL);
+    }
+    p = TM_MALLOC(unsigned char *, (size_t)n);
+    if (fread(p, 1, (size_t)n, fp) != (size_t)n) {
+        TM_FREE(p);
+        return (NULL);
+    }
+    *len = (size_t)n;
+    return (p);
+#else
+    struct stat st;
+    void *p;
+
+    if ((fstat(fileno(fp), &st) != 0) || (st.st_size <= 0)) {
+        return (NULL);
+    }
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+             fileno(fp), 0);
+    if (p == MAP_FAILED) {
+        return (NULL);
+    }
+    *len = (size_t)st.st_size;
+    return ((unsigned char *)p);
+#endif
+}
+
+static void bin_unmap(unsigned char *p, size_t len) {
+#ifdef BIN_NOMAP
+    TM_FREE(p);
+#else
+    munmap((void *)p, len);
+#endif
+}
+
+/* files whose columns are referenced by data tables */
+
+typedef struct _binmap {
+    unsigned char *p;     /* file contents */
+    size_t len;           /* length of the file */
+    inum refs;            /* number of referencing columns */
+    struct _binmap *next; /* next file */
+} binmap;
+
+static binmap *bin_maps = NULL;
+
+static void bin_keep(unsigned char *p, size_t len, inum refs) {
+    binmap *m;
+
+    m = TM_MALLOC(binmap *, sizeof(binmap));
+    m->p = p;
+    m->len = len;
+    m->refs = refs;
+    m->next = bin_maps;
+    bin_maps = m;
+}
+
+/**
+ * Release the storage array of a column matrix of a data table. A file that
+ * is no longer referenced is unmapped.
+ *
+ * @param arr storage array
+ * @return the array is part of a mapped file, not allocated
+ */
+boolean release_data_bin(fnumarray arr) {
+    binmap **mp, *m;
+    unsigned char *p;
+
+    p = (unsigned char *)arr;
+    for (mp = &bin_maps; *mp != NULL; mp = &(*mp)->next) {
+        m = *mp;
+        if ((p >= m->p) && (p < m->p + m->len)) {
+            if (--m->refs == 0) {
+                *mp = m->next;
+                bin_unmap(m->p, m->len);
+                TM_FREE(m);
+            }
+            return (TRUE);
+        }
+    }
+    return (FALSE);
+}
+
+/* the file holds the fnums of this host, they can be used in place */
+
+static boolean bin_native(void) {
+    unsigned char p[8];
+    fnum f;
+
+    f = -1.5;
+    bin_putf(p, f);
+    return (((sizeof(fnum) == 8) && (memcmp(p, &f, 8) == 0)) ? TRUE : FALSE);
+}
+
+/* column matrix of nrow by ncol entries in place at p */
+
+static matrix bin_matrix(unsigned char *p, inum nrow, inum ncol) {
+    fnumarray arr;
+    fnumindex idx;
+    inum c;
+
+    arr = (fnumarray)p;
+    idx = new_fnumindex(ncol);
+    for (c = 0; c < ncol; c++) {
+        idx[c] = arr + c * nrow;
+    }
+    return (new_matrix(nrow * ncol, arr, nrow, ncol, idx));
+}
+
+/***********************************************************************/
+
+/**
+ * Write a datatemplate to a file in binary format
+ *
+ * @param fp file, opened in binary mode
+ * @param dt datatemplate
+ */
+void write_data_bin(FILE *fp, datatemplate dt) {
+    colhead_list h;
+    datacolumns dc;
+    unsigned char head[BIN_HEAD], *col;
+    size_t n;
+    inum nrow, ncol, r, c;
+
+    dc = dt->data;
+    for (h = dt->header, ncol = 0; h != colheadNIL; h = h->next) {
+        ncol++;
+    }
+    nrow = MATM(dc->val);
+
+    n = strlen(dt->info);
+
+    memset(head, 0, BIN_HEAD);
+    memcpy(head, BIN_MAGIC, sizeof(BIN_MAGIC));
+    bin_put32(head + 8, BIN_VERSION);
+    bin_put32(head + 12, (uint32_t)ncol);
+    bin_put64(head + 16, (uint64_t)nrow);
+    bin_put32(head + 24, (uint32_t)n);
+    fwrite(head, 1, BIN_HEAD, fp);
+    bin_string(fp, dt->info, n);
+
+    for (h = dt->header; h != colheadNIL; h = h->next) {
+        n = strlen(h->name);
+        bin_put32(head, (uint32_t)h->type);
+        bin_put32(head + 4, (uint32_t)n);
+        fwrite(head, 1, 8, fp);
+        bin_string(fp, h->name, n);
+    }
+
+    /* the columns are written one after the other, missing ones as zero */
+
+    col = TM_MALLOC(unsigned char *, MAX(nrow, 1) * 8);
+
+    for (r = 0; r < nrow; r++) {
+        bin_put64(col + 8 * r, (uint64_t)(int64_t)VEC(dc->grpid, r));
+    }
+    fwrite(col, 8, (size_t)nrow, fp);
+    for (r = 0; r < nrow; r++) {
+        bin_put64(col + 8 * r, (uint64_t)(int64_t)VEC(dc->crvid, r));
+    }
+    fwrite(col, 8, (size_t)nrow, fp);
+    for (r = 0; r < nrow; r++) {
+        bin_put64(col + 8 * r, (uint64_t)(int64_t)VEC(dc->rowid, r));
+    }
+    fwrite(col, 8, (size_t)nrow, fp);
+
+    for (c = 0; c < ncol; c++) {
+        for (r = 0; r < nrow; r++) {
+            bin_putf(col + 8 * r,
+                     (c < MATN(dc->val)) ? MAT(dc->val, r, c) : 0.0);
+        }
+        fwrite(col, 8, (size_t)nrow, fp);
+    }
+    for (c = 0; c < ncol; c++) {
+        for (r = 0; r < nrow; r++) {
+            bin_putf(col + 8 * r,
+                     (c < MATN(dc->err)) ? MAT(dc->err, r, c) : 0.0);
+        }
+        fwrite(col, 8, (size_t)nrow, fp);
+    }
+
+    TM_FREE(col);
+}
+
+/**
+ * Read a datatemplate from a file in binary format. The file is mapped into
+ * memory and the value and error columns of the table are the mapped
+ * columns, on a host with other fnums they are converted. The file stays
+ * mapped until the columns are released.
+ *
+ * @param fp file, opened in binary mode
+ * @param dt datatemplate
+ * @return success
+ */
+inum read_data_bin(FILE *fp, datatemplate *dt) {
+    unsigned char *map, *ids, *val, *err;
+    size_t len, pos, n;
+    uint64_t nrow;
+    uint32_t ncol, type;
+    char *s;
+    datacolumns dc;
+    inum r, c;
+
+    if ((map = bin_map(fp, &len)) == NULL) {
+        sprintf(tm_errmsg, "unable to map binary data table");
+        return (1);
+    }
+
+    if ((len < BIN_HEAD) ||
+        (memcmp(map, BIN_MAGIC, sizeof(BIN_MAGIC)) != 0)) {
+        sprintf(tm_errmsg, "not a binary data table");
+        bin_unmap(map, len);
+        return (1);
+    }
+
+    if (bin_get32(map + 8) != BIN_VERSION) {
+        sprintf(tm_errmsg, "unsupported binary data table version %lu",
+                (unsigned long)bin_get32(map + 8));
+        bin_unmap(map, len);
+        return (1);
+    }
+
+    ncol = bin_get32(map + 12);
+    nrow = bin_get64(map + 16);
+    n = (size_t)bin_get32(map + 24);
+    pos = BIN_HEAD;
+
+    if (BIN_PAD(n) > len - pos) {
+        sprintf(tm_errmsg, "binary data table truncated");
+        bin_unmap(map, len);
+        return (1);
+    }
+
+    s = TM_MALLOC(char *, n + 1);
+    memcpy(s, map + pos, n);
+    s[n] = '\0';
+    *dt = new_datatemplate(new_tmstring(s), new_colhead_list(),
+                           datacolumnsNIL);
+    TM_FREE(s);
+    pos += BIN_PAD(n);
+
+    /* column headers */
+
+    for (c = 0; c < (inum)ncol; c++) {
+        if (8 > len - pos) {
+            break;
+        }
+        type = bin_get32(map + pos);
+        n = (size_t)bin_get32(map + pos + 4);
+        pos += 8;
+        if (type > ERR) {
+            sprintf(tm_errmsg, "bad column type %lu in binary data table",
+                    (unsigned long)type);
+            bin_unmap(map, len);
+            rfre_datatemplate(*dt);
+            *dt = datatemplateNIL;
+            return (1);
+        }
+        if (BIN_PAD(n) > len - pos) {
+            break;
+        }
+        s = TM_MALLOC(char *, n + 1);
+        memcpy(s, map + pos, n);
+        s[n] = '\0';
+        (*dt)->header = append_colhead_list(
+            (*dt)->header, new_colhead(new_tmstring(s), (stateflag)type));
+        TM_FREE(s);
+        pos += BIN_PAD(n);
+    }
+
+    if ((c < (inum)ncol) ||
+        (nrow > (len - pos) / (8 * (3 + 2 * (size_t)ncol)))) {
+        sprintf(tm_errmsg, "binary data table truncated");
+        bin_unmap(map, len);
+        rfre_datatemplate(*dt);
+        *dt = datatemplateNIL;
+        return (1);
+    }
+
+    ids = map + pos;
+    val = ids + 3 * 8 * nrow;
+    err = val + 8 * (size_t)ncol * nrow;
+
+    if ((nrow > 0) && (ncol > 0) && (bin_native() == TRUE)) {
+        /* the table refers to the mapped columns */
+        dc = new_datacolumns(bin_matrix(val, (inum)nrow, (inum)ncol),
+                             bin_matrix(err, (inum)nrow, (inum)ncol),
+                             rnew_inumvector((inum)nrow),
+                             rnew_inumvector((inum)nrow),
+                             rnew_inumvector((inum)nrow));
+    } else {
+        /* the columns are converted */
+        dc = rnew_datacolumns((inum)nrow, (inum)ncol);
+        for (c = 0; c < (inum)ncol; c++) {
+            for (r = 0; r < (inum)nrow; r++) {
+                MAT(dc->val, r, c) = bin_getf(val + 8 * (c * nrow + r));
+                MAT(dc->err, r, c) = bin_getf(err + 8 * (c * nrow + r));
+            }
+        }
+    }
+    (*dt)->data = dc;
+
+    /* the identification numbers are always copied */
+
+    for (r = 0; r < (inum)nrow; r++) {
+        VEC(dc->grpid, r) = (inum)(int64_t)bin_get64(ids + 8 * r);
+        VEC(dc->crvid, r) = (inum)(int64_t)bin_get64(ids + 8 * (nrow + r));
+        VEC(dc->rowid, r) = (inum)(int64_t)bin_get64(ids + 8 * (2 * nrow + r));
+    }
+
+    if (MATA(dc->val) == (fnumarray)val) {
+        bin_keep(map, len, 2); /* referenced by val and err */
+    } else {
+        bin_unmap(map, len);
+    }
+
+    return (0);
+}
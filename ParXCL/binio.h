@@ -0,0 +1,50 @@
+/*
+ * ParX - binio.h
+ * Binary I/O for data tables
+ *
+ * Copyright (c) 2026 M.G.Middelhoek <martin@middelhoek.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BINIO_H
+#define __BINIO_H
+
+#include "datastruct.h"
+#include "primtype.h"
+
+/*
+ * Binary data table file, all numbers little-endian, every section starts
+ * at a multiple of 8 bytes:
+ *
+ *   magic    8 bytes  "ParXdat\0"
+ *   version  uint32   BIN_VERSION
+ *   ncol     uint32   number of columns
+ *   nrow     uint64   number of rows
+ *   ninfo    uint32   length of the info string, followed by 4 zero bytes
+ *   info     ninfo bytes, padded with zeros
+ *   header   ncol times: type uint32 (stateflag), length uint32, name bytes,
+ *            padded with zeros
+ *   ids      int64 grpid[nrow], crvid[nrow], rowid[nrow]
+ *   values   double val[ncol][nrow], column after column
+ *   errors   double err[ncol][nrow], column after column
+ */
+
+#define BIN_VERSION 1
+
+extern void write_data_bin(FILE *fp, datatemplate dt);
+extern inum read_data_bin(FILE *fp, datatemplate *dt);
+extern boolean release_data_bin(fnumarray arr);
+
+#endif
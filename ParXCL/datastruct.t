@@ -94,18 +94,23 @@
 .append wantdefs new_syspar_list
 .. 
 ..
-.append wantdefs rfre_datatemplate fscan_datatemplate print_datatemplate
-.append wantdefs rdup_datatemplate
+.append wantdefs rfre_datatemplate rdup_datatemplate
+.. the text form of a data table is printed and scanned by datatpl.c
+.append notwantdefs print_datatemplate fscan_datatemplate
+.append notwantdefs print_datacolumns fscan_datacolumns
+.. the columns of a data table can be mapped from a file, see datatpl.c
+.append notwantdefs rfre_datacolumns
 ..
 .append wantdefs new_colhead_list rdup_colhead
 .append wantdefs rdup_colhead_list
 .append wantdefs append_colhead_list
 ..
+.append wantdefs rfre_datatext fscan_datatext print_datatext
 .append wantdefs new_datarow_list
 .append wantdefs append_datarow_list
 .append wantdefs rfre_datarow
-.append wantdefs rdup_datarow
 .append wantdefs print_datarow
+.append wantdefs fre_datacolumns
 ..
 ..
 .append wantdefs rfre_numblock
@@ -114,6 +119,7 @@
 .append wantdefs rfre_xgroup
 .append wantdefs append_xgroup_list
 .append wantdefs new_xgroup_list
+.append wantdefs rdup_xgroup_list rfre_xgroup_list
 ..set notwantdefs aset_list cset_list fset_list pset_list xset_list
 ..
 ..
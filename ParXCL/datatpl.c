@@ -17,6 +17,7 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include "binio.h"
 #include "datatpl.h"
 #include "parx.h"
 
@@ -32,22 +33,233 @@ colhead find_header(colhead_list l, tmstring name) {
     return (colheadNIL);
 }
 
-/* find a datarow by its rowid, searches are in partial order */
+/*
+ * The columns of a data table are its storage. A column of val and err
+ * holds one entry of all rows, contiguous, with room for more rows. The
+ * row-wise datatext form is only built to print or scan the TM text form.
+ */
+
+#define DATA_ROOM 64 /* initial room for rows */
+
+/* new data table columns, nrow rows of ncol zero entries */
+
+datacolumns rnew_datacolumns(inum nrow, inum ncol) {
+    datacolumns dc;
+
+    dc = new_datacolumns(rnew_matrix(nrow, ncol), rnew_matrix(nrow, ncol),
+                         rnew_inumvector(nrow), rnew_inumvector(nrow),
+                         rnew_inumvector(nrow));
+    return (dc);
+}
+
+/* free a column matrix, its storage may be part of a mapped file */
+
+static void rfre_column(matrix m) {
+    if (m == matrixNIL) {
+        return;
+    }
+    if (release_data_bin(MATA(m)) == TRUE) {
+        fre_fnumindex(MATI(m));
+        fre_matrix(m);
+    } else {
+        rfre_matrix(m);
+    }
+}
+
+/**
+ * Free the columns of a data table.
+ *
+ * @param dc data columns
+ */
+void rfre_datacolumns(datacolumns dc) {
+    if (dc == datacolumnsNIL) {
+        return;
+    }
+    rfre_column(dc->val);
+    rfre_column(dc->err);
+    rfre_inumvector(dc->grpid);
+    rfre_inumvector(dc->crvid);
+    rfre_inumvector(dc->rowid);
+    fre_datacolumns(dc);
+}
+
+/* make room for szm rows and szn columns, the entries are kept */
+
+static void room_datacolumns(datacolumns dc, inum szm, inum szn) {
+    matrix val, err;
+    inumvector grpid, crvid, rowid;
+    inum nrow, ncol, r, j;
+
+    nrow = MATM(dc->val);
+    ncol = MATN(dc->val);
+
+    val = rnew_matrix(szm, szn);
+    err = rnew_matrix(szm, szn);
+    MATM(val) = MATM(err) = nrow;
+    MATN(val) = MATN(err) = ncol;
+
+    for (j = 0; j < ncol; j++) {
+        for (r = 0; r < nrow; r++) {
+            MAT(val, r, j) = MAT(dc->val, r, j);
+            MAT(err, r, j) = MAT(dc->err, r, j);
+        }
+    }
+
+    grpid = rnew_inumvector(szm);
+    crvid = rnew_inumvector(szm);
+    rowid = rnew_inumvector(szm);
+    VECN(grpid) = VECN(crvid) = VECN(rowid) = nrow;
+
+    for (r = 0; r < nrow; r++) {
+        VEC(grpid, r) = VEC(dc->grpid, r);
+        VEC(crvid, r) = VEC(dc->crvid, r);
+        VEC(rowid, r) = VEC(dc->rowid, r);
+    }
+
+    rfre_column(dc->val);
+    rfre_column(dc->err);
+    rfre_inumvector(dc->grpid);
+    rfre_inumvector(dc->crvid);
+    rfre_inumvector(dc->rowid);
+    dc->val = val;
+    dc->err = err;
+    dc->grpid = grpid;
+    dc->crvid = crvid;
+    dc->rowid = rowid;
+}
+
+/* add a row of zero entries to the columns, returns its index */
+
+inum add_datarow(datacolumns dc, inum grpid, inum crvid, inum rowid) {
+    inum r, j;
+
+    r = MATM(dc->val);
+    if (r >= MATSM(dc->val)) { /* double the room */
+        room_datacolumns(dc, MAX(2 * r, DATA_ROOM), MATSN(dc->val));
+    }
+
+    MATM(dc->val) = MATM(dc->err) = r + 1;
+    VECN(dc->grpid) = VECN(dc->crvid) = VECN(dc->rowid) = r + 1;
+
+    VEC(dc->grpid, r) = grpid;
+    VEC(dc->crvid, r) = crvid;
+    VEC(dc->rowid, r) = rowid;
 
-datarow find_datarow(datarow_list l, datarow_list last, inum id) {
-    datarow r;
+    for (j = 0; j < MATN(dc->val); j++) {
+        MAT(dc->val, r, j) = 0.0;
+        MAT(dc->err, r, j) = 0.0;
+    }
+    return (r);
+}
+
+/* add a column of zero entries, returns its index */
+
+inum add_datacolumn(datacolumns dc) {
+    inum r, j;
+
+    j = MATN(dc->val);
+    if (j >= MATSN(dc->val)) {
+        room_datacolumns(dc, MATSM(dc->val), j + 1);
+    }
+
+    MATN(dc->val) = MATN(dc->err) = j + 1;
+
+    for (r = 0; r < MATM(dc->val); r++) {
+        MAT(dc->val, r, j) = 0.0;
+        MAT(dc->err, r, j) = 0.0;
+    }
+    return (j);
+}
+
+/* row-wise text form of data table dt */
+
+static datatext dat2text(datatemplate dt) {
+    datacolumns dc;
+    datarow_list data, tail;
+    datarow dr;
+    inum r, j;
 
-    /* start by searching the remainder of the list */
-    for (r = last; r != datarowNIL; r = r->next) {
-        if (id == r->rowid) {
-            return (r);
+    dc = dt->data;
+    data = tail = datarowNIL;
+
+    for (r = 0; r < MATM(dc->val); r++) {
+        dr = new_datarow(VEC(dc->grpid, r), VEC(dc->crvid, r),
+                         VEC(dc->rowid, r),
+                         room_fnum_list(new_fnum_list(), MATN(dc->val)),
+                         room_fnum_list(new_fnum_list(), MATN(dc->val)));
+        for (j = 0; j < MATN(dc->val); j++) {
+            dr->row = append_fnum_list(dr->row, MAT(dc->val, r, j));
+            dr->err = append_fnum_list(dr->err, MAT(dc->err, r, j));
+        }
+        if (tail == datarowNIL) { /* append in constant time */
+            data = dr;
+        } else {
+            tail->next = dr;
         }
+        tail = dr;
     }
-    /* search top part */
-    for (r = l; r != last; r = r->next) {
-        if (id == r->rowid) {
-            return (r);
+
+    return (new_datatext(rdup_tmstring(dt->info),
+                         rdup_colhead_list(dt->header), data));
+}
+
+/* data table of text form tx, missing entries are zero */
+
+static datatemplate text2dat(datatext tx) {
+    datacolumns dc;
+    colhead h;
+    datarow dr;
+    inum ncol, r, j;
+
+    for (h = tx->header, ncol = 0; h != colheadNIL; h = h->next) {
+        ncol++;
+    }
+    for (dr = tx->data; dr != datarowNIL; dr = dr->next) {
+        ncol = MAX(ncol, MAX(LSTS(dr->row), LSTS(dr->err)));
+    }
+
+    dc = rnew_datacolumns(0, ncol);
+
+    for (dr = tx->data; dr != datarowNIL; dr = dr->next) {
+        r = add_datarow(dc, dr->grpid, dr->crvid, dr->rowid);
+        for (j = 0; j < LSTS(dr->row); j++) {
+            MAT(dc->val, r, j) = LST(dr->row, j);
         }
+        for (j = 0; j < LSTS(dr->err); j++) {
+            MAT(dc->err, r, j) = LST(dr->err, j);
+        }
+    }
+
+    return (new_datatemplate(rdup_tmstring(tx->info),
+                             rdup_colhead_list(tx->header), dc));
+}
+
+/* print data table t in its row-wise TM text form */
+
+void print_datatemplate(TMPRINTSTATE *st, const datatemplate t) {
+    datatext tx;
+
+    if (t == datatemplateNIL) {
+        print_datatext(st, datatextNIL);
+        return;
+    }
+    tx = dat2text(t);
+    print_datatext(st, tx);
+    rfre_datatext(tx);
+}
+
+/* scan a data table from its row-wise TM text form */
+
+int fscan_datatemplate(FILE *f, datatemplate *p) {
+    datatext tx;
+    int err;
+
+    *p = datatemplateNIL;
+    tx = datatextNIL;
+    err = fscan_datatext(f, &tx);
+    if ((err == 0) && (tx != datatextNIL)) {
+        *p = text2dat(tx);
     }
-    return (datarowNIL);
+    rfre_datatext(tx);
+    return (err);
 }
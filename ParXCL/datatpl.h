@@ -24,6 +24,8 @@
 #include "primtype.h"
 
 extern colhead find_header(colhead_list l, tmstring name);
-extern datarow find_datarow(datarow_list l, datarow_list last, inum id);
+extern datacolumns rnew_datacolumns(inum nrow, inum ncol);
+extern inum add_datarow(datacolumns dc, inum grpid, inum crvid, inum rowid);
+extern inum add_datacolumn(datacolumns dc);
 
 #endif
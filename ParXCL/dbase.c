@@ -382,7 +382,7 @@ void dec_data(tmstring name) {
     dbnode dtab;
 
     dt = new_datatemplate(new_tmstring(""), new_colhead_list(),
-                          new_datarow_list());
+                          rnew_datacolumns(0, 0));
     dtab = new_Datatable(new_tmstring(name), dt);
     dbase = append_dbnode_list(dbase, dtab);
 }
@@ -18,10 +18,14 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include "binio.h"
 #include "dbio.h"
 #include "error.h"
 #include "jsonio.h"
 #include "parx.h"
+#include "prx_def.h"
+
+#include <sys/stat.h>
 
 static char buf[1024]; /* filename buffer */
 
@@ -238,6 +242,59 @@ codefile get_modelcode(tmstring fname) {
     return (fp);
 }
 
+/* locate a compiled model plugin, returns NIL if there is none or if it
+   is older than the model source next to it, hash is set to the hash of
+   that source */
+
+tmstring find_modelplugin(tmstring fname, unsigned long long *hash) {
+    FILE *fp;
+    struct stat ps, ms;
+
+    set_path(fname);
+    strcat(buf, find_basename(fname));
+    cut_extention();
+    strcat(buf, MODEL_PLUGIN_EXT);
+
+    if ((fp = fopen(buf, "rb")) == NULL) { /* check if plugin is present */
+
+        if (absolute_path(fname) == FALSE) { /* relative path */
+            strcpy(buf, parx_path);
+            if (strlen(buf) != 0 &&
+                strncmp(buf + strlen(buf) - 1, PATH_SEP, 1) != 0) {
+                strcat(buf, PATH_SEP);
+            }
+            strcat(buf, model_path);
+            if (strlen(buf) != 0 &&
+                strncmp(buf + strlen(buf) - 1, PATH_SEP, 1) != 0) {
+                strcat(buf, PATH_SEP);
+            }
+            strcat(buf, fname);
+            cut_extention();
+            strcat(buf, MODEL_PLUGIN_EXT);
+
+            fp = fopen(buf, "rb");
+        }
+    }
+    if (fp == NULL) {
+        return (tmstringNIL);
+    }
+    fclose(fp);
+
+    if (stat(buf, &ps) != 0) {
+        return (tmstringNIL);
+    }
+    cut_extention();
+    strcat(buf, MODEL_EXT);
+    if (stat(buf, &ms) != 0 || ms.st_mtime > ps.st_mtime ||
+        !prx_hash(buf, hash)) {
+        return (tmstringNIL);
+    }
+    cut_extention();
+    strcat(buf, MODEL_PLUGIN_EXT);
+
+    return (buf);
+}
+
 systemtemplate get_system(tmstring fname) {
     FILE *fp;
     systemtemplate st;
@@ -278,6 +335,7 @@ datatemplate get_datatable(tmstring fname) {
     boolean pxd = FALSE;
     boolean csv = FALSE;
     boolean json = FALSE;
+    boolean bin = FALSE;
     extern inum readcsv(FILE *, datatemplate);
 
     set_path(fname);
@@ -294,6 +352,8 @@ datatemplate get_datatable(tmstring fname) {
             csv = TRUE;
         } else if (strcmp(dot, JSON_EXT) == 0) {
             json = TRUE;
+        } else if (strcmp(dot, BINARY_EXT) == 0) {
+            bin = TRUE;
         } else {
             errcode = NO_FILE_PERR;
             error(fname);
@@ -301,7 +361,7 @@ datatemplate get_datatable(tmstring fname) {
         }
     }
 
-    if ((fp = fopen(buf, "r")) == NULL) {
+    if ((fp = fopen(buf, bin ? "rb" : "r")) == NULL) {
         errcode = NO_FILE_PERR;
         error(buf);
         return (datatemplateNIL);
@@ -321,7 +381,8 @@ datatemplate get_datatable(tmstring fname) {
             dt = datatemplateNIL;
         }
     } else if (csv) { /* read .csv file */
-        dt = new_datatemplate(new_tmstring(buf), colheadNIL, datarowNIL);
+        dt = new_datatemplate(new_tmstring(buf), colheadNIL,
+                              rnew_datacolumns(0, 0));
         if (readcsv(fp, dt)) {
             errcode = TMERROR_PERR;
             sprintf(error_mesg, "%s {%d}: %s", buf, tm_lineno, tm_errmsg);
@@ -337,6 +398,14 @@ datatemplate get_datatable(tmstring fname) {
             rfre_datatemplate(dt);
             dt = datatemplateNIL;
         }
+    } else if (bin) { /* map .pxb file */
+        if (read_data_bin(fp, &dt)) {
+            errcode = TMERROR_PERR;
+            sprintf(error_mesg, "%s: %s", buf, tm_errmsg);
+            error(error_mesg);
+            rfre_datatemplate(dt);
+            dt = datatemplateNIL;
+        }
     }
 
     fclose(fp);
@@ -396,9 +465,11 @@ void put_datatable(datatemplate dt, tmstring fname) {
     FILE *fp;
     TMPRINTSTATE *pst;
     char *dot;
+    char tmp[sizeof(buf) + 1];
     boolean pxd = FALSE;
     boolean csv = FALSE;
     boolean json = FALSE;
+    boolean bin = FALSE;
 
     set_path(fname);
     strcat(buf, find_basename(fname));
@@ -414,6 +485,8 @@ void put_datatable(datatemplate dt, tmstring fname) {
             csv = TRUE;
         } else if (strcmp(dot, JSON_EXT) == 0) {
             json = TRUE;
+        } else if (strcmp(dot, BINARY_EXT) == 0) {
+            bin = TRUE;
         } else {
             errcode = NO_FILE_PERR;
             error(fname);
@@ -421,9 +494,18 @@ void put_datatable(datatemplate dt, tmstring fname) {
         }
     }
 
-    if ((fp = fopen(buf, "w")) == NULL) {
+    /*
+     * A binary file may still be mapped by a loaded data table, it is
+     * replaced instead of overwritten.
+     */
+    strcpy(tmp, buf);
+    if (bin == TRUE) {
+        strcat(tmp, "~");
+    }
+
+    if ((fp = fopen(tmp, bin ? "wb" : "w")) == NULL) {
         errcode = NO_FILE_PERR;
-        error(buf);
+        error(tmp);
         return;
     }
 
@@ -439,9 +521,22 @@ void put_datatable(datatemplate dt, tmstring fname) {
     if (json == TRUE) { /* write .json file */
         write_data_json(fp, dt);
     }
+    if (bin == TRUE) { /* write .pxb file */
+        write_data_bin(fp, dt);
+    }
 
     if (csv == TRUE) { /* do nothing, not implemented yet */
     }
 
     fclose(fp);
+
+    if (bin == TRUE) {
+        if (rename(tmp, buf) != 0) {
+            remove(buf); /* rename does not replace on Windows */
+            if (rename(tmp, buf) != 0) {
+                errcode = NO_FILE_PERR;
+                error(buf);
+            }
+        }
+    }
 }
@@ -26,6 +26,7 @@
 
 extern modeltemplate get_model(tmstring name);
 extern codefile get_modelcode(tmstring name);
+extern tmstring find_modelplugin(tmstring name, unsigned long long *hash);
 extern systemtemplate get_system(tmstring fname);
 extern datatemplate get_datatable(tmstring fname);
 extern void put_system(systemtemplate st, tmstring fname);
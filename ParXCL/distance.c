@@ -26,21 +26,11 @@
 
 /************************ global variables *****************************/
 
-static vector c_res; /* constraint residual */
+/* problem size and precision, shared by all threads */
 
-static vector d_dist; /* differential distance vector */
-static vector ddt;    /* d_distance tangent */
-static vector ddn;    /* d_distance normal */
-static vector n_dist; /* next distance vector */
-
-static vector d_aux; /* differential aux. vector */
-static vector n_aux; /* next aux. vector */
-
-static vector lambda;   /* new estimate of Lagrange vector */
-static vector d_lambda; /* differential Lagrange vector */
-
-static matrix jjt; /* design matrix Jx.Jxt */
-static matrix jdf; /* right hand side matrix Jx.d - f, -f, Jx.d */
+static inum dim_l; /* number of Lagrange multipliers */
+static inum dim_x; /* number of variables */
+static inum dim_a; /* number of auxiliary variables */
 
 static fnum machinep;  /* machine precision */
 static fnum f_tol;     /* approx. precision of model functions */
@@ -48,9 +38,28 @@ static fnum r_tol;     /* relative precision */
 static fnum a_tol;     /* absolute precision */
 static vector aux_tol; /* absolute precision aux. var */
 
+/* workspace, private to each thread */
+
+static THREAD_LOCAL vector c_res; /* constraint residual */
+
+static THREAD_LOCAL vector d_dist; /* differential distance vector */
+static THREAD_LOCAL vector ddt;    /* d_distance tangent */
+static THREAD_LOCAL vector ddn;    /* d_distance normal */
+static THREAD_LOCAL vector n_dist; /* next distance vector */
+
+static THREAD_LOCAL vector d_aux; /* differential aux. vector */
+static THREAD_LOCAL vector n_aux; /* next aux. vector */
+
+static THREAD_LOCAL vector lambda;   /* new estimate of Lagrange vector */
+static THREAD_LOCAL vector d_lambda; /* differential Lagrange vector */
+
+static THREAD_LOCAL matrix jjt; /* design matrix Jx.Jxt */
+static THREAD_LOCAL matrix jdf; /* right hand side matrix Jx.d - f, -f, Jx.d */
+
 #define G_ITMAX 8L /* maximum number of golden sections */
+#define DS_MAX 8   /* largest step direction system solved without LAPACK */
 
-static vector powmu; /* Powell penalty factor */
+static THREAD_LOCAL vector powmu; /* Powell penalty factor */
 
 /***********************************************************************/
 
@@ -72,23 +81,9 @@ void new_distance(inum nl,    /* number of Lagrange multipliers */
                   fnum tol,   /* modes tolerance factor */
                   vector atol /* abstol of auxiliary variables */
 ) {
-    d_dist = rnew_vector(nx);
-
-    c_res = rnew_vector(nl);
-    jjt = rnew_matrix(nl + na, nl + na);
-    jdf = rnew_matrix(nl + na, 3L);
-
-    lambda = rnew_vector(nl);
-    d_lambda = rnew_vector(nl);
-    powmu = rnew_vector(nl);
-
-    n_dist = rnew_vector(nx);
-
-    ddt = rnew_vector(nx);
-    ddn = rnew_vector(nx);
-
-    d_aux = rnew_vector(na);
-    n_aux = rnew_vector(na);
+    dim_l = nl;
+    dim_x = nx;
+    dim_a = na;
 
     machinep = FNUM_EPS; /* machine precision */
 
@@ -97,11 +92,43 @@ void new_distance(inum nl,    /* number of Lagrange multipliers */
     a_tol = sqrt(prec) * ((fabs(tol) < 1.0) ? fabs(tol) : 1.0);
 
     aux_tol = rdup_vector(atol);
+
+    new_distance_work();
 }
 
 /* Free global data structures */
 
 void fre_distance(void) {
+    fre_distance_work();
+
+    rfre_vector(aux_tol);
+}
+
+/* Allocate the workspace of the calling thread */
+
+void new_distance_work(void) {
+    d_dist = rnew_vector(dim_x);
+
+    c_res = rnew_vector(dim_l);
+    jjt = rnew_matrix(dim_l + dim_a, dim_l + dim_a);
+    jdf = rnew_matrix(dim_l + dim_a, 3L);
+
+    lambda = rnew_vector(dim_l);
+    d_lambda = rnew_vector(dim_l);
+    powmu = rnew_vector(dim_l);
+
+    n_dist = rnew_vector(dim_x);
+
+    ddt = rnew_vector(dim_x);
+    ddn = rnew_vector(dim_x);
+
+    d_aux = rnew_vector(dim_a);
+    n_aux = rnew_vector(dim_a);
+}
+
+/* Free the workspace of the calling thread */
+
+void fre_distance_work(void) {
     rfre_vector(d_dist);
 
     rfre_vector(c_res);
@@ -119,8 +146,6 @@ void fre_distance(void) {
 
     rfre_vector(ddt);
     rfre_vector(ddn);
-
-    rfre_vector(aux_tol);
 }
 
 boolean distance(vector dist,     /* distance vector */
@@ -297,27 +322,63 @@ boolean distance(vector dist,     /* distance vector */
     return (conv);
 }
 
-/* calculate step direction by sequential linear constrained method */
+/*
+ * Solve the n x n system in a, n <= DS_MAX, for the three right hand sides
+ * in columns n .. n + 2, by Gaussian elimination with partial pivoting.
+ * The solutions replace the right hand sides. The system is small enough to
+ * stay in the cache, where a LAPACK call would cost more than the solve.
+ */
 
-boolean
-dist_step_direction(vector dist,     /* current distance vector */
-                    vector aux,      /* current auxiliary vector */
-                    vector lagrange, /* current Lagrange vector estimate */
-                    vector lambda,   /* previous Lagrange vector predictor */
-                    vector d_lambda, /* next Lagrange vector predictor */
-                    vector c_res,    /* constraint residual */
-                    matrix jx,       /* Jacobian matrix */
-                    matrix ja,       /* Jacobian matrix */
-                    inum trace) {
-    inum nequ, nvar, naux;
-    inum i, r, c;
+static boolean dist_solve(fnum a[DS_MAX][DS_MAX + 3], inum n) {
+    inum i, j, k, piv;
     fnum f;
-    TMPRINTSTATE *pst;
 
-    if (trace >= 1) {
-        fputs("step direction:\n", trace_stream);
+    for (k = 0; k < n; k++) {
+
+        for (piv = k, i = k + 1; i < n; i++) {
+            if (fabs(a[i][k]) > fabs(a[piv][k])) {
+                piv = i;
+            }
+        }
+        if (a[piv][k] == 0.0) { /* singular system */
+            return (FALSE);
+        }
+        if (piv != k) {
+            for (j = k; j < n + 3; j++) {
+                f = a[k][j];
+                a[k][j] = a[piv][j];
+                a[piv][j] = f;
+            }
+        }
+
+        for (i = k + 1; i < n; i++) {
+            f = a[i][k] / a[k][k];
+            for (j = k + 1; j < n + 3; j++) {
+                a[i][j] -= f * a[k][j];
+            }
+        }
     }
 
+    for (i = n - 1; i >= 0; i--) {
+        for (j = n; j < n + 3; j++) {
+            for (f = a[i][j], k = i + 1; k < n; k++) {
+                f -= a[i][k] * a[k][j];
+            }
+            a[i][j] = f / a[i][i];
+        }
+    }
+
+    return (TRUE);
+}
+
+/* the same system as dist_solve(), in jjt and jdf, solved by LAPACK */
+
+static boolean dist_solve_lapack(vector dist, vector aux, vector c_res,
+                                 matrix jx, matrix ja) {
+    inum nequ, nvar, naux;
+    inum i, r, c;
+    fnum f;
+
     nequ = MATM(jx);  /* number of equations */
     nvar = MATN(jx);  /* number of variables */
     naux = VECN(aux); /* number of auxiliaries */
@@ -372,7 +433,74 @@ dist_step_direction(vector dist,     /* current distance vector */
 
     /* solve (Jx . Jxt) jdf = jdf */
 
-    if (solvesym_m(jjt, jdf, jdf) == FALSE) {
+    return (solvesym_m(jjt, jdf, jdf));
+}
+
+/* calculate step direction by sequential linear constrained method */
+
+boolean
+dist_step_direction(vector dist,     /* current distance vector */
+                    vector aux,      /* current auxiliary vector */
+                    vector lagrange, /* current Lagrange vector estimate */
+                    vector lambda,   /* previous Lagrange vector predictor */
+                    vector d_lambda, /* next Lagrange vector predictor */
+                    vector c_res,    /* constraint residual */
+                    matrix jx,       /* Jacobian matrix */
+                    matrix ja,       /* Jacobian matrix */
+                    inum trace) {
+    inum nequ, nvar, naux;
+    inum i, r, c;
+    fnum f;
+    fnum a[DS_MAX][DS_MAX + 3]; /* small design matrix and right hand sides */
+    boolean b;
+    TMPRINTSTATE *pst;
+
+    if (trace >= 1) {
+        fputs("step direction:\n", trace_stream);
+    }
+
+    nequ = MATM(jx);  /* number of equations */
+    nvar = MATN(jx);  /* number of variables */
+    naux = VECN(aux); /* number of auxiliaries */
+
+    if (nequ + naux <= DS_MAX) { /* the same system, solved in place */
+
+        for (r = 0; r < nequ; r++) {
+            for (c = r; c < nequ; c++) {
+                for (f = 0.0, i = 0; i < nvar; i++) {
+                    f += MAT(jx, r, i) * MAT(jx, c, i);
+                }
+                a[r][c] = a[c][r] = f;
+            }
+            for (c = 0; c < naux; c++) {
+                a[r][nequ + c] = a[nequ + c][r] = MAT(ja, r, c);
+            }
+            for (f = 0.0, i = 0; i < nvar; i++) {
+                f += MAT(jx, r, i) * VEC(dist, i);
+            }
+            a[r][nequ + naux] = f - VEC(c_res, r);
+            a[r][nequ + naux + 1] = -VEC(c_res, r);
+            a[r][nequ + naux + 2] = f;
+        }
+        for (r = nequ; r < nequ + naux; r++) {
+            for (c = nequ; c < nequ + naux + 3; c++) {
+                a[r][c] = 0.0;
+            }
+        }
+
+        b = dist_solve(a, nequ + naux);
+
+        for (r = 0; (b == TRUE) && (r < nequ + naux); r++) {
+            MAT(jdf, r, 0) = a[r][nequ + naux];
+            MAT(jdf, r, 1) = a[r][nequ + naux + 1];
+            MAT(jdf, r, 2) = a[r][nequ + naux + 2];
+        }
+
+    } else {
+        b = dist_solve_lapack(dist, aux, c_res, jx, ja);
+    }
+
+    if (b == FALSE) {
 
         if (trace >= 1) {
             fputs(
@@ -443,10 +571,10 @@ dist_step_direction(vector dist,     /* current distance vector */
 
 /* Local search, find optimal step size in one direction */
 
-static vector g_dist;   /* global distance vector pointer */
-static vector g_aux;    /* global aux vector pointer */
-static vector g_lambda; /* global Lagrange vector pointer */
-static inum g_trace;    /* global trace level */
+static THREAD_LOCAL vector g_dist;   /* global distance vector pointer */
+static THREAD_LOCAL vector g_aux;    /* global aux vector pointer */
+static THREAD_LOCAL vector g_lambda; /* global Lagrange vector pointer */
+static THREAD_LOCAL inum g_trace;    /* global trace level */
 
 /* Powell function: p(x) = 1/2 |dist|^2 + mu * |c(x)| */
 
@@ -33,6 +33,9 @@ extern void new_distance(inum nl,      /* number of Lagrange multipliers */
 
 extern void fre_distance(void);
 
+extern void new_distance_work(void);
+extern void fre_distance_work(void);
+
 extern boolean distance(vector dist,     /* distance vector */
                         vector aux,      /* auxilary vector */
                         vector lagrange, /* Lagrange multipliers */
@@ -27,8 +27,6 @@ extern char error_mesg[];
 extern inum errcode;
 extern void error(tmstring s);
 
-extern inum prx_errcode; /* error code of interpreter */
-
 /* user defined error codes are negative to avoid conflicts with sys errors */
 
 #define UNKNOWN_ERROR -1
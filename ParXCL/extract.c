@@ -24,39 +24,376 @@
 #include "objectiv.h"
 #include "parx.h"
 #include "residual.h"
+#include "vecmat.h"
 
-boolean extract(numblock numb, /* numerical data block */
-                fnum prec,     /* relative precision */
-                fnum tol,      /* modes tolerance factor */
-                opttype opt,   /* type of optimization needed */
-                fnum sens,     /* sensitivity threshold */
-                inum maxiter,  /* maximum number of iterations */
-                inum trace     /* trace flag */
+#define MS_ITER 5L       /* iterations of each start before ranking */
+#define MS_KEEP 4L       /* one in MS_KEEP starts is continued */
+#define MS_DECADE 10.0   /* bound ratio for logarithmic sampling */
+#define MS_SEED 1234567L /* seed of the random generator */
+
+static long ms_seed;      /* state of the random generator */
+static fnum *ms_f;        /* objective function of each start */
+static inum *ms_n;        /* active data points of each start */
+static boolean *ms_conv;  /* did the start reach the optimum */
+
+/* uniform random number in (0,1), minimal standard generator */
+
+static fnum ms_random(void) {
+    long hi, lo;
+
+    hi = ms_seed / 127773L;
+    lo = ms_seed % 127773L;
+    ms_seed = 16807L * lo - 2836L * hi;
+    if (ms_seed <= 0L) {
+        ms_seed += 2147483647L;
+    }
+    return ((fnum)ms_seed / 2147483647.0);
+}
+
+/*
+ * Run the ModeS method from the parameter values of ps, which returns the
+ * optimum and its confidence limits. The data points are consumed in place
+ * or, if copy is TRUE, a copy of them, so the next run starts afresh.
+ */
+
+static boolean extract_run(numblock numb, /* numerical data block */
+                           pset ps,       /* initial and final parameters */
+                           boolean copy,  /* use a copy of the data points */
+                           fnum prec,     /* relative precision */
+                           fnum tol,      /* modes tolerance factor */
+                           opttype opt,   /* type of optimization needed */
+                           fnum sens,     /* sensitivity threshold */
+                           inum maxiter,  /* maximum number of iterations */
+                           inum nprune,   /* points removed at once */
+                           fnum *fopt,    /* final objective function */
+                           inum *npnt,    /* final number of data points */
+                           inum trace     /* trace flag */
 ) {
-    inum neq;    /* maximum number of equations */
-    inum ng;     /* number of equations per point */
-    vector pval; /* variable parameter set values */
-    vector plow; /* lower bounds */
-    vector pup;  /* upper bounds */
+    inum neq;         /* maximum number of equations */
+    inum ng;          /* number of equations per point */
+    vector pval;      /* variable parameter set values */
+    vector plow;      /* lower bounds */
+    vector pup;       /* upper bounds */
+    xgroup_list xorg; /* original data points */
     boolean b;
 
+    *fopt = INF;
+    *npnt = 0;
+
+    xorg = numb->x;
+    if (copy == TRUE) {
+        numb->x = rdup_xgroup_list(xorg);
+    }
+
     /* setup a new objective function */
 
-    if (new_objective(numb, prec, tol, &neq, &ng) == FALSE) {
-        return (FALSE);
+    b = new_objective(numb, prec, tol, &neq, &ng);
+
+    if (b == TRUE) {
+
+        /* get initial values and precision of variable parameters */
+
+        new_pvar(ps, &pval, &plow, &pup);
+
+        /* minimize the objective function using the ModeS method */
+
+        b = modes(neq, ng, pval, plow, pup, opt, tol, prec, sens, maxiter,
+                  nprune, fopt, npnt, trace);
+
+        fre_pvar(pval, plow, pup, ps); /* get the parameter values */
+
+        fre_objective(numb); /* trash the objective function */
+    }
+
+    if (copy == TRUE) {
+        rfre_xgroup_list(numb->x);
+        numb->x = xorg;
+    }
+
+    return (b);
+}
+
+/*
+ * Sample the initial values of the starts by Latin hypercube sampling of
+ * the unknown parameters within their bounds, logarithmically if the bounds
+ * span a decade or more. The first start keeps the given initial values, as
+ * do parameters without finite bounds.
+ */
+
+static void new_starts(pset ps,          /* given parameter set */
+                       statevector stat, /* status of the parameters */
+                       pset *start,      /* parameter sets of the starts */
+                       inum nstart       /* number of starts */
+) {
+    inum *perm; /* permutation of the strata */
+    inum i, j, k, t;
+    fnum l, u, x;
+
+    for (k = 0; k < nstart; k++) {
+        start[k] = rdup_pset(ps);
+    }
+
+    perm = TM_MALLOC(inum *, nstart * sizeof(inum));
+
+    ms_seed = MS_SEED; /* same starts for the same problem */
+
+    for (i = 0; i < VECN(stat); i++) {
+
+        l = VEC(ps->lb, i);
+        u = VEC(ps->ub, i);
+
+        if ((VEC(stat, i) != UNKN) || (fabs(l) >= INF) || (fabs(u) >= INF) ||
+            (l >= u)) {
+            continue;
+        }
+
+        for (k = 0; k < nstart - 1; k++) {
+            perm[k] = k;
+        }
+        for (k = nstart - 2; k > 0; k--) {
+            j = MIN((inum)(ms_random() * (fnum)(k + 1)), k);
+            t = perm[k];
+            perm[k] = perm[j];
+            perm[j] = t;
+        }
+
+        for (k = 1; k < nstart; k++) {
+            x = ((fnum)perm[k - 1] + ms_random()) / (fnum)(nstart - 1);
+
+            if ((l > 0.0) && (u >= MS_DECADE * l)) {
+                x = l * pow(u / l, x);
+            } else if ((u < 0.0) && (l <= MS_DECADE * u)) {
+                x = u * pow(l / u, x);
+            } else {
+                x = l + x * (u - l);
+            }
+            VEC(start[k]->val, i) = x;
+        }
+    }
+
+    TM_FREE(perm);
+}
+
+/*
+ * Is start i better than start j? Reaching the optimum comes first, then
+ * the number of data points kept to satisfy the criterion, then the fit.
+ */
+
+static boolean better_start(inum i, inum j) {
+
+    if (ms_conv[i] != ms_conv[j]) {
+        return (ms_conv[i]);
     }
+    if (ms_n[i] != ms_n[j]) {
+        return ((ms_n[i] > ms_n[j]) ? TRUE : FALSE);
+    }
+    return ((ms_f[i] < ms_f[j]) ? TRUE : FALSE);
+}
+
+/* order the first n entries of rank from the best start to the worst */
+
+static void rank_starts(inum *rank, inum n) {
+    inum i, j, k;
+
+    for (i = 1; i < n; i++) {
+        k = rank[i];
+        for (j = i; (j > 0) && (better_start(k, rank[j - 1]) == TRUE); j--) {
+            rank[j] = rank[j - 1];
+        }
+        rank[j] = k;
+    }
+}
+
+/* report the best optimum and the spread of the optima found */
+
+static void report_starts(pset *start, statevector stat, inum *rank,
+                          inum nstart, inum nkeep, inum trace) {
+    vector pbest, pmin, pmax;
+    inum i, k, n, nv, nconv;
+    fnum v;
+    TMPRINTSTATE *pst;
+
+    for (nv = 0, i = 0; i < VECN(stat); i++) {
+        if (VEC(stat, i) == UNKN) {
+            nv++;
+        }
+    }
+
+    for (nconv = 0, k = 0; k < nkeep; k++) {
+        if (ms_conv[rank[k]] == TRUE) {
+            nconv++;
+        }
+    }
+
+    fputs("\n\nMulti-Start Report\n", trace_stream);
+    fputs("------------------\n\n", trace_stream);
+
+    fprintf(trace_stream, "Starts: %ld, continued: %ld, converged: %ld\n",
+            (long)nstart, (long)nkeep, (long)nconv);
+    fprintf(trace_stream, "Best objective function: %.*e, #data points %ld\n",
+            FNUM_DIG, ms_f[rank[0]], (long)ms_n[rank[0]]);
+
+    if (trace >= 1) {
+        fputs("\nstart  converged  #data points  objective function\n",
+              trace_stream);
+        for (k = 0; k < nkeep; k++) {
+            fprintf(trace_stream, "%5ld  %-9s  %12ld  %.*e\n",
+                    (long)rank[k], (ms_conv[rank[k]] == TRUE) ? "yes" : "no",
+                    (long)ms_n[rank[k]], FNUM_DIG, ms_f[rank[k]]);
+        }
+    }
+
+    /* spread over the converged optima, or all continued starts */
+
+    n = (nconv > 0) ? nconv : nkeep;
+
+    pbest = rnew_vector(nv);
+    pmin = rnew_vector(nv);
+    pmax = rnew_vector(nv);
+
+    for (nv = 0, i = 0; i < VECN(stat); i++) {
+        if (VEC(stat, i) != UNKN) {
+            continue;
+        }
+        VEC(pbest, nv) = VEC(start[rank[0]]->val, i);
+        VEC(pmin, nv) = INF;
+        VEC(pmax, nv) = -INF;
+        for (k = 0; k < n; k++) {
+            v = VEC(start[rank[k]]->val, i);
+            VEC(pmin, nv) = MIN(VEC(pmin, nv), v);
+            VEC(pmax, nv) = MAX(VEC(pmax, nv), v);
+        }
+        nv++;
+    }
+
+    pst = tm_setprint(trace_stream, 0, 80, 8, 0);
+    fputs("\nBest parameter values:\n", trace_stream);
+    print_vector(pst, pbest);
+    fputs("\nMinimum over the optima:\n", trace_stream);
+    print_vector(pst, pmin);
+    fputs("\nMaximum over the optima:\n", trace_stream);
+    print_vector(pst, pmax);
+    tm_endprint(pst);
+    fputc('\n', trace_stream);
+    fflush(trace_stream);
+
+    rfre_vector(pbest);
+    rfre_vector(pmin);
+    rfre_vector(pmax);
+}
+
+/*
+ * Extract from several starts sampled within the parameter bounds. All
+ * starts are screened with a few iterations, only the best part of them
+ * is continued to its optimum, and the final extraction is done from the
+ * best optimum on the data itself. The starts are run one after the other,
+ * not concurrently: ModeS, the objective function and the residual function
+ * keep their state in file globals, one set per process. Each start
+ * evaluates its data points in parallel instead.
+ */
 
-    /* get initial values and precision of variable parameters */
+static boolean multi_start(numblock numb, /* numerical data block */
+                           fnum prec,     /* relative precision */
+                           fnum tol,      /* modes tolerance factor */
+                           opttype opt,   /* type of optimization needed */
+                           fnum sens,     /* sensitivity threshold */
+                           inum maxiter,  /* maximum number of iterations */
+                           inum nprune,   /* points removed at once */
+                           inum nstart,   /* number of starts */
+                           inum trace     /* trace flag */
+) {
+    pset *start; /* parameter sets of the starts */
+    inum *rank;  /* starts ordered from best to worst */
+    inum nkeep;  /* number of starts continued */
+    inum sit;    /* iterations of the screening */
+    inum i, k;
+    fnum f;
+    boolean b;
+
+    start = TM_MALLOC(pset *, nstart * sizeof(pset));
+    rank = TM_MALLOC(inum *, nstart * sizeof(inum));
+    ms_f = TM_MALLOC(fnum *, nstart * sizeof(fnum));
+    ms_n = TM_MALLOC(inum *, nstart * sizeof(inum));
+    ms_conv = TM_MALLOC(boolean *, nstart * sizeof(boolean));
+
+    new_starts(numb->p, numb->mod->pstat, start, nstart);
+
+    /* screen all starts */
+
+    sit = (maxiter > 0L) ? MIN(maxiter, MS_ITER) : MS_ITER;
+
+    b = TRUE;
+    for (k = 0; (b == TRUE) && (k < nstart); k++) {
+        rank[k] = k;
+        ms_conv[k] = extract_run(numb, start[k], TRUE, prec, tol, opt, sens,
+                                 sit, nprune, &ms_f[k], &ms_n[k], -1);
+        if ((k == 0) && (ms_n[k] == 0)) { /* no objective function */
+            b = FALSE;
+        }
+    }
+
+    if (b == TRUE) {
+        rank_starts(rank, nstart);
+
+        /* continue the best starts to their optimum */
+
+        nkeep = MAX(1L, (nstart + MS_KEEP - 1L) / MS_KEEP);
 
-    new_pvar(numb->p, &pval, &plow, &pup);
+        for (i = 0; i < nkeep; i++) {
+            k = rank[i];
+            if (ms_conv[k] == TRUE) { /* optimum already reached */
+                continue;
+            }
+            copy_vector(numb->p->lb, start[k]->lb);
+            copy_vector(numb->p->ub, start[k]->ub);
+            ms_conv[k] = extract_run(numb, start[k], TRUE, prec, tol, opt, sens,
+                                     maxiter, nprune, &ms_f[k], &ms_n[k], -1);
+        }
 
-    /* minimize the objective function using the ModeS method */
+        rank_starts(rank, nkeep);
 
-    b = modes(neq, ng, pval, plow, pup, opt, tol, prec, sens, maxiter, trace);
+        if (trace >= 0) {
+            report_starts(start, numb->mod->pstat, rank, nstart, nkeep, trace);
+        }
 
-    fre_pvar(pval, plow, pup, numb->p); /* get the parameter values */
+        /* final extraction from the best optimum */
+
+        copy_vector(start[rank[0]]->val, numb->p->val);
+
+        b = extract_run(numb, numb->p, FALSE, prec, tol, opt, sens, maxiter,
+                        nprune, &f, &i, trace);
+    }
 
-    fre_objective(numb); /* trash the objective function */
+    for (k = 0; k < nstart; k++) {
+        rfre_pset(start[k]);
+    }
+    TM_FREE(start);
+    TM_FREE(rank);
+    TM_FREE(ms_f);
+    TM_FREE(ms_n);
+    TM_FREE(ms_conv);
 
     return (b);
 }
+
+boolean extract(numblock numb, /* numerical data block */
+                fnum prec,     /* relative precision */
+                fnum tol,      /* modes tolerance factor */
+                opttype opt,   /* type of optimization needed */
+                fnum sens,     /* sensitivity threshold */
+                inum maxiter,  /* maximum number of iterations */
+                inum nprune,   /* points removed at once */
+                inum nstart,   /* number of starts */
+                inum trace     /* trace flag */
+) {
+    fnum fopt; /* final objective function */
+    inum npnt; /* final number of data points */
+
+    if (nstart > 1) {
+        return (multi_start(numb, prec, tol, opt, sens, maxiter, nprune,
+                            nstart, trace));
+    }
+
+    return (extract_run(numb, numb->p, FALSE, prec, tol, opt, sens, maxiter,
+                        nprune, &fopt, &npnt, trace));
+}
@@ -30,6 +30,8 @@ extern boolean extract(numblock numb, /* numerical data block */
                        opttype opt,   /* type of optimization needed */
                        fnum sens,     /* sensitivity threshold */
                        inum maxiter,  /* maximum number of iterations */
+                       inum nprune,   /* points removed at once */
+                       inum nstart,   /* number of starts */
                        inum trace     /* trace flag */
 );
 
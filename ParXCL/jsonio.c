@@ -84,187 +84,653 @@ stateflag string2stateflag(tmstring s) {
     return (UNKN);
 }
 
+/***********************************************************************/
+
+/* streaming output of data tables */
+
+/* write string s with JSON escapes */
+
+static void json_put_string(FILE *fp, const char *s) {
+    const unsigned char *p;
+
+    putc('"', fp);
+    for (p = (const unsigned char *)s; *p != '\0'; p++) {
+        switch (*p) {
+        case '"':
+            fputs("\\\"", fp);
+            break;
+        case '\\':
+            fputs("\\\\", fp);
+            break;
+        case '\b':
+            fputs("\\b", fp);
+            break;
+        case '\f':
+            fputs("\\f", fp);
+            break;
+        case '\n':
+            fputs("\\n", fp);
+            break;
+        case '\r':
+            fputs("\\r", fp);
+            break;
+        case '\t':
+            fputs("\\t", fp);
+            break;
+        default:
+            if (*p < 0x20) {
+                fprintf(fp, "\\u%04x", (unsigned int)*p);
+            } else {
+                putc(*p, fp);
+            }
+            break;
+        }
+    }
+    putc('"', fp);
+}
+
+/* write the shortest of 15, 16 or 17 digits that reads back exactly */
+
+static void json_put_fnum(FILE *fp, fnum f) {
+    char num[32];
+    int prec;
+
+    if (!isfinite(f)) { /* not representable in JSON */
+        fputs("null", fp);
+        return;
+    }
+    for (prec = 15; prec < 17; prec++) {
+        sprintf(num, "%.*g", prec, f);
+        if (strtod(num, NULL) == f) {
+            break;
+        }
+    }
+    if (prec == 17) {
+        sprintf(num, "%.17g", f);
+    }
+    fputs(num, fp);
+}
+
+/* row r of the columns of m */
+
+static void json_put_row(FILE *fp, matrix m, inum r) {
+    inum j;
+
+    putc('[', fp);
+    for (j = 0; j < MATN(m); j++) {
+        if (j > 0) {
+            fputs(", ", fp);
+        }
+        json_put_fnum(fp, MAT(m, r, j));
+    }
+    putc(']', fp);
+}
+
 /**
- * Write a datatemplate to a file in Json-format
+ * Write a datatemplate to a file in Json-format, one data row per line
  *
  * @param fp file
  * @param dt datatemplate
  */
 void write_data_json(FILE *fp, datatemplate dt) {
-    cJSON *json_root, *header, *data, *key, *row, *val, *err;
     colhead_list hp;
-    datarow_list dr;
-    fnum_list flist;
-    unsigned int i;
-    char *json_out;
+    datacolumns dc;
+    inum r;
 
     if (dt == datatemplateNIL || dt->info == tmstringNIL) {
         return;
     }
 
-    json_root = cJSON_CreateObject();
+    fputs("{\n\t\"info\": ", fp);
+    json_put_string(fp, dt->info);
+
+    fputs(",\n\t\"header\": [", fp);
+    for (hp = dt->header; hp != colheadNIL; hp = hp->next) {
+        fputs((hp == dt->header) ? "\n\t\t{\"name\": " : ",\n\t\t{\"name\": ",
+              fp);
+        json_put_string(fp, hp->name);
+        fputs(", \"type\": ", fp);
+        json_put_string(fp, stateflag2string(hp->type));
+        putc('}', fp);
+    }
 
-    if (dt->info != tmstringNIL) {
-        cJSON_AddItemToObject(json_root, "info", cJSON_CreateString(dt->info));
-    } else {
-        cJSON_AddItemToObject(json_root, "info",
-                              cJSON_CreateString("no information available"));
+    fputs("\n\t],\n\t\"data\": [", fp);
+    dc = dt->data;
+    for (r = 0; r < MATM(dc->val); r++) {
+        fprintf(fp, "%s{\"grpid\": %ld, \"crvid\": %ld, \"rowid\": %ld, ",
+                (r == 0) ? "\n\t\t" : ",\n\t\t", (long)VEC(dc->grpid, r),
+                (long)VEC(dc->crvid, r), (long)VEC(dc->rowid, r));
+        fputs("\"val\": ", fp);
+        json_put_row(fp, dc->val, r);
+        fputs(", \"err\": ", fp);
+        json_put_row(fp, dc->err, r);
+        putc('}', fp);
     }
+    fputs("\n\t]\n}\n", fp);
 
-    cJSON_AddItemToObject(json_root, "header", header = cJSON_CreateArray());
-    hp = dt->header;
-    while (hp != colheadNIL) {
-        cJSON_AddItemToArray(header, key = cJSON_CreateObject());
-        cJSON_AddItemToObject(key, "name", cJSON_CreateString(hp->name));
-        cJSON_AddItemToObject(key, "type",
-                              cJSON_CreateString(stateflag2string(hp->type)));
-        hp = hp->next;
-    }
-
-    cJSON_AddItemToObject(json_root, "data", data = cJSON_CreateArray());
-    dr = dt->data;
-    while (dr != datarowNIL) {
-        cJSON_AddItemToArray(data, row = cJSON_CreateObject());
-        cJSON_AddItemToObject(row, "grpid", cJSON_CreateNumber(dr->grpid));
-        cJSON_AddItemToObject(row, "crvid", cJSON_CreateNumber(dr->crvid));
-        cJSON_AddItemToObject(row, "rowid", cJSON_CreateNumber(dr->rowid));
-        cJSON_AddItemToObject(row, "val", val = cJSON_CreateArray());
-        cJSON_AddItemToObject(row, "err", err = cJSON_CreateArray());
-
-        flist = dr->row;
-        for (i = 0; i < flist->sz; i++) {
-            cJSON_AddItemToArray(val, cJSON_CreateNumber(flist->arr[i]));
+    return;
+}
+
+/***********************************************************************/
+
+/* streaming input of data tables, the table is filled while parsing */
+
+#define JSON_BUF 65536 /* size of the input buffer */
+#define JSON_DEPTH 64  /* maximum nesting of skipped values */
+
+static FILE *json_fp;              /* input file */
+static char json_buf[JSON_BUF];    /* input buffer */
+static size_t json_pos, json_len;  /* position and length of buffer */
+static inum json_line;             /* current line */
+static char *json_tok;             /* last parsed string */
+static size_t json_toksz;          /* size of string buffer */
+
+/* next character, left in the input, or EOF */
+
+static int json_look(void) {
+    if (json_pos == json_len) {
+        json_len = fread(json_buf, 1, JSON_BUF, json_fp);
+        json_pos = 0;
+        if (json_len == 0) {
+            return (EOF);
         }
+    }
+    return ((unsigned char)json_buf[json_pos]);
+}
+
+/* next character, or EOF */
+
+static int json_get(void) {
+    int c;
 
-        flist = dr->err;
-        for (i = 0; i < flist->sz; i++) {
-            cJSON_AddItemToArray(err, cJSON_CreateNumber(flist->arr[i]));
+    if ((c = json_look()) == EOF) {
+        return (EOF);
+    }
+    json_pos++;
+    if (c == '\n') {
+        json_line++;
+    }
+    return (c);
+}
+
+/* next non white space character, left in the input */
+
+static int json_peek(void) {
+    int c;
+
+    for (;;) {
+        c = json_look();
+        if ((c != ' ') && (c != '\t') && (c != '\n') && (c != '\r')) {
+            return (c);
         }
+        json_get();
+    }
+}
+
+/* consume character c after white space */
 
-        dr = dr->next;
+static boolean json_expect(int c) {
+    if (json_peek() != c) {
+        return (FALSE);
     }
+    json_get();
+    return (TRUE);
+}
 
-    json_out = cJSON_Print(json_root);
-    cJSON_Delete(json_root);
-    fprintf(fp, "%s\n", json_out);
-    free(json_out);
+static void json_tokput(size_t n, int c) {
+    if (n + 1 >= json_toksz) {
+        json_toksz = (json_toksz == 0) ? 256 : 2 * json_toksz;
+        json_tok = TM_REALLOC(char *, json_tok, json_toksz);
+    }
+    json_tok[n] = (char)c;
+}
 
-    return;
+static boolean json_hex(unsigned long *u) {
+    int i, c;
+
+    for (*u = 0, i = 0; i < 4; i++) {
+        c = json_get();
+        if (isxdigit(c) == 0) {
+            return (FALSE);
+        }
+        *u = 16 * *u + (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+    }
+    return (TRUE);
+}
+
+/* parse a string into json_tok, escapes are decoded to UTF-8 */
+
+static boolean json_string(void) {
+    unsigned long u, l;
+    size_t n;
+    int c;
+
+    if (json_expect('"') == FALSE) {
+        return (FALSE);
+    }
+
+    for (n = 0;; n++) {
+        c = json_get();
+        if ((c == EOF) || (c < 0x20)) {
+            return (FALSE);
+        }
+        if (c == '"') {
+            break;
+        }
+        if (c == '\\') {
+            c = json_get();
+            switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                break;
+            case 'b':
+                c = '\b';
+                break;
+            case 'f':
+                c = '\f';
+                break;
+            case 'n':
+                c = '\n';
+                break;
+            case 'r':
+                c = '\r';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            case 'u':
+                if (json_hex(&u) == FALSE) {
+                    return (FALSE);
+                }
+                if ((u >= 0xD800) && (u < 0xDC00)) { /* surrogate pair */
+                    if ((json_get() != '\\') || (json_get() != 'u') ||
+                        (json_hex(&l) == FALSE) || (l < 0xDC00) ||
+                        (l >= 0xE000)) {
+                        return (FALSE);
+                    }
+                    u = 0x10000 + ((u - 0xD800) << 10) + (l - 0xDC00);
+                }
+                if (u < 0x80) {
+                    c = (int)u;
+                } else if (u < 0x800) {
+                    json_tokput(n++, 0xC0 | (int)(u >> 6));
+                    c = 0x80 | (int)(u & 0x3F);
+                } else if (u < 0x10000) {
+                    json_tokput(n++, 0xE0 | (int)(u >> 12));
+                    json_tokput(n++, 0x80 | (int)((u >> 6) & 0x3F));
+                    c = 0x80 | (int)(u & 0x3F);
+                } else {
+                    json_tokput(n++, 0xF0 | (int)(u >> 18));
+                    json_tokput(n++, 0x80 | (int)((u >> 12) & 0x3F));
+                    json_tokput(n++, 0x80 | (int)((u >> 6) & 0x3F));
+                    c = 0x80 | (int)(u & 0x3F);
+                }
+                break;
+            default:
+                return (FALSE);
+            }
+        }
+        json_tokput(n, c);
+    }
+    json_tokput(n, '\0');
+
+    return (TRUE);
+}
+
+/* parse a literal, the first character is already checked */
+
+static boolean json_literal(const char *s) {
+    for (; *s != '\0'; s++) {
+        if (json_get() != *s) {
+            return (FALSE);
+        }
+    }
+    return (TRUE);
+}
+
+/* parse a number, null reads as zero like in cJSON */
+
+static boolean json_number(fnum *f) {
+    char num[64];
+    char *end;
+    size_t n;
+    int c;
+
+    c = json_peek();
+    if (c == 'n') {
+        *f = 0.0;
+        return (json_literal("null"));
+    }
+
+    for (n = 0; n < sizeof(num) - 1; n++) {
+        c = json_look();
+        if ((c == EOF) || ((isdigit(c) == 0) && (c != '-') && (c != '+') &&
+                           (c != '.') && (c != 'e') && (c != 'E'))) {
+            break;
+        }
+        num[n] = (char)json_get();
+    }
+    num[n] = '\0';
+
+    *f = (fnum)strtod(num, &end);
+    return (((n > 0) && (*end == '\0')) ? TRUE : FALSE);
+}
+
+/* skip any value */
+
+static boolean json_skip(int depth) {
+    fnum f;
+    int c;
+
+    if (depth > JSON_DEPTH) {
+        return (FALSE);
+    }
+
+    c = json_peek();
+    switch (c) {
+    case '"':
+        return (json_string());
+    case 't':
+        return (json_literal("true"));
+    case 'f':
+        return (json_literal("false"));
+    case '{':
+        json_get();
+        if (json_expect('}') == TRUE) {
+            return (TRUE);
+        }
+        do {
+            if ((json_string() == FALSE) || (json_expect(':') == FALSE) ||
+                (json_skip(depth + 1) == FALSE)) {
+                return (FALSE);
+            }
+        } while (json_expect(',') == TRUE);
+        return (json_expect('}'));
+    case '[':
+        json_get();
+        if (json_expect(']') == TRUE) {
+            return (TRUE);
+        }
+        do {
+            if (json_skip(depth + 1) == FALSE) {
+                return (FALSE);
+            }
+        } while (json_expect(',') == TRUE);
+        return (json_expect(']'));
+    default:
+        return (json_number(&f));
+    }
+}
+
+/* parse an array of numbers */
+
+static boolean json_numbers(fnum_list *l) {
+    fnum f;
+
+    if (json_expect('[') == FALSE) {
+        return (FALSE);
+    }
+    if (json_expect(']') == TRUE) {
+        return (TRUE);
+    }
+    do {
+        if (json_number(&f) == FALSE) {
+            return (FALSE);
+        }
+        *l = append_fnum_list(*l, f);
+    } while (json_expect(',') == TRUE);
+
+    return (json_expect(']'));
+}
+
+/* parse a column header, an incomplete header is not added */
+
+static boolean json_colhead(colhead_list *h, boolean *err_headers) {
+    tmstring name, type;
+    boolean ok;
+
+    if (json_peek() != '{') {
+        *err_headers = TRUE;
+        return (json_skip(0));
+    }
+    json_get();
+
+    name = type = tmstringNIL;
+    ok = TRUE;
+
+    if (json_expect('}') == FALSE) {
+        do {
+            if ((json_string() == FALSE) || (json_expect(':') == FALSE)) {
+                ok = FALSE;
+            } else if ((strcmp(json_tok, "name") == 0) &&
+                       (json_peek() == '"')) {
+                ok = json_string();
+                if (ok == TRUE) {
+                    if (name != tmstringNIL) {
+                        rfre_tmstring(name);
+                    }
+                    name = new_tmstring(json_tok);
+                }
+            } else if ((strcmp(json_tok, "type") == 0) &&
+                       (json_peek() == '"')) {
+                ok = json_string();
+                if (ok == TRUE) {
+                    if (type != tmstringNIL) {
+                        rfre_tmstring(type);
+                    }
+                    type = new_tmstring(json_tok);
+                }
+            } else {
+                ok = json_skip(0);
+            }
+        } while ((ok == TRUE) && (json_expect(',') == TRUE));
+
+        ok = (ok == TRUE) ? json_expect('}') : FALSE;
+    }
+
+    if ((name != tmstringNIL) && (type != tmstringNIL)) {
+        *h = append_colhead_list(*h, new_colhead(name, string2stateflag(type)));
+        name = tmstringNIL;
+    } else {
+        *err_headers = TRUE;
+    }
+    if (name != tmstringNIL) {
+        rfre_tmstring(name);
+    }
+    if (type != tmstringNIL) {
+        rfre_tmstring(type);
+    }
+
+    return (ok);
+}
+
+/* index of the row id with key s, or -1 */
+
+static int json_rowid(const char *s) {
+    if (strcmp(s, "grpid") == 0) {
+        return (0);
+    }
+    if (strcmp(s, "crvid") == 0) {
+        return (1);
+    }
+    if (strcmp(s, "rowid") == 0) {
+        return (2);
+    }
+    return (-1);
+}
+
+/*
+ * Parse a data row into the lists vl and el and add it to the columns dc,
+ * an incomplete row is not added. The first row sets the number of columns.
+ */
+
+static boolean json_datarow(datacolumns dc, fnum_list *vl, fnum_list *el,
+                            boolean *err_rows, boolean *err_values) {
+    fnum id[3];
+    boolean has[3], hasv, hase;
+    boolean ok;
+    inum r, j;
+    int k;
+
+    if (json_peek() != '{') {
+        *err_rows = TRUE;
+        return (json_skip(0));
+    }
+    json_get();
+
+    has[0] = has[1] = has[2] = hasv = hase = FALSE;
+    ok = TRUE;
+
+    if (json_expect('}') == FALSE) {
+        do {
+            if ((json_string() == FALSE) || (json_expect(':') == FALSE)) {
+                ok = FALSE;
+            } else if ((k = json_rowid(json_tok)) >= 0) {
+                ok = json_number(&id[k]);
+                has[k] = TRUE;
+            } else if ((strcmp(json_tok, "val") == 0) &&
+                       (json_peek() == '[')) {
+                LSTS(*vl) = 0;
+                ok = json_numbers(vl);
+                hasv = TRUE;
+            } else if ((strcmp(json_tok, "err") == 0) &&
+                       (json_peek() == '[')) {
+                LSTS(*el) = 0;
+                ok = json_numbers(el);
+                hase = TRUE;
+            } else {
+                ok = json_skip(0);
+            }
+        } while ((ok == TRUE) && (json_expect(',') == TRUE));
+
+        ok = (ok == TRUE) ? json_expect('}') : FALSE;
+    }
+
+    if ((ok == TRUE) && (has[0] == TRUE) && (has[1] == TRUE) &&
+        (has[2] == TRUE) && (hasv == TRUE) && (hase == TRUE)) {
+
+        if (MATM(dc->val) == 0) {
+            while (MATN(dc->val) < LSTS(*vl)) {
+                (void)add_datacolumn(dc);
+            }
+        }
+
+        if ((LSTS(*vl) != MATN(dc->val)) || (LSTS(*el) != MATN(dc->val))) {
+            *err_values = TRUE; /* rows must be of equal length */
+        } else {
+            r = add_datarow(dc, (inum)id[0], (inum)id[1], (inum)id[2]);
+            for (j = 0; j < MATN(dc->val); j++) {
+                MAT(dc->val, r, j) = LST(*vl, j);
+                MAT(dc->err, r, j) = LST(*el, j);
+            }
+        }
+
+    } else {
+        *err_rows = TRUE;
+    }
+
+    return (ok);
 }
 
 /**
- * Read a datatemplate from a file in Json-format
+ * Read a datatemplate from a file in Json-format. The file is parsed in
+ * one pass, the data rows are added to the columns as they are read.
  *
  * @param fp file
  * @param dt datatemplate
  * @return success
  */
 inum read_data_json(FILE *fp, datatemplate *dt) {
-    char *json;
-    cJSON *root, *header, *data, *key, *row;
-    cJSON *info, *name, *type, *grpid, *crvid, *rowid;
-    cJSON *val, *err, *v, *e;
-
-    long len;
-    inum i, j, hnum, dnum, vnum;
-    colhead nw;
-    tmstring l_info;
-    colhead_list l_header;
-    datarow_list l_data;
     fnum_list vl, el;
-    datarow nwrow;
-    inum headers, values;
+    inum headers;
+    colhead_list hp;
+    datacolumns dc;
+    boolean ok;
     boolean err_headers = FALSE;
     boolean err_values = FALSE;
     boolean err_rows = FALSE;
 
-    fseek(fp, 0, SEEK_END);
-    len = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    json = malloc(len + 1);
-    fread(json, 1, len, fp);
+    json_fp = fp;
+    json_pos = json_len = 0;
+    json_line = 1;
 
-    root = cJSON_Parse(json);
-    if (!root) {
-        sprintf(tm_errmsg, "JSON syntax error before: [%s]",
-                cJSON_GetErrorPtr());
-        return (1);
-    }
+    dc = rnew_datacolumns(0, 0);
+    *dt = new_datatemplate(tmstringNIL, new_colhead_list(), dc);
+    vl = new_fnum_list(); /* entries of a row, reused for each row */
+    el = new_fnum_list();
 
-    info = cJSON_GetObjectItem(root, "info");
-    if (info) {
-        l_info = new_tmstring(info->valuestring);
-    } else {
-        l_info = new_tmstring("no information available");
-    }
-
-    header = cJSON_GetObjectItem(root, "header");
-    l_header = new_colhead_list();
-    hnum = cJSON_GetArraySize(header);
-    headers = 0;
-    for (i = 0; i < hnum; i++) {
-        key = cJSON_GetArrayItem(header, i);
-        name = cJSON_GetObjectItem(key, "name");
-        type = cJSON_GetObjectItem(key, "type");
-        if (name && type) {
-            nw = new_colhead(new_tmstring(name->valuestring),
-                             string2stateflag(type->valuestring));
-            l_header = append_colhead_list(l_header, nw);
-            headers++;
-        } else {
-            err_headers = TRUE;
-        }
-    }
+    ok = json_expect('{');
 
-    data = cJSON_GetObjectItem(root, "data");
-    dnum = cJSON_GetArraySize(data);
-    l_data = new_datarow_list();
-    for (i = 0; i < dnum; i++) {
-
-        row = cJSON_GetArrayItem(data, i);
-        if (row) {
-            grpid = cJSON_GetObjectItem(row, "grpid");
-            crvid = cJSON_GetObjectItem(row, "crvid");
-            rowid = cJSON_GetObjectItem(row, "rowid");
-            val = cJSON_GetObjectItem(row, "val");
-            err = cJSON_GetObjectItem(row, "err");
-
-            if (grpid && crvid && rowid && val && err) {
-
-                vl = new_fnum_list();
-                el = new_fnum_list();
-
-                vnum = cJSON_GetArraySize(val);
-                values = 0;
-                for (j = 0; j < vnum; j++) {
-                    v = cJSON_GetArrayItem(val, j);
-                    e = cJSON_GetArrayItem(err, j);
-                    if (v && e) {
-                        vl = append_fnum_list(vl, v->valuedouble);
-                        el = append_fnum_list(el, e->valuedouble);
-                        values++;
-                    } else {
-                        err_values = TRUE;
+    if ((ok == TRUE) && (json_expect('}') == FALSE)) {
+        do {
+            if ((json_string() == FALSE) || (json_expect(':') == FALSE)) {
+                ok = FALSE;
+
+            } else if ((strcmp(json_tok, "info") == 0) &&
+                       (json_peek() == '"')) {
+                ok = json_string();
+                if (ok == TRUE) {
+                    if ((*dt)->info != tmstringNIL) {
+                        rfre_tmstring((*dt)->info);
                     }
+                    (*dt)->info = new_tmstring(json_tok);
+                }
+
+            } else if ((strcmp(json_tok, "header") == 0) &&
+                       (json_peek() == '[')) {
+                json_get();
+                if (json_expect(']') == FALSE) {
+                    do {
+                        ok = json_colhead(&(*dt)->header, &err_headers);
+                    } while ((ok == TRUE) && (json_expect(',') == TRUE));
+                    ok = (ok == TRUE) ? json_expect(']') : FALSE;
                 }
-                if (values != headers) {
-                    err_values = TRUE;
+
+            } else if ((strcmp(json_tok, "data") == 0) &&
+                       (json_peek() == '[')) {
+                json_get();
+                if (json_expect(']') == FALSE) {
+                    do {
+                        ok = json_datarow(dc, &vl, &el, &err_rows,
+                                          &err_values);
+                    } while ((ok == TRUE) && (json_expect(',') == TRUE));
+                    ok = (ok == TRUE) ? json_expect(']') : FALSE;
                 }
-                nwrow = new_datarow(grpid->valueint, crvid->valueint,
-                                    rowid->valueint, vl, el);
-                l_data = append_datarow_list(l_data, nwrow);
+
             } else {
-                err_rows = TRUE;
+                ok = json_skip(0);
             }
-        } else {
-            err_rows = TRUE;
-        }
+        } while ((ok == TRUE) && (json_expect(',') == TRUE));
+
+        ok = (ok == TRUE) ? json_expect('}') : FALSE;
+    }
+
+    rfre_fnum_list(vl);
+    rfre_fnum_list(el);
+
+    if ((*dt)->info == tmstringNIL) {
+        (*dt)->info = new_tmstring("no information available");
+    }
+
+    if (ok == FALSE) {
+        sprintf(tm_errmsg, "JSON syntax error in line %ld", (long)json_line);
+        return (1);
     }
 
-    *dt = new_datatemplate(l_info, l_header, l_data);
+    /* all rows must have a value for each header */
 
-    cJSON_Delete(root);
-    free(json);
+    for (hp = (*dt)->header, headers = 0; hp != colheadNIL; hp = hp->next) {
+        headers++;
+    }
+    if (MATM(dc->val) == 0) { /* no rows, only columns */
+        while (MATN(dc->val) < headers) {
+            (void)add_datacolumn(dc);
+        }
+    }
+    if (MATN(dc->val) != headers) {
+        err_values = TRUE;
+    }
 
     if (err_headers == TRUE || err_rows == TRUE || err_values == TRUE) {
         sprintf(tm_errmsg, "JSON structure error");
@@ -64,6 +64,27 @@ int main(int argc, char *argv[]) {
 
             switch (c = (*argv)[1]) {
 
+            case 'c': /* also build compiled models into C plugins */
+                prx_ccode = 1;
+                break;
+
+            case 's': /* stream the Jacobian matrix */
+                parx_stream = 1;
+                break;
+
+            case 'j': /* number of threads */
+                if (argc <= 1) {
+                    fprintf(stderr, "missing argument -%c\n", c);
+                    exit(1);
+                }
+                parx_threads = atoi(*++argv);
+                argc--;
+                if (parx_threads > 0) {
+                    break;
+                }
+                fprintf(stderr, "ParX: illegal number of threads %s\n", *argv);
+                exit(1);
+
             case 't': /* redirect trace stream */
                 if (rt == 1) {
                     fprintf(stderr, "duplicate option -%c\n", c);
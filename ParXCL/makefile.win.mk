@@ -36,7 +36,7 @@ YFLAGS = -d
 
 # Libraries
 
-LIBS = -L/usr/local/lib -ltmc -llapack -lcblas -lblas -lgfortran -lm
+LIBS = -L/usr/local/lib -ltmc -llapack -lcblas -lblas -lgfortran -lpthread -lm
 
 .SUFFIXES: .y .l .t .ds .ht .ct .h .c .o
 
@@ -47,7 +47,8 @@ OBJS= main.o banner.o \
 	objectiv.o parser.o parxlex.o parxyacc.o pprint.o \
 	primtype.o prob.o residual.o simulate.o stim2dat.o \
 	subset.o vecmat.o readcsv.o cJSON.o jsonio.o \
-	mem_func.o bt_func.o prx_func.o prx.o prxinter.o prxcompile.o
+	mem_func.o bt_func.o prx_func.o prx.o prxinter.o prxcompile.o \
+	prxgenc.o threads.o binio.o
 
 MODOBJS= parxmods.o
 
@@ -131,13 +132,14 @@ main.o: parx.h error.h $(TMHDRS)
 banner.o: parx.h
 actions.o: parx.h error.h parser.h subset.h simulate.h \
 	stim2dat.h extract.h actions.h $(TMHDRS)
-datatpl.o: parx.h error.h $(TMHDRS)
+datatpl.o: parx.h error.h binio.h datatpl.h $(TMHDRS)
 dbase.o: parx.h error.h dbio.h $(TMHDRS)
-dbio.o: parx.h error.h dbio.h $(TMHDRS)
+dbio.o: parx.h error.h binio.h dbio.h jsonio.h prx_def.h $(TMHDRS)
 distance.o: parx.h error.h primtype.h vecmat.h \
 	golden.h residual.h distance.h
 error.o: parx.h error.h parser.h primtype.h
-extract.o: parx.h error.h modes.h objectiv.h residual.h extract.h $(TMHDRS)
+extract.o: parx.h error.h modes.h objectiv.h residual.h vecmat.h extract.h \
+	$(TMHDRS)
 golden.o: parx.h error.h primtype.h golden.h
 parser.o: parx.h error.h parser.h $(TMHDRS)
 minbrent.o: parx.h error.h primtype.h minbrent.h
@@ -146,8 +148,9 @@ modes.o: parx.h error.h primtype.h vecmat.h residual.h minbrent.h \
 modify.o: parx.h error.h primtype.h vecmat.h prob.h objectiv.h modify.h
 modlib.o: parx.h error.h primtype.h modlib.h
 newton.o: parx.h error.h primtype.h minbrent.h vecmat.h simulate.h newton.h
-numdat.o: parx.h error.h prxinter.h $(TMHDRS)
-objectiv.o: parx.h error.h vecmat.h residual.h objectiv.h $(TMHDRS)
+numdat.o: parx.h error.h prxinter.h modlib.h dbio.h $(TMHDRS)
+objectiv.o: parx.h error.h vecmat.h residual.h objectiv.h prxinter.h \
+	threads.h $(TMHDRS)
 pprint.o: parx.h error.h pprint.h $(TMHDRS)
 prob.o: parx.h primtype.h prob.h
 residual.o: parx.h error.h vecmat.h distance.h residual.h $(TMHDRS)
@@ -155,9 +158,10 @@ simulate.o: parx.h error.h vecmat.h newton.h simulate.h $(TMHDRS)
 stim2dat.o: parx.h error.h stim2dat.h $(TMHDRS)
 subset.o: parx.h error.h subset.h $(TMHDRS)
 vecmat.o: parx.h error.h primtype.h vecmat.h
-readcsv.o: parx.h error.h $(TMHDRS)
+readcsv.o: parx.h error.h datatpl.h $(TMHDRS)
 cJSON.o: cJSON.h
-jsonio.o: parx.h error.h cJSON.h $(TMHDRS)
+jsonio.o: parx.h error.h cJSON.h datatpl.h $(TMHDRS)
+binio.o: parx.h error.h binio.h datatpl.h $(TMHDRS)
 
 # Model Compiler
 
@@ -166,6 +170,8 @@ mem_func.o: mem_def.h
 bt_func.o: bt_def.h mem_def.h
 prxinter.o: prx_def.h mem_def.h error.h prxinter.h $(TMHDRS)
 prxcompile.o: prx_def.h mem_def.h error.h parx.h primtype.h
+prxgenc.o: prx_def.h parx.h primtype.h
+threads.o: parx.h primtype.h threads.h
 
 # Build-in Models
 
@@ -30,11 +30,13 @@
 
 /************************ defined constants *****************************/
 
-#define MAX_IT 20L    /* factor for total number of iterations */
-#define EQ_SLACK 1.50 /* demand more equations than parameters */
-#define LINE_IT 5L    /* number of local line optimizations    */
-#define REL_FAC 0.20  /* initial underrelaxation factor        */
-#define CUTBOUND 0.10 /* limit for cutting step to bound       */
+#define MAX_IT 20L     /* factor for total number of iterations */
+#define EQ_SLACK 1.50  /* demand more equations than parameters */
+#define LINE_IT 5L     /* number of local line optimizations    */
+#define LINE_PAR 4L    /* number of trial steps evaluated at once */
+#define LINE_IT_PAR 3L /* line optimizations after trial steps  */
+#define REL_FAC 0.20   /* initial underrelaxation factor        */
+#define CUTBOUND 0.10  /* limit for cutting step to bound       */
 
 /************************ global variables ******************************/
 
@@ -45,7 +47,8 @@ static vector p0, p1; /* buffers for current parameter set */
 static boolean rf;  /* residual vector evaluation flag */
 static vector res;  /* residual vector */
 static boolean jf;  /* Jacobian matrix evaluation flag */
-static matrix jacp; /* Jacobian matrix */
+static matrix jacp; /* Jacobian matrix, or its R factor */
+static vector qres; /* Qt.r if the Jacobian matrix is streamed */
 static vector grad; /* gradient vector */
 
 static inum meval_f;  /* number of model equation evaluations */
@@ -58,6 +61,10 @@ static clock_t cpu_time; /* used CPU time */
 
 static inum ls_trace; /* trace level for line search */
 
+static vector trial_a; /* trial step sizes */
+static vector trial_f; /* objective values of the trial steps */
+static vector trial_s; /* slopes of the trial steps */
+
 /***************************************************************************/
 
 static boolean step_direction(vector res, matrix jacp, vector dp, fnum *dc,
@@ -85,6 +92,9 @@ boolean modes(inum neq,     /* maximum number of equations */
               fnum prec,    /* relative precision of the residuals */
               fnum sens,    /* sensitivity threshold */
               inum maxiter, /* maximum number of iterations */
+              inum nprune,  /* maximum number of points removed at once */
+              fnum *fopt,   /* final objective function of the active points */
+              inum *npnt,   /* final number of active data points */
               inum trace    /* trace level */
 ) {
     fnum machinep;      /* machine precision */
@@ -138,12 +148,16 @@ boolean modes(inum neq,     /* maximum number of equations */
     s_val = rnew_vector(VECN(p));
     s_vec = rnew_matrix(VECN(p), VECN(p));
 
-    wrkm = rnew_matrix(neq, MAX(ng, VECN(p)));
-    wrkv = rnew_vector(neq);
+    wrkm = rnew_matrix(ng, MAX(ng, VECN(p)));
+    wrkv = rnew_vector(ng);
     grad = rnew_vector(VECN(p));
 
     bound_alpha = rnew_vector(VECN(p));
 
+    trial_a = rnew_vector(LINE_PAR);
+    trial_f = rnew_vector(LINE_PAR);
+    trial_s = rnew_vector(LINE_PAR);
+
     machinep = FNUM_EPS; /* machine precision */
     rtol = sqrt(machinep);
     prec = MAX(prec, rtol);
@@ -163,6 +177,7 @@ boolean modes(inum neq,     /* maximum number of equations */
     partstep = 0;
 
     rf = jf = TRUE; /* no data yet */
+    qres = vectorNIL;
 
     conv = FALSE;
     prox = FALSE;
@@ -185,6 +200,7 @@ boolean modes(inum neq,     /* maximum number of equations */
         fprintf(trace_stream, "Sensitivity: %e\n", sens);
         fprintf(trace_stream, "Precision  : %e\n", prec);
         fprintf(trace_stream, "Max. iter. : %ld\n", (long)maxiter);
+        fprintf(trace_stream, "Max. prune : %ld\n", (long)MAX(nprune, 1));
         fprintf(trace_stream, "Number of data points: %ld\n\n", (long)npoints);
         fflush(trace_stream);
     }
@@ -209,8 +225,8 @@ boolean modes(inum neq,     /* maximum number of equations */
 
         funceval++;
 
-        b = objective(p, rf, &res, jf, &jacp, modify, FALSE, &npoints, &meval_f,
-                      &meval_jx, &meval_jp, trace - 4);
+        b = objective(p, rf, &res, jf, &jacp, &qres, modify, FALSE, &npoints,
+                      &meval_f, &meval_jx, &meval_jp, trace - 4);
 
         if (b == FALSE) {
             fail = TRUE;
@@ -238,7 +254,7 @@ boolean modes(inum neq,     /* maximum number of equations */
 
         /* check status */
 
-        if (MATM(jacp) < (eq_slack * MATN(jacp))) { /* under-determined */
+        if ((npoints * ng) < (eq_slack * VECN(p))) { /* under-determined */
             fail = TRUE;
             errcode = NUMEQ_CERR;
             error("ext");
@@ -246,16 +262,17 @@ boolean modes(inum neq,     /* maximum number of equations */
                 fprintf(trace_stream,
                         "Insufficient data points remaining, "
                         "#pnt: %ld  #eq: %ld  #par: %ld\n",
-                        (long)npoints, (long)MATM(jacp), (long)MATN(jacp));
+                        (long)npoints, (long)(npoints * ng), (long)VECN(p));
             }
             break;
         }
 
         /* determine the optimal step direction */
         /* left hand singular vectors are returned in jacp */
+        /* if streamed, jacp is R and those of R are returned */
 
-        b = step_direction(res, jacp, dp, &dc, s_val, s_vec, stol, p0, &rank,
-                           trace - 2);
+        b = step_direction((qres != vectorNIL) ? qres : res, jacp, dp, &dc,
+                           s_val, s_vec, stol, p0, &rank, trace - 2);
 
         moddir = FALSE; /* this is the original step direction */
 
@@ -295,8 +312,10 @@ boolean modes(inum neq,     /* maximum number of equations */
                 /* modify number of data points and find new step direction */
                 /* also adjust current value of residual norm for line search */
 
-                b = modify_point_set(res, ng, s_val, s_vec, jacp, rank, dp, &dc,
-                                     &res_norm, &npoints, p0, wrkv, wrkm,
+                b = modify_point_set(res, ng, s_val, s_vec,
+                                     (qres != vectorNIL) ? matrixNIL : jacp, p,
+                                     rank, dp, &dc, &res_norm, &npoints,
+                                     nprune, opt, tol, maxcon, p0, wrkv, wrkm,
                                      trace - 1);
 
                 if (b == FALSE) { /* can't modify point set */
@@ -379,6 +398,9 @@ boolean modes(inum neq,     /* maximum number of equations */
 
     /* END GAME */
 
+    *fopt = (fail == TRUE) ? INF : sumsq;
+    *npnt = npoints;
+
     for (i = 0; i < VECN(pval); i++) { /* copy solution */
         VEC(pval, i) = VEC(p, i);
     }
@@ -458,7 +480,7 @@ boolean modes(inum neq,     /* maximum number of equations */
 
     /* calculate the final distances */
 
-    (void)objective(p, TRUE, &res, FALSE, &jacp, FALSE, TRUE, &npoints,
+    (void)objective(p, TRUE, &res, FALSE, &jacp, &qres, FALSE, TRUE, &npoints,
                     &meval_f, &meval_jx, &meval_jp, trace - 4);
 
     funceval++;
@@ -502,13 +524,16 @@ boolean modes(inum neq,     /* maximum number of equations */
     rfre_vector(s_val);
     rfre_matrix(s_vec);
     rfre_vector(bound_alpha);
+    rfre_vector(trial_a);
+    rfre_vector(trial_f);
+    rfre_vector(trial_s);
 
     return (prox);
 }
 
 /* calculate the modified Gauss-Newton step direction */
 
-boolean step_direction(vector res,  /* current residual vector */
+boolean step_direction(vector res,  /* current residual vector, or Qt.r */
                        matrix jacp, /* current Jacobian matrix */
                        vector dp,   /* parameter step direction */
                        fnum *dc, /* predicted reduction in objective function */
@@ -680,8 +705,8 @@ eval_obj_line(fnum alpha, /* step size */
     funceval++;
     mineval++;
 
-    lf = objective(p0, rf, &res, jf, &jacp, FALSE, FALSE, &npoints, &meval_f,
-                   &meval_jx, &meval_jp, ls_trace - 1);
+    lf = objective(p0, rf, &res, jf, &jacp, &qres, FALSE, FALSE, &npoints,
+                   &meval_f, &meval_jx, &meval_jp, ls_trace - 1);
 
     if (lf == FALSE) {
         if (ls_trace >= 1) {
@@ -695,7 +720,7 @@ eval_obj_line(fnum alpha, /* step size */
     }
 
     if (df == TRUE) {
-        mul_matt_vec(jacp, res, grad);
+        mul_matt_vec(jacp, (qres != vectorNIL) ? qres : res, grad);
         *slope = inp_vector(grad, dp);
     }
 
@@ -712,6 +737,21 @@ eval_obj_line(fnum alpha, /* step size */
     return (TRUE);
 }
 
+/* evaluate the objective function for the trial steps, all at once */
+
+static boolean eval_obj_trials(void) {
+
+    if (objective_line(p, dp, trial_a, trial_f, trial_s, &meval_f, &meval_jx,
+                       &meval_jp, ls_trace - 1) == FALSE) {
+        return (FALSE);
+    }
+
+    funceval += VECN(trial_a);
+    mineval += VECN(trial_a);
+
+    return (TRUE);
+}
+
 /* evaluate objective function for line search, used by Brent minimization */
 
 fnum obj_line(fnum alpha) {
@@ -745,6 +785,11 @@ fnum step_size(fnum res_norm,      /* current minimum for step = 0 */
     boolean found;
     inum i, mini;
     fnum mins;
+    fnum a;
+    boolean spec; /* value taken from the trial steps */
+    inum itrial;  /* next trial step */
+    inum ntrial;  /* number of evaluated trial steps */
+    inum j;
 
     if (trace >= 2) {
         fputs("Starting directional search:\n", trace_stream);
@@ -813,6 +858,10 @@ fnum step_size(fnum res_norm,      /* current minimum for step = 0 */
     }
 
     /* try to bracked the optimum more closely */
+    /* the next steps are evaluated at once, if the points are in parallel */
+
+    itrial = ntrial = 0;
+    spec = FALSE;
 
     for (;;) {
 
@@ -827,7 +876,22 @@ fnum step_size(fnum res_norm,      /* current minimum for step = 0 */
             return (0.0);
         }
 
-        if (eval_obj_line(xm, TRUE, &fm, TRUE, &slope) == FALSE) {
+        if ((itrial == ntrial) && (ls_trace < 1)) {
+            for (a = xr, i = 0; i < VECN(trial_a); i++) {
+                a *= REL_FAC;
+                VEC(trial_a, i) = a;
+            }
+            ntrial = (eval_obj_trials() == TRUE) ? VECN(trial_a) : 0;
+            itrial = 0;
+        }
+
+        spec = (itrial < ntrial) ? TRUE : FALSE;
+
+        if (spec == TRUE) {
+            fm = VEC(trial_f, itrial);
+            slope = VEC(trial_s, itrial);
+            itrial++;
+        } else if (eval_obj_line(xm, TRUE, &fm, TRUE, &slope) == FALSE) {
             fm = INF;
             slope = INF;
         }
@@ -842,7 +906,7 @@ fnum step_size(fnum res_norm,      /* current minimum for step = 0 */
                             FNUM_DIG, xm);
                 }
 
-                rf = jf = FALSE;
+                rf = jf = spec; /* trial steps leave no residuals */
 
                 return (xm);
 
@@ -863,6 +927,24 @@ fnum step_size(fnum res_norm,      /* current minimum for step = 0 */
 
     itmax = LINE_IT; /* don't be too precise */
 
+    /* the remaining, smaller, trial steps may give a narrower bracket */
+
+    if ((spec == TRUE) && (itrial < ntrial)) {
+
+        for (j = itrial - 1, i = itrial; i < ntrial; i++) {
+            if (VEC(trial_f, i) < VEC(trial_f, j)) {
+                j = i;
+            }
+        }
+
+        xr = (j == itrial - 1) ? xr : VEC(trial_a, j - 1);
+        xl = (j == ntrial - 1) ? xl : VEC(trial_a, j + 1);
+        xm = xmin = VEC(trial_a, j);
+        fm = fmin = VEC(trial_f, j);
+
+        itmax = LINE_IT_PAR;
+    }
+
     found = brent(xl, xm, xr, obj_line, releps, abseps, &itmax, &xmin, &fmin);
 
     if (found == FALSE) {
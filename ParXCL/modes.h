@@ -34,6 +34,9 @@ modes(inum neq,     /* maximum number of equations */
       fnum prec,    /* relative precision */
       fnum sens,    /* sensitivity threshold */
       inum maxiter, /* maximum number of iterations */
+      inum nprune,  /* maximum number of points removed at once */
+      fnum *fopt,   /* final objective function of the active points */
+      inum *npnt,   /* final number of active data points */
       inum trace    /* trace level */
 );
 
@@ -27,6 +27,22 @@
 /* Probability criterion for Chi square test */
 #define CHICRIT 0.5
 
+/* Largest number of equations per point solved in closed form */
+#define LEV_NG 3
+
+typedef struct {
+    matrix q;       /* Q, left hand singular vectors */
+    vector res;     /* residual vector */
+    vector e;       /* residuals at the corrected step */
+    vector dpr;     /* D x Pt x (dp - dp0) */
+    inum ng;        /* number of equations per point */
+    inum rank;      /* rank of the Jacobian matrix */
+    boolean *gone;  /* is the point removed */
+    boolean *ok;    /* is the block of the point regular */
+    fnum *dsig;     /* delta sigma of each point */
+    fnum *own;      /* direct delta sigma of each point */
+} LEV_JOB;
+
 /* MODES test if fit is close enough */
 
 boolean proximity(vector res,   /* residuals */
@@ -147,38 +163,361 @@ boolean proximity(vector res,   /* residuals */
     return (TRUE);
 }
 
-/* modify the data set by one point */
+/* rows of Q of point index, recomputed from Jp = Q.D.Pt if Q is not stored */
+
+static matrix q_rows(matrix q,     /* Q, or matrixNIL */
+                     vector p,     /* parameter values */
+                     vector sv,    /* S, singular values */
+                     matrix pt,    /* Pt, right hand singular vectors */
+                     inum rank,    /* rank of the Jacobian matrix */
+                     inum ng,      /* number of equations per point */
+                     inum index,   /* index of point */
+                     matrix sub_q, /* sub matrix of Q */
+                     matrix qp,    /* workspace for the rows of Q */
+                     matrix jp,    /* workspace for the rows of Jp */
+                     inum trace    /* trace level */
+) {
+    fnum inp;
+    inum i, j, v;
+
+    if (q != matrixNIL) {
+        sub_matrix(q, index * ng, 0, ng, MATN(q), sub_q);
+        return (sub_q);
+    }
+
+    if (objective_jacobian(p, index, jp, trace) == FALSE) {
+        return (matrixNIL);
+    }
+
+    for (i = 0; i < ng; i++) {
+        for (v = 0; v < rank; v++) {
+            inp = 0.0;
+            for (j = 0; j < MATN(jp); j++) {
+                inp += MAT(jp, i, j) * MAT(pt, v, j);
+            }
+            MAT(qp, i, v) = inp / VEC(sv, v);
+        }
+    }
+
+    return (qp);
+}
+
+/* calculate I - (Q1 x Q1t) of the rows of a point, upto rank */
+
+static void q_proj(matrix q1, inum ng, inum rank, matrix w) {
+    fnum inp;
+    inum i, j, v;
+
+    for (i = 0; i < ng; i++) {
+        for (j = i; j < ng; j++) {
+
+            /* row_i x row_j, upto rank */
+
+            inp = 0;
+            for (v = 0; v < rank; v++) {
+                inp += MAT(q1, i, v) * MAT(q1, j, v);
+            }
+
+            MAT(w, i, j) = -inp;
+
+            if (j != i) { /* symmetric */
+                MAT(w, j, i) = -inp;
+            } else {
+                MAT(w, j, i) += 1.0;
+            }
+        }
+    }
+}
+
+/*
+ * Delta sigma, e x (I - Q1 x Q1t)^-1 x e with e = res1 + Q1 x dpr, of the
+ * point with rows r0 .. r0 + ng - 1 of Q1 and g .. g + ng - 1 of res, for
+ * ng <= LEV_NG. The inverse of the block is taken in closed form. The
+ * residuals e are stored in rows g .. g + ng - 1 of em.
+ */
+
+static boolean point_dsig(matrix q1,  /* rows of Q */
+                          inum r0,    /* first row of the point in q1 */
+                          vector res, /* residual vector */
+                          inum g,     /* first row of the point in res */
+                          vector dpr, /* D x Pt x (dp - dp0) */
+                          vector em,  /* residuals at the corrected step */
+                          inum ng,    /* number of equations per point */
+                          inum rank,  /* rank of the Jacobian matrix */
+                          fnum *dsig, /* delta sigma */
+                          fnum *own   /* direct delta sigma */
+) {
+    fnum e[LEV_NG];         /* residuals at the corrected step */
+    fnum w[LEV_NG][LEV_NG]; /* I - Q1 x Q1t */
+    fnum a[LEV_NG][LEV_NG]; /* adjugate of w */
+    fnum det, inp;
+    inum i, j, v;
+
+    for (i = 0; i < ng; i++) {
+        inp = VEC(res, g + i);
+        for (v = 0; v < rank; v++) {
+            inp += MAT(q1, r0 + i, v) * VEC(dpr, v);
+        }
+        e[i] = inp;
+        VEC(em, g + i) = inp;
+
+        for (j = 0; j <= i; j++) {
+            inp = 0.0;
+            for (v = 0; v < rank; v++) {
+                inp += MAT(q1, r0 + i, v) * MAT(q1, r0 + j, v);
+            }
+            w[i][j] = w[j][i] = ((i == j) ? 1.0 : 0.0) - inp;
+        }
+    }
+
+    switch (ng) {
+    case 1:
+        det = w[0][0];
+        a[0][0] = 1.0;
+        break;
+    case 2:
+        det = w[0][0] * w[1][1] - w[0][1] * w[0][1];
+        a[0][0] = w[1][1];
+        a[1][1] = w[0][0];
+        a[0][1] = a[1][0] = -w[0][1];
+        break;
+    case 3:
+        a[0][0] = w[1][1] * w[2][2] - w[1][2] * w[1][2];
+        a[1][1] = w[0][0] * w[2][2] - w[0][2] * w[0][2];
+        a[2][2] = w[0][0] * w[1][1] - w[0][1] * w[0][1];
+        a[0][1] = a[1][0] = w[0][2] * w[1][2] - w[0][1] * w[2][2];
+        a[0][2] = a[2][0] = w[0][1] * w[1][2] - w[0][2] * w[1][1];
+        a[1][2] = a[2][1] = w[0][1] * w[0][2] - w[0][0] * w[1][2];
+        det = w[0][0] * a[0][0] + w[0][1] * a[0][1] + w[0][2] * a[0][2];
+        break;
+    default:
+        return (FALSE);
+    }
+
+    if (det == 0.0) { /* singular block */
+        return (FALSE);
+    }
+
+    *dsig = 0.0;
+    *own = 0.0;
+    for (i = 0; i < ng; i++) {
+        for (inp = 0.0, j = 0; j < ng; j++) {
+            inp += a[i][j] * e[j];
+        }
+        *dsig += e[i] * inp;
+        *own += e[i] * e[i];
+    }
+    *dsig /= det;
+
+    return (TRUE);
+}
+
+/* delta sigma of point k from the stored Q, run for all points at once */
+
+static void leverage_point(void *arg, inum k) {
+    LEV_JOB *job;
+
+    job = (LEV_JOB *)arg;
+
+    if (job->gone[k] == TRUE) {
+        return;
+    }
+
+    job->ok[k] = point_dsig(job->q, k * job->ng, job->res, k * job->ng,
+                            job->dpr, job->e, job->ng, job->rank,
+                            &job->dsig[k], &job->own[k]);
+}
+
+/*
+ * Downdate Jp = Q.D.Pt, of rank r, for the removal of the rows Q1 of a point.
+ * The remaining rows have (Q.D)t.(Q.D) = D.(I - Q1t.Q1).D = Kt.K, with
+ * K = (I - Q1t.Q1)^1/2.D computed from the SVD of Q1. The SVD K = U.S.Vt
+ * then gives the new factors S, Vt.Pt and Q.D.V/S, without squaring the
+ * condition of Jp. Return FALSE if the rank would drop.
+ */
+
+static boolean svd_downdate(matrix q1, /* rows of Q of the point */
+                            vector sv, /* S, singular values */
+                            matrix pt, /* Pt, right hand singular vectors */
+                            matrix q,  /* Q, left hand singular vectors, or NIL */
+                            inum rank, /* rank of the Jacobian matrix */
+                            inum ng,   /* number of equations per point */
+                            inum index /* index of point */
+) {
+    matrix a;      /* Q1, upto rank */
+    matrix u1;     /* left hand singular vectors of Q1 */
+    vector c;      /* singular values of Q1 */
+    matrix v1t;    /* right hand singular vectors of Q1 */
+    matrix k;      /* K, and the transformation of Q */
+    vector s;      /* singular values of K */
+    matrix vt;     /* right hand singular vectors of K */
+    matrix w;      /* workspace for the new Pt and rows of Q */
+    inum nc;       /* number of singular values of Q1 */
+    fnum inp;
+    boolean b;
+    inum i, j, l;
+
+    nc = MIN(ng, rank);
+
+    a = rnew_matrix(ng, rank);
+    u1 = rnew_matrix(ng, nc);
+    c = rnew_vector(nc);
+    v1t = rnew_matrix(nc, rank);
+    k = rnew_matrix(rank, rank);
+    s = rnew_vector(rank);
+    vt = rnew_matrix(rank, rank);
+    w = rnew_matrix(rank, MAX(MATN(pt), rank));
+
+    for (i = 0; i < ng; i++) {
+        for (j = 0; j < rank; j++) {
+            MAT(a, i, j) = MAT(q1, i, j);
+        }
+    }
+
+    b = (svd(a, u1, c, v1t, -1.0) == FAIL) ? FALSE : TRUE;
+
+    /* K = (I + V1.((1 - C^2)^1/2 - I).V1t).D */
+
+    for (l = 0; (b == TRUE) && (l < nc); l++) {
+        if (VEC(c, l) >= 1.0) {
+            b = FALSE;
+        } else {
+            VEC(c, l) = sqrt((1.0 - VEC(c, l)) * (1.0 + VEC(c, l))) - 1.0;
+        }
+    }
+
+    if (b == TRUE) {
+        for (i = 0; i < rank; i++) {
+            for (j = 0; j < rank; j++) {
+                inp = (i == j) ? 1.0 : 0.0;
+                for (l = 0; l < nc; l++) {
+                    inp += MAT(v1t, l, i) * VEC(c, l) * MAT(v1t, l, j);
+                }
+                MAT(k, i, j) = inp * VEC(sv, j);
+            }
+        }
+
+        b = (svd(k, matrixNIL, s, vt, -1.0) == rank) ? TRUE : FALSE;
+    }
+
+    if (b == TRUE) {
+
+        /* Pt = Vt.Pt, upto rank */
+
+        for (i = 0; i < rank; i++) {
+            for (j = 0; j < MATN(pt); j++) {
+                inp = 0.0;
+                for (l = 0; l < rank; l++) {
+                    inp += MAT(vt, i, l) * MAT(pt, l, j);
+                }
+                MAT(w, i, j) = inp;
+            }
+        }
+        for (i = 0; i < rank; i++) {
+            for (j = 0; j < MATN(pt); j++) {
+                MAT(pt, i, j) = MAT(w, i, j);
+            }
+        }
+
+        /* Q = Q.D.V/S, the rows of the point become zero */
+
+        if (q != matrixNIL) {
+            for (i = 0; i < rank; i++) {
+                for (j = 0; j < rank; j++) {
+                    MAT(k, i, j) = VEC(sv, i) * MAT(vt, j, i) / VEC(s, j);
+                }
+            }
+            for (l = 0; l < MATM(q); l++) {
+                if ((l >= index * ng) && (l < (index + 1) * ng)) {
+                    for (j = 0; j < rank; j++) {
+                        MAT(q, l, j) = 0.0;
+                    }
+                    continue;
+                }
+                for (j = 0; j < rank; j++) {
+                    inp = 0.0;
+                    for (i = 0; i < rank; i++) {
+                        inp += MAT(q, l, i) * MAT(k, i, j);
+                    }
+                    MAT(w, 0, j) = inp;
+                }
+                for (j = 0; j < rank; j++) {
+                    MAT(q, l, j) = MAT(w, 0, j);
+                }
+            }
+        }
+
+        for (i = 0; i < rank; i++) {
+            VEC(sv, i) = VEC(s, i);
+        }
+    }
+
+    rfre_matrix(a);
+    rfre_matrix(u1);
+    rfre_vector(c);
+    rfre_matrix(v1t);
+    rfre_matrix(k);
+    rfre_vector(s);
+    rfre_matrix(vt);
+    rfre_matrix(w);
+
+    return (b);
+}
+
+/*
+ * Modify the data set by removing upto nprune points, one by one the one
+ * that reduces the objective function most. Between two removals the SVD
+ * of the Jacobian matrix is downdated and the residuals are moved along
+ * with the corrected step direction, so no new evaluation is needed. The
+ * removal stops early when the remaining points, at the moved residuals,
+ * pass the proximity test.
+ */
 
 boolean
 modify_point_set(vector res,     /* residual vector */
                  inum ng,        /* number of equations per point */
                  vector sv,      /* S, singular values */
                  matrix pt,      /* Pt, right hand singular vectors */
-                 matrix q,       /* Q, left hand singular vectors */
+                 matrix q,       /* Q, left hand singular vectors, or NIL */
+                 vector p,       /* parameter values, to recompute Q */
                  inum rank,      /* rank of the Jacobian matrix */
                  vector dp,      /* corrected step direction */
                  fnum *dc,       /* correction on objective function */
                  fnum *res_norm, /* corrected norm of the residual vector */
                  inum *npoints,  /* number of data points */
+                 inum nprune,    /* maximum number of points to remove */
+                 opttype opt,    /* optimization type */
+                 fnum tol,       /* required tolerance */
+                 fnum maxcon,    /* current value of maximum consistency */
                  vector wrkp,    /* workspace, same dimension as dp */
-                 vector wrkv,    /* workspace, same dimension as res */
-                 matrix wrkm,    /* workspace, dimensions neq x max(ng,np) */
+                 vector wrkv,    /* workspace, dimension ng */
+                 matrix wrkm,    /* workspace, dimensions ng x max(ng,np) */
                  inum trace      /* trace level */
 ) {
     inum g;          /* data group */
     fnum inp;        /* vector in-product */
     fnum sigma;      /* square residual norm */
-    fnum dsig;       /* delta sigma */
     fnum dsig_max;   /* maximum delta sigma */
-    fnum own;        /* direct delta sigma */
+    fnum dsum;       /* total delta sigma */
     inum index;      /* index of point */
     inum index_max;  /* index of maximum */
     inum fr;         /* degrees of freedom */
+    inum npnt;       /* number of points before modification */
+    inum *drop;      /* indices of removed points */
+    inum ndrop;      /* number of removed points */
+    vector dp0;      /* original step direction */
+    vector dpr;      /* D x Pt x (dp - dp0) */
+    vector sub_e;    /* residuals of a point at the corrected step */
+    vector em;       /* residuals at the corrected step */
+    vector sub_em;   /* residuals of the remaining points */
+    LEV_JOB job;     /* delta sigma of all points */
     vector sub_res;  /* work space */
-    vector sub_wrkv; /* work space */
     matrix sub_wrkm; /* work space */
+    matrix sub_q;    /* rows of Q of a point */
+    matrix q1;       /* rows of Q of a point */
+    matrix qp, jp;   /* work space to recompute rows of Q */
     boolean b, b0;
-    inum i, j, v;
+    inum i, j;
     TMPRINTSTATE *pst;
 
     fr = VECN(res) - rank;
@@ -191,191 +530,306 @@ modify_point_set(vector res,     /* residual vector */
         fputs("Data point set modification\n", trace_stream);
     }
 
-    /* calculate I - (Q x Qt) in blocks of ng x ng */
+    nprune = MAX(nprune, 1);
+    npnt = VECN(res) / ng;
 
-    for (g = 0; g < MATM(q); g += ng) {
+    /* package res, wrkm and the rows of Q in sub structures */
 
-        for (i = 0; i < ng; i++) {
-            for (j = i; j < ng; j++) {
+    sub_res = new_sub_vector(res);
+    sub_wrkm = new_sub_matrix(wrkm);
+    sub_matrix(wrkm, 0, 0, ng, ng, sub_wrkm);
 
-                /* row_i x row_j, upto rank */
+    sub_q = matrixNIL;
+    qp = jp = matrixNIL;
 
-                inp = 0;
-                for (v = 0; v < rank; v++) {
-                    inp += MAT(q, g + i, v) * MAT(q, g + j, v);
-                }
+    if (q != matrixNIL) {
+        sub_q = new_sub_matrix(q);
+    } else {
+        qp = rnew_matrix(ng, VECN(dp));
+        jp = rnew_matrix(ng, VECN(dp));
+    }
 
-                MAT(wrkm, g + i, j) = -inp;
+    drop = TM_MALLOC(inum *, nprune * sizeof(inum));
+    dp0 = rdup_vector(dp);
+    dpr = rnew_vector(VECN(dp));
+    sub_e = rnew_vector(ng);
+    em = rnew_vector(VECN(res));
+    sub_em = new_sub_vector(em);
+
+    job.q = q;
+    job.res = res;
+    job.e = em;
+    job.dpr = dpr;
+    job.ng = ng;
+    job.rank = rank;
+    job.gone = TM_MALLOC(boolean *, npnt * sizeof(boolean));
+    job.ok = TM_MALLOC(boolean *, npnt * sizeof(boolean));
+    job.dsig = TM_MALLOC(fnum *, npnt * sizeof(fnum));
+    job.own = TM_MALLOC(fnum *, npnt * sizeof(fnum));
+
+    for (index = 0; index < npnt; index++) {
+        job.gone[index] = FALSE;
+    }
 
-                if (j != i) { /* symmetric */
-                    MAT(wrkm, g + j, i) = -inp;
-                } else {
-                    MAT(wrkm, g + j, i) += 1.0;
-                }
+    b = TRUE;
+    dsum = 0.0;
+
+    if (trace >= 2) {
+        sigma = norm_vector(res);
+        sigma *= sigma;
+        fprintf(trace_stream, "sumsq = %.*e\n", FNUM_DIG, sigma);
+    }
+
+    for (ndrop = 0; ndrop < nprune;) {
+
+        /* the residuals move with the step correction: + Q x D x Pt x ddp */
+
+        for (i = 0; i < rank; i++) {
+            inp = 0.0;
+            for (j = 0; j < VECN(dp); j++) {
+                inp += MAT(pt, i, j) * (VEC(dp, j) - VEC(dp0, j));
             }
+            VEC(dpr, i) = inp * VEC(sv, i);
         }
-    }
 
-    /* calculate: res x (I - Q x Qt)^-1 x res, in blocks */
+        /* calculate: res x (I - Q x Qt)^-1 x res, in blocks of ng x ng */
 
-    /* package wrkm, wrkv and res in sub structures */
+        if ((q != matrixNIL) && (ng <= LEV_NG)) { /* all points at once */
 
-    sub_res = new_sub_vector(res);
-    sub_wrkv = new_sub_vector(wrkv);
-    sub_wrkm = new_sub_matrix(wrkm);
+            objective_for(npnt, leverage_point, &job);
 
-    b = TRUE;
-    dsig_max = 0.0;
-    index_max = -1;
+        } else { /* recompute the rows of Q, or solve larger blocks */
 
-    if (trace >= 2) {
+            for (g = 0, index = 0; g < VECN(res); g += ng, index++) {
 
-        sigma = norm_vector(res);
-        sigma *= sigma;
+                if (job.gone[index] == TRUE) {
+                    continue;
+                }
 
-        fprintf(trace_stream, "sumsq = %.*e\n", FNUM_DIG, sigma);
-    }
+                q1 = q_rows(q, p, sv, pt, rank, ng, index, sub_q, qp, jp,
+                            trace - 1);
 
-    for (g = 0, index = 0; g < MATM(q); g += ng, index++) {
+                if (q1 == matrixNIL) {
+                    job.ok[index] = FALSE;
+                    break;
+                }
 
-        sub_vector(res, g, ng, sub_res);
-        sub_vector(wrkv, g, ng, sub_wrkv);
-        sub_matrix(wrkm, g, 0, ng, ng, sub_wrkm);
+                if (ng <= LEV_NG) {
+                    job.ok[index] =
+                        point_dsig(q1, 0, res, g, dpr, em, ng, rank,
+                                   &job.dsig[index], &job.own[index]);
+                    if (job.ok[index] == FALSE) {
+                        break;
+                    }
+                    continue;
+                }
 
-        b = solvesym_v(sub_wrkm, sub_wrkv, sub_res);
+                q_proj(q1, ng, rank, sub_wrkm);
 
-        if (b == FALSE) {
-            break;
-        }
+                for (i = 0; i < ng; i++) {
+                    inp = VEC(res, g + i);
+                    for (j = 0; j < rank; j++) {
+                        inp += MAT(q1, i, j) * VEC(dpr, j);
+                    }
+                    VEC(sub_e, i) = inp;
+                    VEC(em, g + i) = inp;
+                }
 
-        dsig = inp_vector(sub_res, sub_wrkv);
-        own = norm_vector(sub_res);
-        own *= own;
+                job.ok[index] = solvesym_v(sub_wrkm, wrkv, sub_e);
 
-        if (trace >= 5) {
-            fprintf(trace_stream, "%c index %5ld, d_sumsq= %.*e, own = %.*e\n",
-                    (dsig > dsig_max) ? '*' : ' ', (long)index, FNUM_DIG, dsig,
-                    FNUM_DIG, own);
-        }
+                if (job.ok[index] == FALSE) {
+                    break;
+                }
 
-        if (dsig > dsig_max) {
-            dsig_max = dsig;
-            index_max = index;
+                job.dsig[index] = inp_vector(sub_e, wrkv);
+                job.own[index] = inp_vector(sub_e, sub_e);
+            }
         }
-    }
 
-    if (index_max == -1) { /* no worst point */
+        /* the worst point, the first one of equals, upto a failure */
 
-        fre_sub_vector(sub_res);
-        fre_sub_vector(sub_wrkv);
-        fre_sub_matrix(sub_wrkm);
+        dsig_max = 0.0;
+        index_max = -1;
 
-        return (FALSE);
-    }
+        for (index = 0; index < npnt; index++) {
 
-    /* predict dp after removing worst data point */
+            if (job.gone[index] == TRUE) {
+                continue;
+            }
 
-    g = index_max * ng;
+            if (job.ok[index] == FALSE) {
+                b = FALSE;
+                break;
+            }
 
-    /* calculate I - (Q1 x Q1t) */
+            if (trace >= 5) {
+                fprintf(trace_stream,
+                        "%c index %5ld, d_sumsq= %.*e, own = %.*e\n",
+                        (job.dsig[index] > dsig_max) ? '*' : ' ',
+                        (long)index, FNUM_DIG, job.dsig[index], FNUM_DIG,
+                        job.own[index]);
+            }
 
-    for (i = 0; i < ng; i++) {
-        for (j = i; j < ng; j++) {
+            if (job.dsig[index] > dsig_max) {
+                dsig_max = job.dsig[index];
+                index_max = index;
+            }
+        }
 
-            /* row_i x row_j, upto rank */
+        /* stop when the remaining points at the moved residuals are close
+           enough, a copy of maxcon keeps the consistency of modes intact */
 
-            inp = 0;
-            for (v = 0; v < rank; v++) {
-                inp += MAT(q, g + i, v) * MAT(q, g + j, v);
+        if ((b == TRUE) && (ndrop > 0)) {
+            for (g = 0, i = 0, index = 0; index < npnt; index++, g += ng) {
+                if (job.gone[index] == TRUE) {
+                    continue;
+                }
+                for (j = 0; j < ng; j++) {
+                    VEC(em, i++) = VEC(em, g + j);
+                }
+            }
+            sub_vector(em, 0, i, sub_em);
+            if (proximity(sub_em, sv, ng, rank, opt, tol, &maxcon,
+                          trace - 1) == TRUE) {
+                break;
             }
+        }
 
-            MAT(wrkm, g + i, j) = -inp;
+        /* predict dp after removing worst data point */
 
-            if (j != i) { /* symmetric */
-                MAT(wrkm, g + j, i) = -inp;
-            } else {
-                MAT(wrkm, g + j, i) += 1.0;
-            }
+        q1 = matrixNIL;
+
+        if ((b == TRUE) && (index_max != -1)) {
+            q1 = q_rows(q, p, sv, pt, rank, ng, index_max, sub_q, qp, jp,
+                        trace - 1);
+        }
+
+        if (q1 == matrixNIL) { /* no worst point */
+            b = FALSE;
+            break;
         }
-    }
 
-    /* calculate: (I - Q1 x Q1t)^-1 x (res1 + Q1 x D x Pt x dp) */
+        g = index_max * ng;
 
-    /* package wrkm, wrkv and res in sub structures */
+        /* calculate I - (Q1 x Q1t) */
 
-    sub_vector(res, g, ng, sub_res);
-    sub_vector(wrkv, g, ng, sub_wrkv);
-    sub_matrix(wrkm, g, 0, ng, ng, sub_wrkm);
+        q_proj(q1, ng, rank, sub_wrkm);
 
-    for (i = 0; i < rank; i++) {
-        inp = 0.0;
-        for (j = 0; j < VECN(dp); j++) {
-            inp += MAT(pt, i, j) * VEC(dp, j);
+        /* calculate: (I - Q1 x Q1t)^-1 x (res1 + Q1 x D x Pt x dp) */
+
+        sub_vector(res, g, ng, sub_res);
+
+        for (i = 0; i < rank; i++) {
+            inp = 0.0;
+            for (j = 0; j < VECN(dp); j++) {
+                inp += MAT(pt, i, j) * VEC(dp, j);
+            }
+            VEC(wrkp, i) = inp * VEC(sv, i);
         }
-        VEC(wrkp, i) = inp * VEC(sv, i);
-    }
-    for (i = 0; i < ng; i++) {
-        for (j = 0; j < rank; j++) {
-            VEC(sub_res, i) += MAT(q, g + i, j) * VEC(wrkp, j);
+        for (i = 0; i < ng; i++) {
+            for (j = 0; j < rank; j++) {
+                VEC(sub_res, i) += MAT(q1, i, j) * VEC(wrkp, j);
+            }
         }
-    }
 
-    b0 = solvesym_v(sub_wrkm, sub_wrkv, sub_res);
+        b0 = solvesym_v(sub_wrkm, wrkv, sub_res);
 
-    b = (b0 == FALSE) ? FALSE : b;
+        if (b0 == FALSE) {
+            b = FALSE;
+            break;
+        }
 
-    if (b == FALSE) {
+        for (i = 0; i < rank; i++) {
+            inp = 0.0;
+            for (j = 0; j < ng; j++) {
+                inp += MAT(q1, j, i) * VEC(wrkv, j);
+            }
+            VEC(wrkp, i) = inp / VEC(sv, i);
+        }
 
-        fre_sub_vector(sub_res);
-        fre_sub_vector(sub_wrkv);
-        fre_sub_matrix(sub_wrkm);
+        for (i = 0; i < MATN(pt); i++) {
+            inp = 0.0;
+            for (j = 0; j < rank; j++) {
+                inp += MAT(pt, j, i) * VEC(wrkp, j);
+            }
+            MAT(wrkm, 0, i) = inp;
+        }
 
-        return (FALSE);
-    }
+        for (i = 0; i < VECN(dp); i++) {
+            VEC(dp, i) += (i < rank) ? MAT(wrkm, 0, i) : 0.0;
+            VEC(wrkp, i) = (i < rank) ? MAT(wrkm, 0, i) : 0.0;
+        }
 
-    for (i = 0; i < rank; i++) {
-        inp = 0.0;
-        for (j = 0; j < ng; j++) {
-            inp += MAT(q, g + j, i) * VEC(wrkv, g + j);
+        if (trace >= 2) {
+            pst = tm_setprint(trace_stream, 0, 80, 8, 0);
+            fputs("step correction:\n", trace_stream);
+            print_vector(pst, wrkp);
+            fputs("predicted step direction:\n", trace_stream);
+            print_vector(pst, dp);
+            tm_endprint(pst);
         }
-        VEC(wrkp, i) = inp / VEC(sv, i);
-    }
 
-    for (i = 0; i < MATN(pt); i++) {
-        inp = 0.0;
-        for (j = 0; j < rank; j++) {
-            inp += MAT(pt, j, i) * VEC(wrkp, j);
+        zero_vector(sub_res);
+
+        drop[ndrop++] = index_max;
+        job.gone[index_max] = TRUE;
+        dsum += dsig_max;
+
+        /* enough points removed, or too few left for another one */
+
+        if ((ndrop >= nprune) || ((npnt - ndrop - 1) * ng <= rank)) {
+            break;
         }
-        MAT(wrkm, 0, i) = inp;
-    }
 
-    for (i = 0; i < VECN(dp); i++) {
-        VEC(dp, i) += (i < rank) ? MAT(wrkm, 0, i) : 0.0;
-        VEC(wrkp, i) = (i < rank) ? MAT(wrkm, 0, i) : 0.0;
-    }
+        /* the remaining points are evaluated with the downdated SVD */
 
-    if (trace >= 2) {
-        pst = tm_setprint(trace_stream, 0, 80, 8, 0);
-        fputs("step correction:\n", trace_stream);
-        print_vector(pst, wrkp);
-        fputs("predicted step direction:\n", trace_stream);
-        print_vector(pst, dp);
-        tm_endprint(pst);
+        if (svd_downdate(q1, sv, pt, q, rank, ng, index_max) == FALSE) {
+            break;
+        }
     }
 
-    /* correct residual norm */
+    if (ndrop > 0) {
+        b = TRUE;
 
-    zero_vector(sub_res);
+        /* correct residual norm */
 
-    *res_norm = norm_vector(res);
+        *res_norm = norm_vector(res);
 
-    *dc = dsig_max;
+        *dc = dsum;
 
-    *npoints = remove_data_point(index_max, UGROUP, trace);
+        /* remove the last point first, the indices of the others hold */
+
+        for (i = 1; i < ndrop; i++) {
+            index = drop[i];
+            for (j = i; (j > 0) && (drop[j - 1] < index); j--) {
+                drop[j] = drop[j - 1];
+            }
+            drop[j] = index;
+        }
+        for (i = 0; i < ndrop; i++) {
+            *npoints = remove_data_point(drop[i], UGROUP, trace);
+        }
+    }
+
+    TM_FREE(drop);
+    TM_FREE(job.gone);
+    TM_FREE(job.ok);
+    TM_FREE(job.dsig);
+    TM_FREE(job.own);
+    rfre_vector(dp0);
+    rfre_vector(dpr);
+    rfre_vector(sub_e);
+    fre_sub_vector(sub_em);
+    rfre_vector(em);
 
     fre_sub_vector(sub_res);
-    fre_sub_vector(sub_wrkv);
     fre_sub_matrix(sub_wrkm);
+    if (q != matrixNIL) {
+        fre_sub_matrix(sub_q);
+    } else {
+        rfre_matrix(qp);
+        rfre_matrix(jp);
+    }
 
-    return (TRUE);
+    return (b);
 }
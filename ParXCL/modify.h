@@ -38,15 +38,20 @@ modify_point_set(vector res,     /* residual vector */
                  inum ng,        /* number of equations per point */
                  vector sv,      /* S, singular values */
                  matrix pt,      /* Pt, right hand singular vectors */
-                 matrix q,       /* Q, left hand singular vectors */
+                 matrix q,       /* Q, left hand singular vectors, or NIL */
+                 vector p,       /* parameter values, to recompute Q */
                  inum rank,      /* rank of the Jacobian matrix */
                  vector dp,      /* corrected step direction */
                  fnum *dc,       /* correction on objective function */
                  fnum *res_norm, /* corrected norm of the residual vector */
                  inum *npoints,  /* number of data points */
+                 inum nprune,    /* maximum number of points to remove */
+                 opttype opt,    /* optimization type */
+                 fnum tol,       /* required tolerance */
+                 fnum maxcon,    /* current value of maximum consistency */
                  vector wrkp,    /* workspace, same dimension as dp */
-                 vector wrkv,    /* workspace, same dimension as res */
-                 matrix wrkm,    /* workspace, same dimensions as q */
+                 vector wrkv,    /* workspace, dimension ng */
+                 matrix wrkm,    /* workspace, dimensions ng x max(ng,np) */
                  inum trace      /* trace level */
 );
 
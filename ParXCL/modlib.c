@@ -18,19 +18,226 @@
  */
 
 #include "modlib.h"
+#include "error.h"
 #include "parx.h"
 
-/* find a named entry in the model library */
+#if !defined(MSDOS)
+#include <dlfcn.h>
+#define MODEL_PLUGINS
+#endif
 
-parxmodel find_model_proc(tmstring name) {
+/* hash table of the model library, keyed by model name */
+
+#define MODHASH 61 /* number of hash buckets */
+
+typedef struct modentry {
+    struct modentry *next; /* next entry in bucket */
+    tmstring name;         /* full modelname */
+    parxmodel p;           /* model specification */
+} ModelEntry;
+
+static ModelEntry *modhash[MODHASH];
+static boolean modhash_init = FALSE;
+
+static unsigned int hash_model(tmstring name) {
+    unsigned int h = 5381;
+
+    while (*name != '\0') {
+        h = h * 33 + (unsigned char)*name++;
+    }
+    return (h % MODHASH);
+}
+
+static ModelEntry *lookup_model(tmstring name) {
+    ModelEntry *e;
+
+    for (e = modhash[hash_model(name)]; e != NULL; e = e->next) {
+        if (strcmp(e->name, name) == 0) {
+            return (e);
+        }
+    }
+    return (NULL);
+}
+
+static void register_model(tmstring name, parxmodel p) {
+    ModelEntry *e;
+    unsigned int h;
+
+    if (lookup_model(name) != NULL) { /* first definition wins */
+        return;
+    }
+    e = (ModelEntry *)malloc(sizeof(ModelEntry));
+    if (e == NULL) {
+        return;
+    }
+    e->name = new_tmstring(name);
+    e->p = p;
+    h = hash_model(name);
+    e->next = modhash[h];
+    modhash[h] = e;
+}
+
+/* enter the static model library in the hash table */
+
+static void init_modhash(void) {
     inum i;
 
     for (i = 0; i < modlib_size; i++) {
-        if (strcmp(modlib[i].name, name) == 0) {
-            return (modlib[i].p);
+        register_model(modlib[i].name, modlib[i].p);
+    }
+    modhash_init = TRUE;
+}
+
+/* find a named entry in the model library */
+
+parxmodel find_model_proc(tmstring name) {
+    ModelEntry *e;
+
+    if (!modhash_init) {
+        init_modhash();
+    }
+    e = lookup_model(name);
+    return ((e == NULL) ? parxmodelNIL : e->p);
+}
+
+#ifdef MODEL_PLUGINS
+
+/* loaded plugins, kept apart from the model library, keyed by path */
+
+typedef struct plugentry {
+    struct plugentry *next;  /* next loaded plugin */
+    tmstring path;           /* path of the shared object */
+    unsigned long long hash; /* hash of the model source */
+    void *handle;            /* handle of the shared object */
+    const ModelPlugin *mp;   /* table of models */
+} PluginEntry;
+
+static PluginEntry *plugins = NULL;
+
+/* find a model in the table of a plugin */
+
+static parxmodel plugin_model(const ModelPlugin *mp, tmstring name) {
+    for (; mp->name != NULL; mp++) {
+        if (mp->version != MODEL_PLUGIN_VERSION || mp->p == parxmodelNIL) {
+            continue; /* incompatible entry */
+        }
+        if (strcmp(mp->name, name) == 0) {
+            return (mp->p);
+        }
+    }
+    return (parxmodelNIL);
+}
+
+/* unload a plugin, its models are no longer found */
+
+static void unload_plugin(PluginEntry *pe) {
+    PluginEntry **pp;
+
+    for (pp = &plugins; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == pe) {
+            *pp = pe->next;
+            break;
+        }
+    }
+    dlclose(pe->handle);
+    fre_tmstring(pe->path);
+    free(pe);
+}
+
+#endif
+
+/* load a model plugin and find a model it exports. A loaded plugin stays
+   loaded until its model source changes, then it is loaded again.
+   A plugin generated from another model source is not used,
+   stale is set and no error is reported */
+
+parxmodel load_model_plugin(tmstring fname, tmstring name,
+                            unsigned long long hash, boolean *stale) {
+#ifdef MODEL_PLUGINS
+    char path[1024];
+    void *handle;
+    const ModelPlugin *mp;
+    const unsigned long long *mh;
+    PluginEntry *pe;
+    parxmodel p;
+
+    *stale = FALSE;
+
+    /* dlopen only searches the given path if it contains a separator */
+
+    if (strchr(fname, '/') == NULL && strchr(fname, '\\') == NULL) {
+        strcpy(path, "." PATH_SEP);
+        strncat(path, fname, sizeof(path) - 3);
+    } else {
+        strncpy(path, fname, sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+    }
+
+    /* a loaded plugin of the same source is used again */
+
+    for (pe = plugins; pe != NULL; pe = pe->next) {
+        if (strcmp(pe->path, path) == 0) {
+            break;
+        }
+    }
+    if (pe != NULL) {
+        if (pe->hash != hash) { /* model source has changed */
+            unload_plugin(pe);
+            pe = NULL;
+        }
+    }
+
+    if (pe == NULL) {
+        if ((handle = dlopen(path, RTLD_NOW | RTLD_LOCAL)) == NULL) {
+            fprintf(error_stream, "\nParX: %s\n", dlerror());
+            errcode = UNK_MODEL_PERR;
+            error(fname);
+            return (parxmodelNIL);
         }
+
+        mh = (const unsigned long long *)dlsym(handle, MODEL_PLUGIN_HASH);
+        if (mh == NULL || *mh != hash) { /* out of date */
+            dlclose(handle);
+            *stale = TRUE;
+            return (parxmodelNIL);
+        }
+
+        mp = (const ModelPlugin *)dlsym(handle, MODEL_PLUGIN_ENTRY);
+        if (mp == NULL) {
+            dlclose(handle);
+            errcode = UNK_MODEL_PERR;
+            error(fname);
+            return (parxmodelNIL);
+        }
+
+        pe = (PluginEntry *)malloc(sizeof(PluginEntry));
+        if (pe == NULL) {
+            dlclose(handle);
+            errcode = UNK_MODEL_PERR;
+            error(fname);
+            return (parxmodelNIL);
+        }
+        pe->path = new_tmstring(path);
+        pe->hash = hash;
+        pe->handle = handle;
+        pe->mp = mp;
+        pe->next = plugins;
+        plugins = pe;
+    }
+
+    if ((p = plugin_model(pe->mp, name)) == parxmodelNIL) {
+        /* plugin does not provide model */
+        errcode = UNK_MODEL_PERR;
+        error(name);
+        return (parxmodelNIL);
     }
+    return (p);
+#else
+    *stale = FALSE;
+    errcode = UNK_MODEL_PERR;
+    error(fname);
     return (parxmodelNIL);
+#endif
 }
 
 /* reverse a xset list */
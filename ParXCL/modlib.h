@@ -36,7 +36,23 @@ typedef struct {
 extern ModelLibrary modlib; /* default model library */
 extern inum modlib_size;    /* number of entries - 1 */
 
+/* model plugin, a shared object exporting a table of models,
+   terminated by an entry with a NULL name, and the hash of the
+   model source it was generated from */
+
+#define MODEL_PLUGIN_VERSION 1
+#define MODEL_PLUGIN_ENTRY "parx_model_plugin_1"
+#define MODEL_PLUGIN_HASH "parx_model_hash_1"
+
+typedef struct {
+    inum version;     /* MODEL_PLUGIN_VERSION */
+    const char *name; /* full modelname */
+    parxmodel p;      /* model specification */
+} ModelPlugin;
+
 extern parxmodel find_model_proc(tmstring name);
+extern parxmodel load_model_plugin(tmstring fname, tmstring name,
+                                   unsigned long long hash, boolean *stale);
 extern xset_list rev_xset_list(xset_list l);
 
 #endif
@@ -27,22 +27,31 @@
 
 /************************ global variables ******************************/
 
-static inum dim = 0; /* number of variables */
+/*
+ * The workspace belongs to the calling thread, so that points can be
+ * simulated in parallel, each thread calling new_newton first.
+ */
+
+static THREAD_LOCAL inum dim = 0; /* number of variables */
 
-static vector x;      /* variable vector */
-static vector dx;     /* change vector */
-static vector xn;     /* next x vector */
-static vector f;      /* residual vector */
-static vector fn;     /* next residual vector */
-static vector b;      /* -f */
-static vector f1, f2; /* f(x-dx), f(x+dx) */
-static matrix jac;    /* Jacobian matrix, df/dx + df/da */
+static THREAD_LOCAL vector x;      /* variable vector */
+static THREAD_LOCAL vector dx;     /* change vector */
+static THREAD_LOCAL vector xn;     /* next x vector */
+static THREAD_LOCAL vector f;      /* residual vector */
+static THREAD_LOCAL vector fn;     /* next residual vector */
+static THREAD_LOCAL vector b;      /* -f */
+static THREAD_LOCAL vector f1, f2; /* f(x-dx), f(x+dx) */
+static THREAD_LOCAL matrix jac;    /* Jacobian matrix, df/dx + df/da */
+static THREAD_LOCAL matrix lu;     /* copy of jac, factored by crout */
 
-static inum funceval; /* total number of function evaluations */
-static inum jaceval;  /* total number of Jacobian evaluations */
-static inum mineval;  /* function evaluations for local search */
+static THREAD_LOCAL inum funceval; /* total number of function evaluations */
+static THREAD_LOCAL inum jaceval;  /* total number of Jacobian evaluations */
+static THREAD_LOCAL inum mineval;  /* function evaluations for local search */
+static THREAD_LOCAL inum updeval;  /* number of Broyden updates */
 
-static inum trace; /* trace level */
+static THREAD_LOCAL boolean jmodel; /* does the model supply the Jacobian */
+
+static THREAD_LOCAL inum trace; /* trace level */
 
 #define IT_FAC 500L /* factor for maxiter */
 
@@ -72,6 +81,9 @@ void new_newton(inum nx) {
     f2 = rnew_vector(dim);
     b = rnew_vector(dim);
     jac = rnew_matrix(dim, dim);
+    lu = rnew_matrix(dim, dim);
+
+    jmodel = TRUE; /* until the model says otherwise */
 
     new_vecmat(dim, dim); /* setup vecmat library */
 }
@@ -87,16 +99,24 @@ void fre_newton(void) {
     rfre_vector(f2);
     rfre_vector(b);
     rfre_matrix(jac);
+    rfre_matrix(lu);
 
     fre_vecmat();
 }
 
-/* modified Newton-Raphson optimizer */
+/*
+ * Modified Newton-Raphson optimizer. The Jacobian matrix comes from the
+ * model, or from central differences if the model does not supply it.
+ * Upto nbroyden full steps in a row may update the last Jacobian matrix by
+ * Broyden's rank one formula instead. A partial step, a singular matrix
+ * or convergence asks for a new one.
+ */
 
 inum newton_raphson(vector xl,     /* variable vector */
                     vector reltol, /* relative tolerances */
                     vector abstol, /* absolute tolerance */
                     inum maxiter,  /* maximum number of iterations */
+                    inum nbroyden, /* Broyden updates between Jacobians */
                     inum tr        /* trace level */
 ) {
     fnum machinep;       /* machine precision */
@@ -114,7 +134,9 @@ inum newton_raphson(vector xl,     /* variable vector */
     inum maxmin;         /* maximum number of local search steps */
     inum iter;           /* number of iterations */
     inum done;           /* are we finished ? */
-    inum i;
+    inum nupd;           /* Broyden updates since the last Jacobian */
+    fnum dxdx;           /* dxt.dx */
+    inum i, j;
     TMPRINTSTATE *pst;
 
     trace = tr;
@@ -128,6 +150,7 @@ inum newton_raphson(vector xl,     /* variable vector */
     x = xl;
     funceval = 0;
     jaceval = 0;
+    updeval = 0;
 
     /* tolerance for fnorm, approx. precision of transcendentals */
 
@@ -148,6 +171,7 @@ inum newton_raphson(vector xl,     /* variable vector */
 
     ffi = TRUE; /* start by calculating f vector */
     jfi = TRUE; /* start by calculating Jacobian matrix */
+    nupd = 0;
     fnorm = 1.0;
     for (;;) {
 
@@ -159,40 +183,54 @@ inum newton_raphson(vector xl,     /* variable vector */
         /* calculate the residual vector and/or the Jacobian matrix */
 
         ffo = ffi;
-        jfo = jfi;
-        rf = sim_constraints(x, &ffo, f, &jfo, jac, trace - 1);
+        jfo = (jmodel == TRUE) ? jfi : FALSE;
 
-        if ((rf == FALSE) || (ffo != ffi)) {
+        if ((ffo == TRUE) || (jfo == TRUE)) {
 
-            if (trace >= 1) {
-                fprintf(trace_stream, "evaluation error in model\n");
-            }
+            rf = sim_constraints(x, &ffo, f, &jfo, jac, trace - 1);
 
-            done = -1;
-            break;
+            if ((rf == FALSE) || (ffo != ffi)) {
 
-        } else
-            funceval++;
+                if (trace >= 1) {
+                    fprintf(trace_stream, "evaluation error in model\n");
+                }
 
-        if (jfo != jfi) { /* function is unable to supply Jacobian */
+                done = -1;
+                break;
+
+            } else
+                funceval++;
+        }
+
+        if ((jfi == TRUE) && (jfo == FALSE)) { /* model has no Jacobian */
+            jmodel = FALSE;
             if (calcjac(reltol, abstol, jac) == FALSE) {
                 done = -1;
                 break;
             }
-        } else
+        } else if (jfi == TRUE) {
             jaceval++;
+        }
 
         if (ffi == TRUE) {
             fnorm = norm_vector(f);
         }
 
-        /* calculate dx from jac * dx = - f */
+        /* calculate dx from jac * dx = - f, crout overwrites its matrix */
 
         for (i = 0; i < dim; i++) {
             VEC(b, i) = -VEC(f, i);
         }
 
-        if (crout(jac, dx, b) == FALSE) {
+        copy_matrix(jac, lu);
+
+        if (crout(lu, dx, b) == FALSE) {
+            if (nupd > 0) { /* try again with a new Jacobian matrix */
+                ffi = FALSE;
+                jfi = TRUE;
+                nupd = 0;
+                continue;
+            }
             done = -3;
             break;
         }
@@ -209,6 +247,12 @@ inum newton_raphson(vector xl,     /* variable vector */
         fconv = (fnorm < ftol) ? TRUE : FALSE;
 
         if ((xconv == TRUE) && (fconv == TRUE)) {
+            if (nupd > 0) { /* confirm with a new Jacobian matrix */
+                ffi = FALSE;
+                jfi = TRUE;
+                nupd = 0;
+                continue;
+            }
             done = 0; /* true solution found */
             break;
         }
@@ -234,6 +278,8 @@ inum newton_raphson(vector xl,     /* variable vector */
             }
 
             ffi = TRUE;
+            jfi = TRUE;
+            nupd = 0;
 
         } else {
 
@@ -241,6 +287,24 @@ inum newton_raphson(vector xl,     /* variable vector */
 
             ffi = FALSE; /* no need to calculate f */
 
+            /* Broyden: jac += (fn - f - jac.dx).dxt / dxt.dx, jac.dx = -f */
+
+            dxdx = inp_vector(dx, dx);
+
+            if ((nupd < nbroyden) && (dxdx > 0.0)) {
+                for (j = 0; j < dim; j++) {
+                    for (i = 0; i < dim; i++) {
+                        MAT(jac, i, j) += VEC(fn, i) * VEC(dx, j) / dxdx;
+                    }
+                }
+                jfi = FALSE;
+                nupd++;
+                updeval++;
+            } else {
+                jfi = TRUE;
+                nupd = 0;
+            }
+
             for (i = 0; i < dim; i++) {
                 VEC(f, i) = VEC(fn, i);
             }
@@ -276,8 +340,9 @@ inum newton_raphson(vector xl,     /* variable vector */
                 "iteration: %ld, full step: %ld, partial step: %ld\n",
                 (long)iter, (long)fullstep, (long)partstep);
         fprintf(trace_stream,
-                "total f eval: %ld, j eval: %ld, ls f eval: %ld\n",
-                (long)funceval, (long)jaceval, (long)mineval);
+                "total f eval: %ld, j eval: %ld, ls f eval: %ld, "
+                "j update: %ld\n",
+                (long)funceval, (long)jaceval, (long)mineval, (long)updeval);
     }
 
     /* return 0 when valid, < 0 when failed, > 0 when maybe valid */
@@ -32,6 +32,7 @@ extern inum newton_raphson(vector xl,     /* variable vector */
                            vector reltol, /* relative tolerances */
                            vector abstol, /* absolute tolerance */
                            inum maxiter,  /* maximum number of iterations */
+                           inum nbroyden, /* Broyden updates between Jacobians */
                            inum tr        /* trace level */
 );
 
@@ -79,6 +79,22 @@ numblock make_numblock(modeltemplate mt, systemtemplate st, datatemplate dt,
     proc = find_model_proc(mt->id);
 
     if (proc == parxmodelNIL) { /* not an internal model */
+        tmstring plugin;
+        unsigned long long hash;
+        boolean stale;
+
+        /* check for a compiled model plugin, an out of date plugin
+           is skipped and the model is interpreted */
+
+        if ((plugin = find_modelplugin(st->model, &hash)) != tmstringNIL) {
+            proc = load_model_plugin(plugin, mt->id, hash, &stale);
+            if (proc == parxmodelNIL && !stale) { /* error reported */
+                return (numblockNIL);
+            }
+        }
+    }
+
+    if (proc == parxmodelNIL) { /* not a compiled model */
 
         /* check for code file */
 
@@ -110,7 +126,7 @@ numblock make_numblock(modeltemplate mt, systemtemplate st, datatemplate dt,
 
     /* check if data available */
 
-    if (dt->data == datarowNIL) {
+    if (MATM(dt->data->val) == 0) {
         errcode = NO_DATA_SERR;
         error(dt->info);
         return (numblockNIL);
@@ -186,7 +202,7 @@ numblock make_numblock(modeltemplate mt, systemtemplate st, datatemplate dt,
 
         mrs->xstat = rdup_statevector(xstatv);
         mrs->pstat = rdup_statevector(pstatv);
-        mrs->model = (procedure)prx_compute;
+        mrs->model = (procedure)prx_model;
 
         rc = TRUE;
     }
@@ -236,7 +252,7 @@ numblock make_numblock(modeltemplate mt, systemtemplate st, datatemplate dt,
         rci = TRUE;
 
         if (modex == TRUE) {
-            rci = prx_inCode(modi, mcode);
+            rci = prx_inCode(mcode);
             if (rci == FALSE)
                 error(mt->id);
             fclose(mcode);
@@ -632,14 +648,14 @@ aset_list make_auxsset(inum setid, fnum_list aval) {
 }
 
 xgroup_list make_xextgrp(modres mrs, pset parmset, statevector xstat,
-                         inum_list xtrans, fnum_list xval, datarow_list data) {
+                         inum_list xtrans, fnum_list xval, datacolumns dc) {
     xgroup xg;
     xset_list xsl;
     xset xse, xsi;
     vector val, err, abserr, delta;
     procedure Tx;
     inum nset;
-    inum rowid;
+    inum r;
     inum i;
     boolean b;
 
@@ -653,16 +669,16 @@ xgroup_list make_xextgrp(modres mrs, pset parmset, statevector xstat,
 
     xsl = new_xset_list();
 
-    for (nset = 0, rowid = 1; data != datarowNIL; data = data->next, rowid++) {
+    for (nset = 0, r = 0; r < MATM(dc->val); r++) {
 
-        data->rowid = rowid; /* renumber for safety */
-        xse->id = data->rowid;
+        VEC(dc->rowid, r) = r + 1; /* renumber for safety */
+        xse->id = VEC(dc->rowid, r);
 
         /* reorder externals */
 
         for (i = 0; i < LSTS(xtrans); i++) {
-            VEC(xse->val, i) = LST(data->row, LST(xtrans, i));
-            VEC(xse->err, i) = LST(data->err, LST(xtrans, i));
+            VEC(xse->val, i) = MAT(dc->val, r, LST(xtrans, i));
+            VEC(xse->err, i) = MAT(dc->err, r, LST(xtrans, i));
             VEC(xse->abserr, i) = LST(xval, i);
             VEC(xse->delta, i) = 0.0;
         }
@@ -904,9 +920,10 @@ void read_numblock_x(modres mrs, xgroup_list xg, modeltemplate mt,
     procedure Txi;
     vector val, err, abserr, delta;
     xset xe, xi;
-    datarow_list dr;
+    datacolumns dc;
     inum gid; /* group id */
     inum anum;
+    inum r;
     inum i;
     inum idx;
     inum residx;
@@ -944,24 +961,24 @@ void read_numblock_x(modres mrs, xgroup_list xg, modeltemplate mt,
     }
     assert(header != colheadNIL);
 
+    /* add the extra columns to the data table */
+
+    dc = dt->data;
+
+    for (i = 0; i < anum; i++) {
+        (void)add_datacolumn(dc);
+    }
+
     for (; xg != xgroupNIL; xg = xg->next) {
 
         gid = xg->id;
-        dr = datarowNIL;
 
         for (xi = xg->g; xi != xsetNIL; xi = xi->next) {
 
-            dr = find_datarow(dt->data, dr, xi->id);
-            assert(dr != datarowNIL); /* would be very strange */
+            r = xi->id - 1; /* row ids are numbered by make_xextgrp */
+            assert((r >= 0) && (r < MATM(dc->val))); /* would be very strange */
 
-            dr->grpid = gid;
-
-            /* add the extra entries to the data rows */
-
-            for (i = 0; i < anum; i++) {
-                dr->row = append_fnum_list(dr->row, 0.0);
-                dr->err = append_fnum_list(dr->err, 0.0);
-            }
+            VEC(dc->grpid, r) = gid;
 
             if (Txi == procedureNIL) {
                 xe = xi;
@@ -978,18 +995,19 @@ void read_numblock_x(modres mrs, xgroup_list xg, modeltemplate mt,
                 }
             }
 
-            /* put xe back into data row */
+            /* put xe back into data columns */
 
             for (i = 0; i < LSTS(xtrans); i++) {
 
                 idx = LST(xtrans, i);
-                LST(dr->row, idx) = VEC(xe->val, i);
-                LST(dr->err, idx) = VEC(xe->delta, i); /* calculated accuracy */
+                MAT(dc->val, r, idx) = VEC(xe->val, i);
+                /* calculated accuracy */
+                MAT(dc->err, r, idx) = VEC(xe->delta, i);
             }
 
-            /* put residual in data row */
+            /* put residual in data columns */
 
-            LST(dr->row, residx) = xe->res;
+            MAT(dc->val, r, residx) = xe->res;
         }
     }
 
@@ -47,7 +47,7 @@ extern fset_list make_flagset(inum setid, fnum_list fval);
 extern aset_list make_auxsset(inum setid, fnum_list aval);
 extern xgroup_list make_xextgrp(modres mrs, pset parmset, statevector xstat,
                                 inum_list xtrans, fnum_list xval,
-                                datarow_list data);
+                                datacolumns dc);
 extern void read_numblock_p(modres mrs, pset pi, modeltemplate mt,
                             systemtemplate st);
 extern inum set_xst(modeltemplate mt, datatemplate dt, stateflag_list xstat,
@@ -21,7 +21,9 @@
 #include "error.h"
 #include "objectiv.h"
 #include "parx.h"
+#include "prxinter.h"
 #include "residual.h"
+#include "threads.h"
 #include "vecmat.h"
 
 /**************************** global variables *************************/
@@ -39,13 +41,375 @@ static matrix m_jacp; /* memory for Jacobian matrix */
 static vector res;    /* residual vector */
 static matrix jacp;   /* Jacobian matrix */
 
+/*
+ * In streaming mode the Jacobian matrix is not stored. The rows of each
+ * point are folded, together with its residuals, into the triangular factor
+ * R of the QR decomposition of [Jp | r]. The parallel evaluation folds each
+ * chunk of points into a factor of its own, these are combined in order.
+ */
+
+int parx_stream = 0; /* fold the Jacobian matrix into its R factor */
+
+static boolean stream; /* Jacobian matrix is streamed */
+static matrix rfac;    /* R factor of [Jp | r] */
+static matrix rjac;    /* R factor of Jp, part of rfac */
+static vector qtr;     /* Qt.r, last column of rfac */
+static matrix *rchunk; /* R factors of the chunks */
+static inum nchunk;    /* number of chunks */
+
+static inum xmc_r;  /* model residual evaluations outside objective() */
+static inum xmc_jx; /* model Jx evaluations outside objective() */
+static inum xmc_jp; /* model Jp evaluations outside objective() */
+
+/*
+ * The distance solve of each point starts from its previous solution, kept
+ * in a table indexed by point id. The table is not used if the ids are not
+ * unique.
+ */
+
+static inum xsidn;       /* size of the warm start table */
+static vector *xsstate;  /* warm start state of the distance solve */
+static boolean *xswarm;  /* warm start state is valid */
+
+/*
+ * The points are evaluated in parallel by a pool of threads, each with its
+ * own residual workspace. Point k of all groups writes rows k * nr of the
+ * residual vector and Jacobian matrix, after which the serial loop takes
+ * over the results in list order, moving rows down over failed points.
+ * Points after a failed point that ends the point set do not count, so
+ * their warm start state is only taken over by the serial loop, and a
+ * chunk stops folding rows into its R factor at such a point.
+ */
+
+static THREAD_POOL *pool; /* worker threads, NULL if serial */
+static inum maxneq;       /* maximum number of equations */
+static inum maxpnt;       /* maximum number of points */
+static xset *xspoint;     /* points of all groups, in evaluation order */
+static boolean *xsok;     /* residual evaluation of the point succeeded */
+static inum *xscalls;     /* model evaluations (r, Jx, Jp) per point */
+static vector *xsnext;    /* warm start state of each point, if evaluated */
+static boolean *xsnwarm;  /* warm start state of the point is valid */
+static boolean *rcut;     /* a point of the chunk ended the point set */
+
+static THREAD_LOCAL vector w_subr; /* sub residual vector of the thread */
+static THREAD_LOCAL matrix w_subj; /* sub Jacobian matrix of the thread */
+static THREAD_LOCAL matrix w_blk;  /* [Jp | r] of a point, if streamed */
+
+/*
+ * Trial steps of the line search are evaluated together, item t being point
+ * t % n at step t / n. The points are evaluated with a private copy of their
+ * set of measurements and warm start state, so that the same point can be
+ * evaluated at different steps at the same time.
+ */
+
+static inum ntrial;      /* number of trial steps the buffers are sized for */
+static vector *trial_p;  /* parameter values of each trial step */
+static fnum *trial_sq;   /* sum of squared residuals per item */
+static fnum *trial_sl;   /* slope per item */
+static boolean *trial_ok; /* residual evaluation of the item succeeded */
+static inum *trial_mc;   /* model evaluations (r, Jx, Jp) per item */
+static inum ndelta;      /* dimension of the residual vector of an xset */
+
+static THREAD_LOCAL xset w_xs;     /* private copy of a set of measurements */
+static THREAD_LOCAL vector w_ws;   /* private copy of a warm start state */
+static THREAD_LOCAL vector w_resr; /* residuals of an item */
+static THREAD_LOCAL matrix w_resj; /* Jacobian rows of an item */
+
+typedef struct {
+    vector p;    /* parameter values */
+    boolean rf;  /* residual flag */
+    boolean jf;  /* Jacobian flag */
+    inum chunk;  /* number of points per chunk */
+    boolean cut; /* a failed point ends the point set */
+    inum trace;  /* trace level */
+} OBJ_JOB;
+
+typedef struct {
+    vector dp;  /* step direction */
+    inum npnt;  /* number of points */
+    inum trace; /* trace level */
+} OBJ_TRIAL;
+
 /***********************************************************************/
 
+/* warm start state of a point */
+
+static vector warm_state(xset xs) {
+    return ((xsstate != NULL) ? xsstate[xs->id] : vectorNIL);
+}
+
+static boolean *warm_flag(xset xs) {
+    return ((xsstate != NULL) ? xswarm + xs->id : NULL);
+}
+
+static void fre_warm_start(void) {
+    inum i;
+
+    if (xsstate == NULL) {
+        return;
+    }
+
+    for (i = 0; i < xsidn; i++) {
+        if (xsstate[i] != vectorNIL) {
+            rfre_vector(xsstate[i]);
+        }
+    }
+    TM_FREE(xsstate);
+    TM_FREE(xswarm);
+    xsstate = NULL;
+}
+
+/* setup the warm start table for all points of the group */
+
+static void new_warm_start(xgroup xg) {
+    xset xs;
+    inum i;
+
+    xsidn = 0;
+    for (xs = xg->g; xs != xsetNIL; xs = xs->next) {
+        if (xs->id < 0) {
+            xsstate = NULL;
+            return;
+        }
+        xsidn = MAX(xsidn, xs->id + 1);
+    }
+
+    xsstate = TM_MALLOC(vector *, xsidn * sizeof(vector));
+    xswarm = TM_MALLOC(boolean *, xsidn * sizeof(boolean));
+
+    for (i = 0; i < xsidn; i++) {
+        xsstate[i] = vectorNIL;
+        xswarm[i] = FALSE;
+    }
+
+    for (xs = xg->g; xs != xsetNIL; xs = xs->next) {
+        if (xsstate[xs->id] != vectorNIL) { /* duplicate id */
+            fre_warm_start();
+            return;
+        }
+        xsstate[xs->id] = new_residual_state();
+    }
+}
+
+/* sub residual vector and Jacobian matrix of the calling thread */
+
+static void new_point_work(void) {
+    w_subr = new_sub_vector(m_res);
+
+    if (stream == TRUE) {
+        w_blk = rnew_matrix(nr, np + 1);
+        w_subj = new_sub_matrix(w_blk);
+        sub_matrix(w_blk, 0, 0, nr, np, w_subj);
+    } else {
+        w_subj = new_sub_matrix(m_jacp);
+    }
+
+    w_xs = new_xset(0, vectorNIL, vectorNIL, vectorNIL, rnew_vector(ndelta),
+                    0.0);
+    w_ws = (xsstate != NULL) ? new_residual_state() : vectorNIL;
+    w_resr = rnew_vector(nr);
+    w_resj = rnew_matrix(nr, np);
+}
+
+static void fre_point_work(void) {
+    fre_sub_vector(w_subr);
+    fre_sub_matrix(w_subj);
+
+    if (stream == TRUE) {
+        rfre_matrix(w_blk);
+    }
+
+    rfre_vector(w_xs->delta);
+    fre_xset(w_xs);
+    if (w_ws != vectorNIL) {
+        rfre_vector(w_ws);
+    }
+    rfre_vector(w_resr);
+    rfre_matrix(w_resj);
+}
+
+/* fold the Jacobian rows in w_blk and the residuals of a point into r */
+
+static void fold_point(vector subr, matrix r) {
+    copy_vec_col(subr, w_blk, np);
+    qr_addrows(r, w_blk);
+}
+
+static void zero_factor(matrix r) {
+    inum i, j;
+
+    for (j = 0; j < MATN(r); j++) {
+        for (i = 0; i < MATM(r); i++) {
+            MAT(r, i, j) = 0.0;
+        }
+    }
+}
+
+/* worker thread start and stop */
+
+static void objective_start(void) {
+    new_vecmat(maxneq, np);
+    new_residual_work();
+    new_point_work();
+}
+
+static void objective_stop(void) {
+    fre_point_work();
+    fre_residual_work();
+    fre_vecmat();
+    prx_releaseContext();
+}
+
+/* residual of point k, in its own rows */
+
+static void objective_point(void *arg, inum k) {
+    OBJ_JOB *job;
+    vector ws;
+    boolean *wf;
+    inum *calls;
+    inum c;
+
+    job = (OBJ_JOB *)arg;
+    calls = xscalls + 3 * k;
+    calls[0] = calls[1] = calls[2] = 0;
+
+    if (job->rf == TRUE) {
+        sub_vector(res, k * nr, nr, w_subr);
+    }
+    if ((job->jf == TRUE) && (stream == FALSE)) {
+        sub_matrix(jacp, k * nr, 0, nr, np, w_subj);
+    }
+
+    ws = vectorNIL;
+    wf = NULL;
+    if (xsstate != NULL) { /* taken over by objective_take() */
+        copy_vector(xsstate[xspoint[k]->id], xsnext[k]);
+        xsnwarm[k] = xswarm[xspoint[k]->id];
+        ws = xsnext[k];
+        wf = xsnwarm + k;
+    }
+
+    xsok[k] = residual(xspoint[k], job->p, job->rf, w_subr, job->jf, w_subj,
+                       FALSE, matrixNIL, ws, wf, calls, calls + 1, calls + 2,
+                       job->trace);
+
+    c = k / job->chunk; /* the points of a chunk are evaluated in order */
+
+    if ((job->jf == TRUE) && (stream == TRUE) && (rcut[c] == FALSE)) {
+        if (xsok[k] == TRUE) {
+            fold_point(w_subr, rchunk[c]);
+        } else if (job->cut == TRUE) {
+            rcut[c] = TRUE;
+        }
+    }
+}
+
+/* sum of squared residuals and slope of item t of the trial steps */
+
+static void objective_trial(void *arg, inum t) {
+    OBJ_TRIAL *job;
+    xset xs;
+    vector ws;
+    boolean wf;
+    inum *calls;
+    fnum f, sq, sl;
+    inum i, c;
+
+    job = (OBJ_TRIAL *)arg;
+    xs = xspoint[t % job->npnt];
+    calls = trial_mc + 3 * t;
+    calls[0] = calls[1] = calls[2] = 0;
+
+    w_xs->id = xs->id;
+    w_xs->val = xs->val;
+    w_xs->err = xs->err;
+    w_xs->abserr = xs->abserr;
+
+    ws = vectorNIL;
+    wf = FALSE;
+    if (w_ws != vectorNIL) {
+        copy_vector(xsstate[xs->id], w_ws);
+        wf = xswarm[xs->id];
+        ws = w_ws;
+    }
+
+    trial_ok[t] = residual(w_xs, trial_p[t / job->npnt], TRUE, w_resr, TRUE,
+                           w_resj, FALSE, matrixNIL, ws, &wf, calls, calls + 1,
+                           calls + 2, job->trace);
+
+    for (sq = sl = 0.0, i = 0; (trial_ok[t] == TRUE) && (i < nr); i++) {
+        for (f = 0.0, c = 0; c < np; c++) {
+            f += MAT(w_resj, i, c) * VEC(job->dp, c);
+        }
+        sq += VEC(w_resr, i) * VEC(w_resr, i);
+        sl += VEC(w_resr, i) * f;
+    }
+    trial_sq[t] = sq;
+    trial_sl[t] = sl;
+}
+
+/* free the buffers of the trial steps */
+
+static void fre_trial(void) {
+    inum i;
+
+    if (ntrial == 0) {
+        return;
+    }
+
+    for (i = 0; i < ntrial; i++) {
+        rfre_vector(trial_p[i]);
+    }
+    TM_FREE(trial_p);
+    TM_FREE(trial_sq);
+    TM_FREE(trial_sl);
+    TM_FREE(trial_ok);
+    TM_FREE(trial_mc);
+    ntrial = 0;
+}
+
+/* take over the result of point k into rows i */
+
+static boolean objective_take(inum k, inum i, vector subr, matrix subj,
+                              boolean rf, boolean jf, inum *mc_r, inum *mc_jx,
+                              inum *mc_jp) {
+    vector ws;
+    inum id;
+
+    if (xsstate != NULL) {
+        id = xspoint[k]->id;
+        ws = xsstate[id];
+        xsstate[id] = xsnext[k];
+        xsnext[k] = ws;
+        xswarm[id] = xsnwarm[k];
+    }
+
+    *mc_r += xscalls[3 * k];
+    *mc_jx += xscalls[3 * k + 1];
+    *mc_jp += xscalls[3 * k + 2];
+
+    if ((xsok[k] == FALSE) || (k * nr == i)) {
+        return (xsok[k]);
+    }
+
+    if (rf == TRUE) {
+        sub_vector(res, k * nr, nr, w_subr);
+        copy_vector(w_subr, subr);
+    }
+    if (jf == TRUE) {
+        sub_matrix(jacp, k * nr, 0, nr, np, w_subj);
+        copy_matrix(w_subj, subj);
+    }
+
+    return (TRUE);
+}
+
 boolean objective(vector p,       /* parameter values */
                   boolean rf,     /* residual flag */
                   vector *rp,     /* pointer to residual vector */
                   boolean jf,     /* Jacobian flag */
                   matrix *jpp,    /* pointer to Jacobian matrix */
+                  vector *qrp,    /* pointer to Qt.r if Jp is streamed */
                   boolean modify, /* allow modify point set */
                   boolean all,    /* evaluate objective for all points */
                   inum *npoints,  /* remaining number of data points */
@@ -67,13 +431,23 @@ boolean objective(vector p,       /* parameter values */
     inum xi, xn; /* point counter */
     boolean ok;
     inum grp;
-    inum i;
+    inum i, c;
     TMPRINTSTATE *pst;
 
+    boolean par;   /* points evaluated in parallel */
+    inum k;        /* index in xspoint */
+    inum base[3];  /* first index of each group in xspoint */
+    inum nfold;    /* number of chunks folded into R */
+    OBJ_JOB job;
+
     if ((rf == FALSE) && (jf == FALSE)) { /* easy question */
         return (TRUE);
     }
 
+    if ((stream == TRUE) && (jf == TRUE)) { /* residuals are folded with Jp */
+        rf = TRUE;
+    }
+
     if (trace >= 1) {
         fputs("\nobjective function evaluation.\nparameters:\n", trace_stream);
         pst = tm_setprint(trace_stream, 0, 80, 8, 0);
@@ -101,7 +475,10 @@ boolean objective(vector p,       /* parameter values */
 
     subj = matrixNIL;
 
-    if (jf == TRUE) { /* allocate sub Jacobian matrix */
+    if ((jf == TRUE) && (stream == TRUE)) { /* fold rows of points into R */
+        subj = w_subj;
+        zero_factor(rfac);
+    } else if (jf == TRUE) { /* allocate sub Jacobian matrix */
         sub_matrix(m_jacp, 0, 0, neq, np, jacp);
         *jpp = jacp;
         subj = new_sub_matrix(jacp);
@@ -117,6 +494,35 @@ boolean objective(vector p,       /* parameter values */
 
     ok = TRUE;
     xn = xg_in->n;
+    nfold = nchunk;
+
+    /* evaluate all points in parallel, tracing needs the serial order */
+
+    par = ((pool != NULL) && (trace < 2)) ? TRUE : FALSE;
+
+    if (par == TRUE) {
+        for (k = 0, grp = 0; grp <= (all == TRUE ? 2 : 0); grp++) {
+            base[grp] = k;
+            xs = (grp == 0) ? xg_in->g : (grp == 1) ? xg_out->g : xg_fail->g;
+            for (; xs != xsetNIL; xs = xs->next) {
+                xspoint[k++] = xs;
+            }
+        }
+
+        job.p = p;
+        job.rf = rf;
+        job.jf = jf;
+        job.chunk = MAX((k + nchunk - 1) / nchunk, 1);
+        job.cut = ((modify == FALSE) && (all == FALSE)) ? TRUE : FALSE;
+        job.trace = trace - 2;
+
+        for (c = 0; (jf == TRUE) && (stream == TRUE) && (c < nchunk); c++) {
+            zero_factor(rchunk[c]);
+            rcut[c] = FALSE;
+        }
+
+        pool_for(pool, k, job.chunk, objective_point, &job);
+    }
 
     for (grp = 0; grp <= (all == TRUE ? 2 : 0); grp++) {
 
@@ -132,6 +538,8 @@ boolean objective(vector p,       /* parameter values */
             break;
         }
 
+        k = (par == TRUE) ? base[grp] : 0;
+
         for (xi = 0, i = 0; xs != xsetNIL;) {
 
             if (trace >= 2) {
@@ -146,14 +554,21 @@ boolean objective(vector p,       /* parameter values */
                 sub_vector(res, i, nr, subr);
             }
 
-            if (jf == TRUE) { /* set sub Jacobian */
+            if ((jf == TRUE) && (stream == FALSE)) { /* set sub Jacobian */
                 sub_matrix(jacp, i, 0, nr, np, subj);
             }
 
             *(xsindex + xi) = xs; /* setup xsindex to point */
 
-            ok = residual(xs, p, rf, subr, jf, subj, sf, s, &lmc_r, &lmc_jx,
-                          &lmc_jp, trace - 2);
+            if (par == TRUE) {
+                ok = objective_take(k++, i, subr, subj, rf,
+                                    (stream == TRUE) ? FALSE : jf, &lmc_r,
+                                    &lmc_jx, &lmc_jp);
+            } else {
+                ok = residual(xs, p, rf, subr, jf, subj, sf, s, warm_state(xs),
+                              warm_flag(xs), &lmc_r, &lmc_jx, &lmc_jp,
+                              trace - 2);
+            }
 
             if (ok == FALSE) { /* failed */
 
@@ -171,6 +586,9 @@ boolean objective(vector p,       /* parameter values */
 
                 if (modify == FALSE) { /* not allowed to remove failed point */
                     xn = xi;
+                    if (par == TRUE) { /* the chunks upto the failed point */
+                        nfold = (k - 1) / job.chunk + 1;
+                    }
                     break;
                 }
 
@@ -209,6 +627,10 @@ boolean objective(vector p,       /* parameter values */
                 tm_endprint(pst);
                 fputc('\n', trace_stream);
             }
+
+            if ((jf == TRUE) && (stream == TRUE) && (par == FALSE)) {
+                fold_point(subr, rfac);
+            }
         }
     }
 
@@ -224,9 +646,19 @@ boolean objective(vector p,       /* parameter values */
         fre_sub_vector(subr);
     }
 
-    if (jf == TRUE) {
+    if ((jf == TRUE) && (stream == TRUE)) {
+        for (c = 0; (par == TRUE) && (c < nfold); c++) {
+            qr_addrows(rfac, rchunk[c]); /* combine chunks in order */
+        }
+        for (c = 0; c < np; c++) {
+            VEC(qtr, c) = MAT(rfac, c, np);
+        }
+        *jpp = rjac;
+        *qrp = qtr;
+    } else if (jf == TRUE) {
         sub_matrix(m_jacp, 0, 0, neq, np, jacp);
         *jpp = jacp;
+        *qrp = vectorNIL;
 
         fre_sub_matrix(subj);
     }
@@ -237,9 +669,11 @@ boolean objective(vector p,       /* parameter values */
 
     /* add evaluation count */
 
-    *mc_r += lmc_r;
-    *mc_jx += lmc_jx;
-    *mc_jp += lmc_jp;
+    *mc_r += lmc_r + xmc_r;
+    *mc_jx += lmc_jx + xmc_jx;
+    *mc_jp += lmc_jp + xmc_jp;
+
+    xmc_r = xmc_jx = xmc_jp = 0;
 
     if (trace >= 1) {
 
@@ -269,6 +703,8 @@ boolean new_objective(numblock numb, /* numerical data block */
                       inum *maxeq,   /* maximum number of equations */
                       inum *ngroup   /* number of equations per point */
 ) {
+    inum i;
+
     /* test if data is available */
 
     if (numb->x->n == 0) {
@@ -301,27 +737,119 @@ boolean new_objective(numblock numb, /* numerical data block */
     m_res = rnew_vector(neq);
     res = new_sub_vector(m_res);
 
-    m_jacp = rnew_matrix(neq, np);
-    jacp = new_sub_matrix(m_jacp);
+    stream = (parx_stream != 0) ? TRUE : FALSE;
+
+    if (stream == TRUE) {
+        m_jacp = matrixNIL;
+        jacp = matrixNIL;
+
+        rfac = rnew_matrix(np + 1, np + 1);
+        rjac = new_sub_matrix(rfac);
+        sub_matrix(rfac, 0, 0, np, np, rjac);
+        qtr = rnew_vector(np);
+    } else {
+        m_jacp = rnew_matrix(neq, np);
+        jacp = new_sub_matrix(m_jacp);
+    }
+
+    xmc_r = xmc_jx = xmc_jp = 0;
 
     *maxeq = neq;
     *ngroup = nr;
 
     /* setup vecmat library */
 
+    maxneq = neq;
     new_vecmat(neq, np); /* maximum problem size */
 
+    new_warm_start(xg_in);
+
+    maxpnt = xg_in->n;
+    ndelta = VECN(xg_in->g->delta);
+    ntrial = 0;
+
+    /* setup threads for the parallel evaluation of points */
+
+    new_point_work();
+
+    pool = NULL;
+    if (MIN(thread_count(), xg_in->n) > 1) {
+        xspoint = TM_MALLOC(xset *, maxpnt * sizeof(xset));
+        xsok = TM_MALLOC(boolean *, maxpnt * sizeof(boolean));
+        xscalls = TM_MALLOC(inum *, 3 * maxpnt * sizeof(inum));
+
+        if (xsstate != NULL) {
+            xsnext = TM_MALLOC(vector *, maxpnt * sizeof(vector));
+            xsnwarm = TM_MALLOC(boolean *, maxpnt * sizeof(boolean));
+            for (i = 0; i < maxpnt; i++) {
+                xsnext[i] = new_residual_state();
+            }
+        }
+
+        pool = new_pool(MIN(thread_count(), xg_in->n), objective_start,
+                        objective_stop);
+
+        nchunk = 4 * pool_size(pool);
+        if (stream == TRUE) {
+            rchunk = TM_MALLOC(matrix *, nchunk * sizeof(matrix));
+            rcut = TM_MALLOC(boolean *, nchunk * sizeof(boolean));
+            for (i = 0; i < nchunk; i++) {
+                rchunk[i] = rnew_matrix(np + 1, np + 1);
+            }
+        }
+    }
+
     return (TRUE);
 }
 
 void fre_objective(numblock numb) {
+    inum i;
+
+    prx_reportFault();
+
+    if (pool != NULL) {
+        fre_pool(pool);
+        pool = NULL;
+
+        TM_FREE(xspoint);
+        TM_FREE(xsok);
+        TM_FREE(xscalls);
+
+        if (xsstate != NULL) {
+            for (i = 0; i < maxpnt; i++) {
+                rfre_vector(xsnext[i]);
+            }
+            TM_FREE(xsnext);
+            TM_FREE(xsnwarm);
+        }
+
+        for (i = 0; (stream == TRUE) && (i < nchunk); i++) {
+            rfre_matrix(rchunk[i]);
+        }
+        if (stream == TRUE) {
+            TM_FREE(rchunk);
+            TM_FREE(rcut);
+        }
+    }
+
+    fre_point_work();
+    fre_trial();
+
+    fre_warm_start();
+
     TM_FREE(xsindex);
 
     fre_sub_vector(res);
     rfre_vector(m_res);
 
-    fre_sub_matrix(jacp);
-    rfre_matrix(m_jacp);
+    if (stream == TRUE) {
+        fre_sub_matrix(rjac);
+        rfre_matrix(rfac);
+        rfre_vector(qtr);
+    } else {
+        fre_sub_matrix(jacp);
+        rfre_matrix(m_jacp);
+    }
 
     if (xg_in->n != 0)
         numb->x = xg_in;
@@ -345,6 +873,115 @@ void fre_objective(numblock numb) {
 
 /* move a data point from the active to an inactive group */
 
+/*
+ * Evaluate the norm of the residual vector and the slope in the step
+ * direction for several trial steps at once. Return FALSE, without any
+ * evaluation, if the points are not evaluated in parallel. A failed
+ * evaluation results in INF for both.
+ */
+
+boolean objective_line(vector p,     /* parameter values */
+                       vector dp,    /* step direction */
+                       vector alpha, /* trial step sizes */
+                       vector fval,  /* norm of the residual vector */
+                       vector slope, /* gradient relative to step direction */
+                       inum *mc_r,   /* total number of model evaluations */
+                       inum *mc_jx,  /* total number of model Jx evaluations */
+                       inum *mc_jp,  /* total number of model Jp evaluations */
+                       inum trace    /* trace level */
+) {
+    OBJ_TRIAL job;
+    xset xs;
+    boolean ok;
+    fnum sq, sl;
+    inum n, a, k, t, i;
+
+    if ((pool == NULL) || (trace >= 2)) {
+        return (FALSE);
+    }
+
+    n = xg_in->n;
+
+    if (VECN(alpha) > ntrial) { /* resize buffers */
+        fre_trial();
+
+        ntrial = VECN(alpha);
+        trial_p = TM_MALLOC(vector *, ntrial * sizeof(vector));
+        for (i = 0; i < ntrial; i++) {
+            trial_p[i] = rnew_vector(np);
+        }
+        trial_sq = TM_MALLOC(fnum *, ntrial * maxpnt * sizeof(fnum));
+        trial_sl = TM_MALLOC(fnum *, ntrial * maxpnt * sizeof(fnum));
+        trial_ok = TM_MALLOC(boolean *, ntrial * maxpnt * sizeof(boolean));
+        trial_mc = TM_MALLOC(inum *, 3 * ntrial * maxpnt * sizeof(inum));
+    }
+
+    for (k = 0, xs = xg_in->g; xs != xsetNIL; xs = xs->next) {
+        xspoint[k++] = xs;
+    }
+
+    for (a = 0; a < VECN(alpha); a++) {
+        for (i = 0; i < np; i++) {
+            VEC(trial_p[a], i) = VEC(p, i) + VEC(alpha, a) * VEC(dp, i);
+        }
+    }
+
+    job.dp = dp;
+    job.npnt = n;
+    job.trace = trace - 2;
+
+    t = VECN(alpha) * n;
+    pool_for(pool, t, MAX((t + nchunk - 1) / nchunk, 1), objective_trial,
+             &job);
+
+    /* sum the results of each trial step in point order */
+
+    for (t = 0, a = 0; a < VECN(alpha); a++) {
+        for (ok = TRUE, sq = sl = 0.0, k = 0; k < n; k++, t++) {
+            ok = (trial_ok[t] == TRUE) ? ok : FALSE;
+            sq += trial_sq[t];
+            sl += trial_sl[t];
+            *mc_r += trial_mc[3 * t];
+            *mc_jx += trial_mc[3 * t + 1];
+            *mc_jp += trial_mc[3 * t + 2];
+        }
+        VEC(fval, a) = (ok == TRUE) ? sqrt(sq) : INF;
+        VEC(slope, a) = (ok == TRUE) ? sl : INF;
+    }
+
+    return (TRUE);
+}
+
+/*
+ * Call body(arg, i) for the n active points, on the threads of the objective
+ * function if there are any. The calls may use the vecmat workspace.
+ */
+
+void objective_for(inum n, void (*body)(void *arg, inum i), void *arg) {
+    inum i;
+
+    if (pool == NULL) {
+        for (i = 0; i < n; i++) {
+            (*body)(arg, i);
+        }
+        return;
+    }
+
+    pool_for(pool, n, MAX((n + nchunk - 1) / nchunk, 1), body, arg);
+}
+
+/* Jacobian rows of active point n, as used by the last objective() */
+
+boolean objective_jacobian(vector p,  /* parameter values */
+                           inum n,    /* index of point */
+                           matrix jp, /* Jacobian rows of the point */
+                           inum trace /* trace level */
+) {
+    return (residual(xsindex[n], p, FALSE, vectorNIL, TRUE, jp, FALSE,
+                     matrixNIL, warm_state(xsindex[n]), warm_flag(xsindex[n]),
+                     &xmc_r, &xmc_jx, &xmc_jp, trace));
+}
+
 inum remove_data_point(inum n,    /* xsindex of point to be moved */
                        inum g,    /* target group */
                        inum trace /* trace level */
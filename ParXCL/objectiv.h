@@ -30,6 +30,7 @@ objective(vector p,       /* parameter values */
           vector *rp,     /* pointer to residual vector */
           boolean jf,     /* Jacobian flag */
           matrix *jpp,    /* pointer to Jacobian matrix */
+          vector *qrp,    /* pointer to Qt.r if Jp is streamed */
           boolean modify, /* allow modify point set */
           boolean all,    /* evaluate objective for all points */
           inum *npoints,  /* remaining number of data points */
@@ -48,6 +49,25 @@ extern boolean new_objective(numblock numb, /* numerical data block */
 
 extern void fre_objective(numblock numb);
 
+extern boolean objective_line(vector p,     /* parameter values */
+                              vector dp,    /* step direction */
+                              vector alpha, /* trial step sizes */
+                              vector fval,  /* norm of the residual vector */
+                              vector slope, /* gradient relative to dp */
+                              inum *mc_r,   /* total number of model evals */
+                              inum *mc_jx,  /* total number of Jx evals */
+                              inum *mc_jp,  /* total number of Jp evals */
+                              inum trace    /* trace level */
+);
+
+extern void objective_for(inum n, void (*body)(void *arg, inum i), void *arg);
+
+extern boolean objective_jacobian(vector p,  /* parameter values */
+                                  inum n,    /* index of point */
+                                  matrix jp, /* Jacobian rows of the point */
+                                  inum trace /* trace level */
+);
+
 extern inum remove_data_point(inum n,    /* index of point to be moved */
                               inum g,    /* target group */
                               inum trace /* trace level */
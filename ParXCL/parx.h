@@ -62,10 +62,37 @@ extern char *input_path; /* Input subdirectory */
 #define MODEL_EXT ".parx"
 #define MODEL_INTERFACE_EXT ".pxi"
 #define MODEL_CODE_EXT ".pxc"
+#define MODEL_STAMP_EXT ".pxh"
 #define SYSTEM_EXT ".pxs"
 #define DATATABLE_EXT ".pxd"
 #define CSV_EXT ".csv"
 #define JSON_EXT ".json"
+#define BINARY_EXT ".pxb"
+#define MODEL_C_EXT ".c"
+
+#if defined(WINDOWS) || defined(WIN32) || defined(WIN64)
+#define MODEL_PLUGIN_EXT ".dll"
+#define MODEL_CC "gcc -O2 -shared"
+#else
+#define MODEL_PLUGIN_EXT ".so"
+#define MODEL_CC "cc -O2 -shared -fPIC"
+#endif
+
+/* the environment variable PARX_CC replaces MODEL_CC, the command that
+   builds the C source of a model into a plugin */
+#define MODEL_CC_ENV "PARX_CC"
+
+/* storage class of data private to each thread */
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+extern int prx_ccode; /* also build compiled models into C plugins */
+extern int parx_threads; /* number of threads, 0: one per processor */
+extern int parx_stream;  /* fold the Jacobian matrix into its R factor */
 /* default streams */
 
 extern FILE *yyin, *yyout; /* we are using Lex and Yacc */
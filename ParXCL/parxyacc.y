@@ -45,6 +45,10 @@ static fnum prec = DEFPREC;         /* default precision */
 static fnum tolerance = DEFTOL;     /* default tolerance */
 
 static inum maxiter = 0L;           /* maximum # of iterations, 0 is default */
+static inum nprune = 1L;            /* # of data points removed at once */
+static inum nstart = 1L;            /* number of extraction starts */
+static inum nbroyden = 0L;          /* # of Broyden updates in simulation */
+static inum ncont = 0L;             /* continuation along simulated curves */
 static opttype optfl = MODES;       /* request optimization type */
 
 static dbnode src_dbnode;           /* dbase source node */
@@ -93,7 +97,7 @@ static union {
 %token      _EXIT _CLEAR
 
 %token      _TRACE
-%token      _ITER
+%token      _ITER _PRUNE _STARTS _BROYDEN _CONT
 %token      _TOL _PREC _SENS
 %token      _CRIT _MODES _BESTFIT _CHISQ _STRICT _CONSIST
 
@@ -440,6 +444,34 @@ action      :   _CRIT   '=' _MODES ';'
             |   _ITER   ';'
             {   fprintf(output_stream, "iter = %ld\n", (long) maxiter); }
 
+            |   _PRUNE  '=' _INTVALUE   ';'
+            {   nprune = $3 >= 1L ? $3 : 1L;        }
+            |   _PRUNE  '=' '@' ';'
+            {   nprune = 1L;                        }
+            |   _PRUNE  ';'
+            {   fprintf(output_stream, "prune = %ld\n", (long) nprune); }
+
+            |   _STARTS '=' _INTVALUE   ';'
+            {   nstart = $3 >= 1L ? $3 : 1L;        }
+            |   _STARTS '=' '@' ';'
+            {   nstart = 1L;                        }
+            |   _STARTS ';'
+            {   fprintf(output_stream, "starts = %ld\n", (long) nstart); }
+
+            |   _BROYDEN '=' _INTVALUE  ';'
+            {   nbroyden = $3 >= 0L ? $3 : 0L;      }
+            |   _BROYDEN '=' '@' ';'
+            {   nbroyden = 0L;                      }
+            |   _BROYDEN ';'
+            {   fprintf(output_stream, "broyden = %ld\n", (long) nbroyden); }
+
+            |   _CONT   '=' _INTVALUE   ';'
+            {   ncont = $3 >= 0L ? ($3 <= 2L ? $3 : 2L) : 0L; }
+            |   _CONT   '=' '@' ';'
+            {   ncont = 0L;                         }
+            |   _CONT   ';'
+            {   fprintf(output_stream, "cont = %ld\n", (long) ncont); }
+
             |   _TOL    '=' value   ';'
             {   if (($3 >= 0.0) || ($3 <= 1.0))
                     tolerance = $3;                 }
@@ -487,11 +519,11 @@ action      :   _CRIT   '=' _MODES ';'
 
             |   _EXT    parxsymbol  parxsymbol  ';'
             {   call_extract(SYM($2), SYM($3), prec, tolerance, optfl, sens,
-                    maxiter, trace_ext);                    }
+                    maxiter, nprune, nstart, trace_ext);    }
 
             |   _SIM parxsymbol parxsymbol parxsymbol   ';'
             {   call_simulate(SYM($2), SYM($3), SYM($4), prec, maxiter,
-                trace_sim);                         }
+                nbroyden, ncont, trace_sim);                         }
 
             |   _PLOT   parxsymbollist  ';'
             {   plot(SYMLIST($2), tmstringNIL);     }
@@ -210,7 +210,7 @@ static void show_sys(dbnode n) {
 static void show_data(dbnode n) {
     datatemplate dt;
     colhead_list h;
-    datarow_list dr;
+    inum r;
     inum nump, nums, numu, numf, numo;
 
     fprintf(output_stream, "Data: %s\n", to_Datatable(n)->dataname);
@@ -223,9 +223,9 @@ static void show_data(dbnode n) {
 
     /* count number of points */
     nump = numf = numu = nums = numo = 0L;
-    for (dr = dt->data; dr != datarowNIL; dr = dr->next) {
+    for (r = 0; r < MATM(dt->data->val); r++) {
         nump++;
-        switch (dr->grpid) {
+        switch (VEC(dt->data->grpid, r)) {
         case FGROUP:
             numf++;
             break;
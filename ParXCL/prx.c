@@ -58,17 +58,31 @@
     p = (PRX_NODE *)mem_slot(Tree, sizeof(PRX_NODE));                          \
     p->opr = op;                                                               \
     p->o1 = op1;                                                               \
-    p->c.o2 = op2;
+    p->c.o2 = op2;                                                             \
+    p->val = NULL;
 
 #define WRITEM(i)                                                              \
     {                                                                          \
-        sh = (i);                                                              \
-        if (!fwrite((void *)&sh, sizeof(sh), 1, oFile)) {                      \
+        CODEWORD w = (CODEWORD)(i);                                            \
+        if (!bCount && !fwrite((void *)&w, sizeof(w), 1, oFile)) {             \
             write_error();                                                     \
             return 0;                                                          \
         }                                                                      \
     }
 
+/* write an operator, following the depth of the operand stack */
+#define WRITEO(o)                                                              \
+    {                                                                          \
+        OPR op = (o);                                                          \
+        if (!bCount) {                                                         \
+            nStack += prx_stack(op);                                           \
+            if (nStack > nStackMax) {                                          \
+                nStackMax = nStack;                                            \
+            }                                                                  \
+        }                                                                      \
+        WRITEM(op);                                                            \
+    }
+
 static const struct {
     char *name;
     OPR opr;
@@ -95,21 +109,25 @@ static int bAssign; /* subexpression can start with assign */
 static char *sModel, *sDate, *sAuthor, *sVersion, *sIdent;
 static int nVar, nAux, nPar, nCon, nFlag;
 static int nRes, nNum, nTmp;
+static int nStack, nStackMax; /* depth of the operand stack of the code */
 static HEADER *sVar, *sAux, *sPar, *sCon, *sFlg;
 static HEADER *sRes;
 static double *Nums;
 
-static PRX_NODE *NodeH[MAXEQU]; /* array of tree pointers */
-static PRX_NODE **pHead;        /* pointer for array NodeH */
-static int nHead;               /* number of expression trees */
+static PRX_NODE **NodeH; /* array of tree pointers */
+static PRX_NODE **pHead; /* pointer for array NodeH */
+static int nHead;        /* number of expression trees */
+static int szHead;       /* allocated size of NodeH */
 
-static PRX_NODE *pNode;          /* pointer to any node in a tree */
-static PRX_NODE *St[128], **pSt; /* priority stack */
-static char Prio[32];            /* operator priority */
+static PRX_NODE *pNode; /* pointer to any node in a tree */
+static PRX_NODE **St;   /* priority stack */
+static int nSt, szSt;   /* depth and allocated size of St */
+static char Prio[32];   /* operator priority */
 static int IfStatus[MAXLEVEL + 1];
 
-static char UsageFlag[MAXEQU]; /* bit flag: operand of corr. is */
-static char TmpTyp[MAXEQU];    /* flag: corresponding temporary derivative
+static char *UsageFlag;        /* bit flag: operand of corr. is */
+static int szUsage;            /* allocated size of UsageFlag */
+static char *TmpTyp;           /* flag: corresponding temporary derivative
                                 * is (not) needed to compute further */
 static PRX_OPD **varDefs;      /* pointer to variables list */
 static PRX_OPD **auxDefs;      /* pointer to auxiliaries list */
@@ -117,8 +135,97 @@ static PRX_OPD **parDefs;      /* pointer to parameters list */
 
 static PRX_NODE *N_0, *N_1, *N_2, *N_0p5, *N_1_ln10;
 
+/*
+ * Common subexpression elimination. All expression trees, of the function
+ * and of every derivative column, are numbered such that equal
+ * subexpressions share one value (hash consing). Code is generated twice:
+ * the first pass only counts how often an evaluation can be reused, the
+ * second pass keeps the reused evaluations in temporaries.
+ */
+
+#define VALHASH 4093 /* size of the value hash table */
+
+struct PRX_VAL_S {
+    struct PRX_VAL_S *next;  /* next value in hash chain */
+    struct PRX_VAL_S *a, *b; /* values of the operands */
+    struct PRX_DEF_S *def;   /* evaluations of this value */
+    PRX_OPD *opd;            /* operand of OPD and DOPD */
+    PRX_NUM *num;            /* constant of NUM */
+    PRX_OPD *copy;           /* operand assigned with this value */
+    OPR opr;
+    int id;     /* sequence number */
+    int cost;   /* size of the code */
+    int stable; /* all operands are assigned at most once */
+    int mark;   /* stamp of liveness pass */
+};
+typedef struct PRX_VAL_S PRX_VAL;
+
+struct PRX_DEF_S {
+    struct PRX_DEF_S *next; /* next evaluation of the same value */
+    struct PRX_DEF_S *seq;  /* next evaluation in code order */
+    int col;                /* derivative column, -1 for the function */
+    int reg;                /* region of the evaluation */
+    int nUse;               /* number of reuses */
+    int typ, ind;           /* operand holding the value */
+};
+typedef struct PRX_DEF_S PRX_DEF;
+
+typedef struct {
+    int n;           /* number of statements */
+    int sz;          /* allocated number of statements */
+    int *stmt;       /* index in NodeH of the statement */
+    PRX_NODE **tree; /* derivative code of the statement */
+    char *live;      /* derivative of temporary is needed */
+} PRX_COL;
+
+static PRX_COL *Cols;         /* derivative code per column */
+static int nCol;              /* number of columns */
+static int *RegStmt;          /* region (if/else block) of statement */
+static int *RegUp;            /* enclosing region */
+static char *TmpLive;         /* value of temporary is needed */
+static PRX_VAL *ValHash[VALHASH];
+static int nVal, nMark;
+static PRX_DEF *DefFirst, **DefLast, *DefNext; /* evaluations in order */
+static int bCount;          /* only count reuses, no output */
+static int bChange;         /* liveness has changed */
+static int cseCol, cseReg;  /* current column and region */
+static int nTmpBase;        /* first temporary local to a column */
+static int nTmpTop;         /* next free temporary of a column */
+static PRX_NODE *cseRoot;   /* expression of current assignment */
+static PRX_OPD *cseTarget;  /* which can be read back from here */
+
+/*
+ * Reverse mode. A kind of derivatives with more inputs than residuals is
+ * usually cheaper as one backward sweep per residual: the adjoints of the
+ * statements, taken in reverse order, are propagated to the adjoints of
+ * their operands, and the adjoints of the inputs form a row of the Jacobian.
+ * The sweep reads the values left by the function code, so a temporary or
+ * residual may be assigned only once on each path, and not be read before.
+ * Per kind the mode with the smaller code is chosen.
+ */
+
+#define ADJ_ZERO 0 /* adjoint is zero, not stored */
+#define ADJ_ONE 1  /* adjoint is one, not stored */
+#define ADJ_SET 2  /* adjoint is stored */
+
+static int bLocal;          /* derivative of a single statement only */
+static int KindRev[3];      /* kind is computed in reverse mode */
+static int KindN[3];        /* columns, or rows in reverse mode, of a kind */
+static int *IfMatch;        /* else or fi of an if, fi of an else, if of a fi */
+static TYP revTyp;          /* type of the inputs of the current kind */
+static int nAdjTmp;         /* temporaries with an adjoint */
+static int nAdj;            /* number of adjoints */
+static PRX_OPD **AdjOpd;    /* adjoints of temporaries, residuals, inputs */
+static PRX_OPD **AdjList;   /* operands of a statement */
+static char *AdjDep;        /* operand depends on the inputs of the kind */
+static char *AdjState;      /* state of the adjoint in the current row */
+static char *AdjWrite;      /* adjoints written in an if block, per level */
+
 static int prx_simplify(PRX_NODE *p);
 static int prx_genCode(PRX_NODE *pNode);
+static void *prx_grow(void *arr, int *pSize, int n, size_t size);
+static char *prx_nameCopy(char *buf, size_t size, char *pe, int lae);
+static void prx_push(PRX_NODE *p);
 static int write_error(void);
 static int bt_cmp_names(PRX_OPD *s1, PRX_OPD *s2);
 static int bt_cmp_numbers(PRX_NUM *s1, PRX_NUM *s2);
@@ -130,14 +237,30 @@ static int prx_expr(char *ein);
 static int prx_genCode(PRX_NODE *pNode);
 static int numTraverse(char *rec);
 static int numOut(void);
-static int prx_deriv(PRX_OPD *pOpd);
+static int prx_deriv(PRX_OPD *pOpd, PRX_COL *pCol);
 static int prx_deriv_expr(PRX_NODE *p, PRX_OPD *arg, PRX_OPD *fval);
+static int prx_genOper(PRX_NODE *pNode);
+static int prx_emit(void);
+static void prx_regions(void);
+static void prx_number(void);
+static void prx_live(void);
+static PRX_VAL *prx_value(PRX_NODE *p);
+static int prx_cseWorth(PRX_VAL *pVal);
+static PRX_DEF *prx_cseFind(PRX_VAL *pVal);
+static PRX_DEF *prx_cseDef(PRX_VAL *pVal);
+static int prx_cseTarget(PRX_OPD *pOpd);
+static void prx_cseRead(PRX_DEF *pDef, PRX_OPD *pOpd);
+static int prx_revCheck(void);
+static void prx_revInit(void);
+static void prx_revDeps(int nIn);
+static void prx_revRow(PRX_COL *pCol, int r, int nIn);
+static void prx_revBlock(PRX_COL *pCol, int first, int last, int level);
+static int prx_colCost(PRX_COL *pCol);
 
 /* ========================================================================== */
 
 /* Initialization routine */
 int prx_init(FILE *outFile, FILE *modFile) {
-    short sh;
     int i;
     char *pc;
 
@@ -157,23 +280,22 @@ int prx_init(FILE *outFile, FILE *modFile) {
     sModel = sDate = sAuthor = sVersion = sIdent = NULL;
     nVar = nAux = nPar = nCon = nFlag = 0;
     nRes = nNum = nTmp = 0;
+    nStack = nStackMax = 0;
     sVar = sAux = sPar = sCon = sFlg = sRes = NULL;
     Nums = NULL;
 
-    for (i = 0; i < MAXEQU; i++) {
-        NodeH[i] = NULL;
-        TmpTyp[i] = 0;
-        UsageFlag[i] = 0;
-    }
+    szHead = szSt = szUsage = 0;
+    NodeH = (PRX_NODE **)prx_grow(NULL, &szHead, 1, sizeof(PRX_NODE *));
+    St = (PRX_NODE **)prx_grow(NULL, &szSt, 1, sizeof(PRX_NODE *));
+    UsageFlag = (char *)prx_grow(NULL, &szUsage, 1, sizeof(char));
+    TmpTyp = NULL;
+    RegStmt = RegUp = IfMatch = NULL;
+    TmpLive = NULL;
 
     pHead = NodeH;
     nHead = 0;
     pNode = NULL;
-
-    for (i = 0; i < 128; i++) {
-        St[i] = NULL;
-    }
-    pSt = NULL;
+    nSt = 0;
 
     Prio[INVAL] = 0;
     Prio[AND] = Prio[OR] = 1;
@@ -197,8 +319,23 @@ int prx_init(FILE *outFile, FILE *modFile) {
 
     varDefs = auxDefs = parDefs = NULL;
 
+    Cols = NULL;
+    nCol = 0;
+    for (i = 0; i < VALHASH; i++) {
+        ValHash[i] = NULL;
+    }
+    nVal = nMark = 0;
+    DefFirst = DefNext = NULL;
+    DefLast = &DefFirst;
+    bCount = 0;
+    cseRoot = NULL;
+    cseTarget = NULL;
+    bLocal = 0;
+    AdjOpd = NULL;
+
+    WRITEM(-1);
     WRITEM(-1);
-    WRITEM(-1); /* placeholder for nNum & nTmp */
+    WRITEM(-1); /* placeholder for nNum, nTmp & nStackMax */
     pc = FILEID;
     WRITEM(strlen(pc) + 1);
     if (!fwrite(pc, 1, strlen(pc) + 1, oFile)) {
@@ -233,6 +370,48 @@ int write_error() { ERROR("Error writing output file"); }
 
 /* ========================================================================== */
 
+/*
+ * Array in the memory tree with room for at least n elements, a larger
+ * array is allocated and cleared when needed, keeping the contents
+ */
+void *prx_grow(void *arr, int *pSize, int n, size_t size) {
+    void *p;
+    int sz;
+
+    if (n <= *pSize) {
+        return arr;
+    }
+    sz = 2 * *pSize + 64;
+    if (sz < n) {
+        sz = n;
+    }
+    p = mem_slot(Tree, sz * size);
+    memset(p, 0, sz * size);
+    if (*pSize > 0) {
+        memcpy(p, arr, *pSize * size);
+    }
+    *pSize = sz;
+    return p;
+}
+
+/* Copy of a name, in buf when it fits */
+char *prx_nameCopy(char *buf, size_t size, char *pe, int lae) {
+    char *name;
+
+    name = ((size_t)lae < size) ? buf : (char *)mem_slot(Tree, lae + 1);
+    memcpy(name, pe, lae);
+    name[lae] = 0;
+    return name;
+}
+
+/* Push a node on the priority stack */
+void prx_push(PRX_NODE *p) {
+    St = (PRX_NODE **)prx_grow(St, &szSt, nSt + 1, sizeof(PRX_NODE *));
+    St[nSt++] = p;
+}
+
+/* ========================================================================== */
+
 /* comparison routine for the balanced binary tree of names */
 int bt_cmp_names(PRX_OPD *s1, PRX_OPD *s2) {
     return strcmp(s1->name, s2->name);
@@ -285,7 +464,10 @@ PRX_OPD *newName(char *name, TYP typ, int ind) {
     pOpd->typ = typ;
     pOpd->ind = ind;
     pOpd->node = NULL;
+    pOpd->nAss = 0;
+    pOpd->bRead = 0;
     bt_insert(BtNames, (char *)pOpd);
+    UsageFlag = (char *)prx_grow(UsageFlag, &szUsage, ind + 1, sizeof(char));
     return pOpd;
 }
 /* ========================================================================== */
@@ -301,8 +483,8 @@ int prx_header(char *Buf) {
     int nVals;
     char *pe, *pa;
     int *pCount; /* pointer to counter to be increased */
-    char Name[MAXNAME + 1];
-    char *name = Name;
+    char Name[64];
+    char *name;
     double Vals[5]; /* Array for default, bounds, scales */
     double minLim, maxLim;
     PRX_NODE *pNode;
@@ -311,7 +493,6 @@ int prx_header(char *Buf) {
     char sep1[] = "  ";
     char sep2[] = ",\n  ";
     HEADER *sHeader, *pHFree, **pHeader;
-    short sh;
 
     lae = prx_name(Buf);
     if (lae <= 2 || Buf[lae] != ':') {
@@ -485,7 +666,13 @@ int prx_header(char *Buf) {
     }
     /* if (*pCount > 0)  ERROR("multiple keyword\n"); */
     pHFree = (HEADER *)mem_slot(DTree, sizeof(HEADER));
-    pHFree->text = (char *)mem_slot(DTree, (MAXLINE + 4) * sizeof(char));
+    /* room for the names and for three numbers per name */
+    lae = 1;
+    for (pa = pe; *pa; pa++) {
+        lae += (*pa == ',');
+    }
+    pHFree->text =
+        (char *)mem_slot(DTree, (strlen(pe) + 64 * lae + 4) * sizeof(char));
     if (*pHeader != NULL) {
         pHFree->next = (*pHeader)->next;
         (*pHeader)->next = pHFree;
@@ -500,14 +687,7 @@ int prx_header(char *Buf) {
         if (lae == 0) {
             ERROR("syntax in name list");
         }
-        if (lae < 0) {
-            lae = MAXNAME;
-            memcpy(name, pe, lae);
-            name[lae] = 0;
-            ERRORA("name too long : %s", name);
-        }
-        memcpy(name, pe, lae);
-        name[lae] = 0;
+        name = prx_nameCopy(Name, sizeof(Name), pe, lae);
 
         pOpd = (PRX_OPD *)bt_search(BtNames, (char *)&name);
         if (pOpd) {
@@ -535,22 +715,22 @@ int prx_header(char *Buf) {
                 minLim = (typ == PAR) ? Vals[3] : Vals[1];
                 maxLim = (typ == PAR) ? Vals[4] : Vals[2];
                 if (minLim > -HUGE_VAL) {
-                    WRITEM(OPD);
+                    WRITEO(OPD);
                     WRITEM(pOpd->typ);
                     WRITEM(pOpd->ind);
                     pNode = getNum(minLim);
-                    WRITEM(NUM);
+                    WRITEO(NUM);
                     WRITEM(pNode->c.nptr->ind);
-                    WRITEM(CHKL);
+                    WRITEO(CHKL);
                 }
                 if (maxLim < HUGE_VAL) {
-                    WRITEM(OPD);
+                    WRITEO(OPD);
                     WRITEM(pOpd->typ);
                     WRITEM(pOpd->ind);
                     pNode = getNum(maxLim);
-                    WRITEM(NUM);
+                    WRITEO(NUM);
                     WRITEM(pNode->c.nptr->ind);
-                    WRITEM(CHKG);
+                    WRITEO(CHKG);
                 }
             } else if (nVals > 1) {
                 WARNINGA("Maximum quantity of values exceeded for %s", name);
@@ -633,14 +813,19 @@ int namTraverse2(char *rec) {
 
 /* ========================================================================== */
 
+/* Generation of a C model procedure from the written code file */
+int prx_cCode(FILE *codeFile, FILE *cFile, unsigned long long hash) {
+    return prx_genC(codeFile, cFile, sModel ? sModel : "no model", nRes, nVar,
+                    nAux, nPar, nCon, nFlag, hash);
+}
+
+/* ========================================================================== */
+
 /* Is everything ok before generating derivatives? */
 int prx_check(void) {
     if (ifLevel > 0) {
         ERROR("if condition not closed by fi");
     }
-    if (nHead > MAXEQU) {
-        ERRORA("maximum number of statements (%d) exceeded", MAXEQU);
-    }
     bt_traverse(BtNames, namTraverse2);
     if (nRes <= 0) {
         ERROR("no residuals");
@@ -659,11 +844,14 @@ int prx_equation(char *ein) {
     if (*ein == 0) {
         return 1;
     }
-    if (++nHead > MAXEQU) {
-        pHead = NodeH;
+    /* one more statement and the terminating NULL */
+    if (++nHead >= szHead) {
+        NodeH = (PRX_NODE **)prx_grow(NodeH, &szHead, nHead + 1,
+                                      sizeof(PRX_NODE *));
+        pHead = NodeH + nHead - 1;
     }
 
-    pSt = St;
+    nSt = 0;
     Prio[ADD] = 5;
     /* if ... then ... else */
     if (memcmp(ein, "if(", 3) == 0) {
@@ -675,7 +863,6 @@ int prx_equation(char *ein) {
         pNodeV = pNode;
         NODE(pNode, IF, pNodeV, NULL);
         *(pHead++) = pNode;
-        prx_genCode(pNode);
         if (ifLevel >= MAXLEVEL) {
             ERROR("Maximum 'if' hierarchy depth exceeded");
         }
@@ -691,7 +878,6 @@ int prx_equation(char *ein) {
         }
         NODE(pNode, ELSE, NULL, NULL);
         *(pHead++) = pNode;
-        prx_genCode(pNode);
         IfStatus[ifLevel] = 1;
         return 1;
     } else if (strcmp(ein, "fi") == 0) {
@@ -700,7 +886,6 @@ int prx_equation(char *ein) {
         }
         NODE(pNode, FI, NULL, NULL);
         *(pHead++) = pNode;
-        prx_genCode(pNode);
         ifLevel--;
         return 1;
     }
@@ -713,7 +898,6 @@ int prx_equation(char *ein) {
     prx_simplify(pNode);
     prx_simplify(pNode);
     *(pHead++) = pNode;
-    prx_genCode(pNode);
     return 1;
 }
 
@@ -726,16 +910,17 @@ int prx_equation(char *ein) {
 
 int prx_expr(char *ein) {
     char *pe;
-    char Name[MAXNAME + 1], *name;
+    char Name[64], *name;
     int lae, l;
     int k;
     double z;
     OPR opr;
-    OPR Op[16]; /* Operator buffer for Priority control */
-    int iOp;
+    OPR OpBuf[16], *Op; /* Operator buffer for Priority control */
+    int iOp, szOp;
     PRX_OPD *pOpd;
 
-    name = Name;
+    Op = OpBuf;
+    szOp = 16;
     pe = ein;
     iOp = 0;
 
@@ -750,9 +935,9 @@ int prx_expr(char *ein) {
         if (lae <= 0) {
             return 0;
         }
-        pSt--;
-        NODE(pNode, RET, *pSt, NULL);
-        *(pSt++) = pNode;
+        nSt--;
+        NODE(pNode, RET, St[nSt], NULL);
+        prx_push(pNode);
         pe += lae;
         if (*pe == ')') {
             pe++;
@@ -763,17 +948,13 @@ int prx_expr(char *ein) {
     if (lae == 0) {
         ERROR("syntax error in variable name");
     }
-    if (lae < 0) {
-        ERROR("variable name too long");
-    }
     if (pe[lae] != '=' || pe[lae + 1] == '=') {
         ERROR("assignment expected");
     }
     /* bAssign = 0;  goto operand; } */
     /* assignment */
     bAssign = 0;
-    memcpy(name, pe, lae);
-    name[lae] = 0;
+    name = prx_nameCopy(Name, sizeof(Name), pe, lae);
     l = lae + 1;
     pe += l;
     lae = prx_expr(pe);
@@ -794,13 +975,14 @@ int prx_expr(char *ein) {
     if (pOpd->typ == RES) {
         UsageFlag[pOpd->ind] |= 1 << RES;
     }
+    pOpd->nAss += pOpd->bRead ? 2 : 1;
     if (!pOpd->node) {
         NODE(pNode, OPD, NULL, (PRX_NODE *)pOpd);
         pOpd->node = pNode;
     }
-    pSt--;
-    NODE(pNode, ASS, *pSt, (PRX_NODE *)pOpd);
-    *(pSt++) = pNode;
+    nSt--;
+    NODE(pNode, ASS, St[nSt], (PRX_NODE *)pOpd);
+    prx_push(pNode);
     pe += lae;
     return (int)(pe - ein);
 operation:
@@ -868,15 +1050,15 @@ operation:
         if (Prio[opr] > Prio[Op[iOp - 1]]) {
             break;
         }
-        pSt--;
+        nSt--;
         iOp--;
         if (Op[iOp] == NEG || Op[iOp] == NOT) { /* 1 operand  */
-            NODE(pNode, Op[iOp], *pSt, NULL);
+            NODE(pNode, Op[iOp], St[nSt], NULL);
         } else { /* 2 operands */
-            pSt--;
-            NODE(pNode, Op[iOp], *pSt, *(pSt + 1));
+            nSt--;
+            NODE(pNode, Op[iOp], St[nSt], St[nSt + 1]);
         }
-        *(pSt++) = pNode;
+        prx_push(pNode);
     }
     if (*pe == ',' || *pe == ')' || *pe == ';' || *pe == 0) {
         return (int)(pe - ein);
@@ -884,6 +1066,7 @@ operation:
     if (opr == INVAL) {
         ERROR("syntax");
     }
+    Op = (OPR *)prx_grow(Op, &szOp, iOp + 1, sizeof(OPR));
     Op[iOp++] = opr;
     pe++;
     goto operand;
@@ -895,11 +1078,13 @@ operand:
             goto operand;
         }
         if (*pe == '-') {
+            Op = (OPR *)prx_grow(Op, &szOp, iOp + 1, sizeof(OPR));
             Op[iOp++] = NEG;
             pe++;
             goto operand;
         }
         if (*pe == '!') {
+            Op = (OPR *)prx_grow(Op, &szOp, iOp + 1, sizeof(OPR));
             Op[iOp++] = NOT;
             pe++;
             goto operand;
@@ -910,7 +1095,7 @@ operand:
     }
     /* ___ operand is number */
     pNode = getNum(z);
-    *(pSt++) = pNode;
+    prx_push(pNode);
     pe += lae;
     goto operation;
 name:
@@ -918,8 +1103,7 @@ name:
     if (lae <= 0) {
         goto parenth;
     }
-    memcpy(name, pe, lae);
-    name[lae] = 0;
+    name = prx_nameCopy(Name, sizeof(Name), pe, lae);
     if (pe[lae] == ')' - 1) {
         goto function;
     }
@@ -933,12 +1117,13 @@ name:
     } else if (!(UsageFlag[pOpd->ind] & ((1) << RES))) {
         ERRORA("%s is used but not assigned before", name);
     }
+    pOpd->bRead = 1;
     pNode = pOpd->node;
     if (!pNode) {
         NODE(pNode, OPD, NULL, (PRX_NODE *)pOpd);
         pOpd->node = pNode;
     }
-    *(pSt++) = pNode;
+    prx_push(pNode);
     pe += lae;
     goto operation;
 parenth:
@@ -971,26 +1156,83 @@ function:
     if (lae <= 0 || pe[lae] != ')') {
         ERRORA("argument error in function '%s'", name);
     }
-    pSt--;
-    NODE(pNode, FunSt[k].opr, *pSt, NULL);
-    *(pSt++) = pNode;
+    nSt--;
+    NODE(pNode, FunSt[k].opr, St[nSt], NULL);
+    prx_push(pNode);
     pe += lae + 1;
     goto operation;
 }
 
 /* ========================================================================== */
 
-/* Generation of arithmetic code from code tree */
+/* Generation of arithmetic code from code tree, reusing evaluations */
 int prx_genCode(PRX_NODE *pNode) {
+    PRX_VAL *pVal;
+    PRX_DEF *pDef;
+    PRX_OPD *pTarget;
+
+    if (!pNode) {
+        return 0;
+    }
+    pVal = pNode->val;
+    if (!pVal || !prx_cseWorth(pVal)) {
+        return prx_genOper(pNode);
+    }
+    pTarget = (pNode == cseRoot) ? cseTarget : NULL;
+    cseRoot = NULL;
+
+    pDef = prx_cseFind(pVal);
+    if (pDef) { /* computed before */
+        if (bCount) {
+            pDef->nUse++;
+        } else {
+            assert(pDef->typ >= 0);
+            WRITEO(OPD);
+            WRITEM(pDef->typ);
+            WRITEM(pDef->ind);
+        }
+        return 1;
+    }
+    if (!prx_genOper(pNode)) {
+        return 0;
+    }
+    pDef = prx_cseDef(pVal);
+    if (bCount || pDef->nUse == 0) {
+        return 1;
+    }
+    if (pTarget) { /* read back from the assigned operand */
+        prx_cseRead(pDef, pTarget);
+        return 1;
+    }
+    pDef->typ = TMP; /* keep in a new temporary */
+    if (cseCol < 0) {
+        pDef->ind = nTmp++;
+    } else {
+        pDef->ind = nTmpTop++;
+        if (nTmpTop > nTmp) {
+            nTmp = nTmpTop;
+        }
+    }
+    WRITEO(ASS);
+    WRITEM(TMP);
+    WRITEM(pDef->ind);
+    WRITEO(OPD);
+    WRITEM(TMP);
+    WRITEM(pDef->ind);
+    return 1;
+}
+
+/* ========================================================================== */
+
+/* Generation of arithmetic code for a single operation */
+int prx_genOper(PRX_NODE *pNode) {
     OPR opr;
     TYP typ;
-    short sh;
     double z;
     PRX_NODE *pN;
+    PRX_VAL *pVal;
+    PRX_DEF *pDef;
 
-    if (!pNode) {
-        return 0;
-    }
     opr = pNode->opr;
     switch (opr) {
     case AND:
@@ -1010,19 +1252,19 @@ int prx_genCode(PRX_NODE *pNode) {
         if (!prx_genCode(pNode->c.o2)) {
             return 0;
         }
-        WRITEM(opr);
+        WRITEO(opr);
         break;
     case SUB:
         if (!prx_genCode(pNode->o1)) {
             return 0;
         }
         if (pNode->c.o2 == N_1) {
-            WRITEM(DEC);
+            WRITEO(DEC);
         } else {
             if (!prx_genCode(pNode->c.o2)) {
                 return 0;
             }
-            WRITEM(opr);
+            WRITEO(opr);
         }
         break;
     case ADD:
@@ -1030,12 +1272,12 @@ int prx_genCode(PRX_NODE *pNode) {
             if (!prx_genCode(pNode->o1)) {
                 return 0;
             }
-            WRITEM(INC);
+            WRITEO(INC);
         } else if (pNode->o1 == N_1) {
             if (!prx_genCode(pNode->c.o2)) {
                 return 0;
             }
-            WRITEM(INC);
+            WRITEO(INC);
         } else {
             if (!prx_genCode(pNode->o1)) {
                 return 0;
@@ -1043,7 +1285,7 @@ int prx_genCode(PRX_NODE *pNode) {
             if (!prx_genCode(pNode->c.o2)) {
                 return 0;
             }
-            WRITEM(opr);
+            WRITEO(opr);
         }
         break;
     case NEG:
@@ -1053,13 +1295,13 @@ int prx_genCode(PRX_NODE *pNode) {
                 ERROR("subtraction overflow");
             }
             pN = getNum(z);
-            WRITEM(NUM);
+            WRITEO(NUM);
             WRITEM(pN->c.nptr->ind);
         } else {
             if (!prx_genCode(pNode->o1)) {
                 return 0;
             }
-            WRITEM(opr);
+            WRITEO(opr);
         }
         break;
     case REV:
@@ -1069,13 +1311,13 @@ int prx_genCode(PRX_NODE *pNode) {
                 ERROR("division overflow");
             }
             pN = getNum(z);
-            WRITEM(NUM);
+            WRITEO(NUM);
             WRITEM(pN->c.nptr->ind);
         } else {
             if (!prx_genCode(pNode->o1)) {
                 return 0;
             }
-            WRITEM(opr);
+            WRITEO(opr);
         }
         break;
     case EQU:
@@ -1084,12 +1326,12 @@ int prx_genCode(PRX_NODE *pNode) {
         }
         break;
     case OPD:
-        WRITEM(opr);
+        WRITEO(opr);
         WRITEM(pNode->c.optr->typ);
         WRITEM(pNode->c.optr->ind);
         break;
     case DOPD:
-        WRITEM(OPD);
+        WRITEO(OPD);
         typ = pNode->c.optr->typ;
         if (typ == RES) {
             typ = DRES;
@@ -1100,7 +1342,7 @@ int prx_genCode(PRX_NODE *pNode) {
         WRITEM(pNode->c.optr->ind);
         break;
     case NUM:
-        WRITEM(NUM);
+        WRITEO(NUM);
         WRITEM(pNode->c.nptr->ind);
         break;
     case ASS:
@@ -1108,30 +1350,37 @@ int prx_genCode(PRX_NODE *pNode) {
             opr = CLR;
         } else {
             pN = pNode->o1;
-            if (pN->opr == NEG) {
-                if (pN->o1->opr != NUM) {
-                    pN = pN->o1;
-                    opr = NASS;
-                }
+            pVal = (pN->val && prx_cseWorth(pN->val)) ? pN->val : NULL;
+            if (pN->opr == NEG && pN->o1->opr != NUM &&
+                !(pVal && prx_cseFind(pVal))) {
+                pN = pN->o1;
+                opr = NASS;
+            } else if (prx_cseTarget(pNode->c.optr)) {
+                for (cseRoot = pN; cseRoot->opr == EQU; cseRoot = cseRoot->o1)
+                    ;
+                cseTarget = pNode->c.optr;
             }
             if (!prx_genCode(pN)) {
                 return 0;
             }
+            cseRoot = NULL;
+            if (opr == NASS && pVal && prx_cseTarget(pNode->c.optr)) {
+                /* the negated value can be read back after assignment */
+                pDef = prx_cseDef(pVal);
+                if (!bCount && pDef->nUse > 0) {
+                    prx_cseRead(pDef, pNode->c.optr);
+                }
+            }
         }
         typ = pNode->c.optr->typ;
         if (bDeriv) {
             if (typ == RES) {
                 typ = DRES;
             } else if (typ == TMP) {
-                if (opr == CLR) {
-                    if (TmpTyp[pNode->c.optr->ind] == 0) {
-                        break;
-                    }
-                }
                 typ = DTMP;
             }
         }
-        WRITEM(opr);
+        WRITEO(opr);
         WRITEM(typ);
         WRITEM(pNode->c.optr->ind);
         break;
@@ -1154,11 +1403,11 @@ int prx_genCode(PRX_NODE *pNode) {
         if (!prx_genCode(pNode->o1)) {
             return 0;
         }
-        WRITEM(opr);
+        WRITEO(opr);
         break;
     case ELSE:
     case FI:
-        WRITEM(opr);
+        WRITEO(opr);
         break;
     default:
         break;
@@ -1179,7 +1428,6 @@ int numTraverse(char *rec) {
 
 /* ========================================================================== */
 int numOut(void) {
-    short sh;
 
     Nums = (double *)mem_slot(Tree, nNum * 8);
     bt_traverse(BtNumbers, numTraverse);
@@ -1190,11 +1438,12 @@ int numOut(void) {
     rewind(oFile);
     WRITEM(nNum);
     WRITEM(nTmp);
+    WRITEM(nStackMax);
     return 1;
 }
 
 /* ========================================================================== */
-int prx_deriv(PRX_OPD *);
+int prx_deriv(PRX_OPD *, PRX_COL *);
 int prx_deriv_expr(PRX_NODE *, PRX_OPD *, PRX_OPD *);
 /* ========================================================================== */
 
@@ -1202,42 +1451,71 @@ int prx_deriv_expr(PRX_NODE *, PRX_OPD *, PRX_OPD *);
  * Derivative generation frame return value: 0 - error 1 - success
  */
 int prx_deriv_all(void) {
-    int i;
-    short sh;
+    int i, k, c, nIn, fwd, rev, bRev;
+    PRX_OPD **defs;
 
     printf("Creating derivatives\n");
     bDeriv = 1;
-    WRITEM(SOK);
-    for (i = 0; i <= nVar - 1; i++) {
-        printf("%s ", (varDefs[i])->name);
-        if (!prx_deriv(varDefs[i])) {
-            printf("\n");
-            return 0;
+    /* each kind keeps at most MAX(nIn, nRes) columns, the trial reverse
+       rows of the last kind follow its nIn forward columns */
+    Cols = (PRX_COL *)mem_slot(DTree, (MAX(nVar, nRes) + MAX(nAux, nRes) +
+                                       MAX(nPar, nRes) + nRes + 1) *
+                                          sizeof(PRX_COL));
+    TmpTyp = (char *)mem_slot(DTree, nTmp + 1);
+    bRev = prx_revCheck();
+    if (bRev) {
+        prx_revInit();
+    }
+    for (k = 0, c = 0; k < 3; k++) {
+        defs = (k == 0) ? varDefs : (k == 1) ? auxDefs : parDefs;
+        nIn = (k == 0) ? nVar : (k == 1) ? nAux : nPar;
+        for (i = 0, fwd = 0; i < nIn; i++) {
+            printf("%s ", (defs[i])->name);
+            if (!prx_deriv(defs[i], Cols + c + i)) {
+                printf("\n");
+                return 0;
+            }
+            fwd += prx_colCost(Cols + c + i);
+        }
+        KindN[k] = nIn;
+        KindRev[k] = 0;
+        if (bRev && nIn > 0) { /* rows after the columns, for comparison */
+            revTyp = (k == 0) ? VAR : (k == 1) ? AUX : PAR;
+            prx_revDeps(nIn);
+            bLocal = 1;
+            for (i = 0, rev = 0; i < nRes; i++) {
+                prx_revRow(Cols + c + nIn + i, i, nIn);
+                rev += prx_colCost(Cols + c + nIn + i);
+            }
+            bLocal = 0;
+            if (rev < fwd) {
+                for (i = 0; i < nRes; i++) {
+                    Cols[c + i] = Cols[c + nIn + i];
+                }
+                KindN[k] = nRes;
+                KindRev[k] = 1;
+                printf("(reverse)");
+            }
         }
-        WRITEM(EOD);
+        printf("\n");
+        c += KindN[k];
     }
-    printf("\n");
-    WRITEM(SOK);
-    for (i = 0; i <= nAux - 1; i++) {
-        printf("%s ", (auxDefs[i])->name);
-        if (!prx_deriv(auxDefs[i])) {
-            printf("\n");
-            return 0;
-        }
-        WRITEM(EOD);
+    nCol = c;
+
+    /* output of function and derivatives, sharing subexpressions */
+    prx_regions();
+    prx_number();
+    prx_live();
+    bCount = 1;
+    if (!prx_emit()) {
+        bCount = 0;
+        return 0;
     }
-    printf("\n");
-    WRITEM(SOK);
-    for (i = 0; i <= nPar - 1; i++) {
-        printf("%s ", (parDefs[i])->name);
-        if (!prx_deriv(parDefs[i])) {
-            printf("\n");
-            return 0;
-        }
-        WRITEM(EOD);
+    bCount = 0;
+    if (!prx_emit()) {
+        return 0;
     }
-    printf("\n");
-    WRITEM(STOP);
+    WRITEO(STOP);
     if (!numOut()) {
         return 0;
     }
@@ -1251,7 +1529,7 @@ int prx_deriv_all(void) {
  * Derivative for a specific variable, parameter or auxiliary return value: 0
  * - error 1 - success
  */
-int prx_deriv(PRX_OPD *pOpd) {
+int prx_deriv(PRX_OPD *pOpd, PRX_COL *pCol) {
     TYP typ;
     int i;
     int level; /* if-level */
@@ -1335,22 +1613,29 @@ int prx_deriv(PRX_OPD *pOpd) {
             break;
         }
     }
-    /* 3rd pass - output to file */
+    /* 3rd pass - collect the code, output follows for all columns */
+    pCol->n = 0;
+    pCol->sz = nHead + 1;
+    pCol->stmt = (int *)mem_slot(DTree, (nHead + 1) * sizeof(int));
+    pCol->tree = (PRX_NODE **)mem_slot(DTree, (nHead + 1) * sizeof(PRX_NODE *));
+    pCol->live = NULL;
     for (pHead = NodeH; *pHead; pHead++) {
         pNode = *pHead;
         switch (pNode->opr) {
         case ASS:
-            if (!prx_genCode(pNode->abl)) {
-                return 0;
+            if (pNode->abl->o1 == N_0 && pNode->c.optr->typ == TMP &&
+                !TmpTyp[pNode->c.optr->ind]) {
+                break; /* derivative not needed */
             }
+            pCol->stmt[pCol->n] = (int)(pHead - NodeH);
+            pCol->tree[pCol->n++] = pNode->abl;
             break;
         case IF:
         case ELSE:
         case FI: /* case RET: */
             if (pNode->abl) {
-                if (!prx_genCode(pNode->abl)) {
-                    return 0;
-                }
+                pCol->stmt[pCol->n] = (int)(pHead - NodeH);
+                pCol->tree[pCol->n++] = pNode->abl;
             }
             break;
         default:
@@ -1366,7 +1651,8 @@ int prx_deriv(PRX_OPD *pOpd) {
     p = (PRX_NODE *)mem_slot(DTree, sizeof(PRX_NODE));                         \
     p->opr = op;                                                               \
     p->o1 = op1;                                                               \
-    p->c.o2 = op2
+    p->c.o2 = op2;                                                             \
+    p->val = NULL
 
 /*
  * Derivative for a subexpression return value: 0 - error 1 - success
@@ -1621,7 +1907,9 @@ int prx_deriv_expr(PRX_NODE *p, PRX_OPD *arg, PRX_OPD *fval) {
         p->abl = p1->abl;
         break;
     case OPD:
-        if (p->c.optr->typ == TMP) {
+        if (bLocal) { /* partial derivative of the statement itself */
+            p->abl = (p->c.optr == arg) ? N_1 : N_0;
+        } else if (p->c.optr->typ == TMP) {
             if (TmpTyp[p->c.optr->ind]) {
                 NODED(pD, DOPD, NULL, (PRX_NODE *)p->c.optr);
                 p->abl = pD;
@@ -1836,12 +2124,15 @@ int prx_simplify(PRX_NODE *p) {
             }
             p->o1 = getNum(z);
         } else if (p2->opr == MUL) {
+            /* new node, p2 may be shared with other expressions */
             if (p2->o1->opr == NEG) {
                 p->opr = ADD;
-                p2->o1 = p2->o1->o1;
+                NODED(pD, MUL, p2->o1->o1, p2->c.o2);
+                p->c.o2 = pD;
             } else if (p2->c.o2->opr == NEG) {
                 p->opr = ADD;
-                p2->c.o2 = p2->c.o2->o1;
+                NODED(pD, MUL, p2->o1, p2->c.o2->o1);
+                p->c.o2 = pD;
             }
         }
         break;
@@ -1995,3 +2286,807 @@ int prx_simplify(PRX_NODE *p) {
     }
     return 1;
 }
+
+/* ========================================================================== */
+
+/* Mark the temporaries and residuals read by an expression */
+static void prx_revReads(PRX_NODE *p, char *pUse) {
+    switch (p->opr) {
+    case OPD:
+        if (p->c.optr->typ == TMP) {
+            pUse[p->c.optr->ind] |= 2;
+        } else if (p->c.optr->typ == RES) {
+            pUse[nTmp + p->c.optr->ind] |= 2;
+        }
+        return;
+    case NUM:
+    case DOPD:
+        return;
+    default:
+        break;
+    }
+    if (p->o1) {
+        prx_revReads(p->o1, pUse);
+    }
+    if (p->opr != ASS && p->c.o2) {
+        prx_revReads(p->c.o2, pUse);
+    }
+}
+
+/*
+ * Does the function code allow reverse mode? On each path a temporary or
+ * residual is assigned at most once and not read before, and inputs are
+ * never assigned. return value: 0 - no 1 - yes
+ */
+int prx_revCheck(void) {
+    int i, n, s, level;
+    char *pUse;                         /* 1: assigned, 2: read */
+    char *pPre[MAXLEVEL + 1] = {NULL};  /* use before the if */
+    char *pThen[MAXLEVEL + 1] = {NULL}; /* use after the then part */
+    int bElse[MAXLEVEL + 1];
+    PRX_NODE *p;
+
+    n = nTmp + nRes;
+    pUse = (char *)mem_slot(DTree, n + 1);
+    memset(pUse, 0, n + 1);
+    level = 0;
+    for (i = 0; (p = NodeH[i]) != NULL; i++) {
+        switch (p->opr) {
+        case IF:
+            prx_revReads(p->o1, pUse);
+            level++;
+            if (!pPre[level]) {
+                pPre[level] = (char *)mem_slot(DTree, n + 1);
+                pThen[level] = (char *)mem_slot(DTree, n + 1);
+            }
+            memcpy(pPre[level], pUse, n + 1);
+            bElse[level] = 0;
+            break;
+        case ELSE: /* the else part starts from the use before the if */
+            memcpy(pThen[level], pUse, n + 1);
+            memcpy(pUse, pPre[level], n + 1);
+            bElse[level] = 1;
+            break;
+        case FI:
+            if (bElse[level]) {
+                for (s = 0; s < n; s++) {
+                    pUse[s] |= pThen[level][s];
+                }
+            }
+            level--;
+            break;
+        case ASS:
+            prx_revReads(p->o1, pUse);
+            if (p->c.optr->typ == TMP) {
+                s = p->c.optr->ind;
+            } else if (p->c.optr->typ == RES) {
+                s = nTmp + p->c.optr->ind;
+            } else {
+                return 0; /* assignment to an input */
+            }
+            if (pUse[s]) {
+                return 0; /* value is overwritten or was read before */
+            }
+            pUse[s] = 1;
+            break;
+        default:
+            if (p->o1) {
+                prx_revReads(p->o1, pUse);
+            }
+            break;
+        }
+    }
+    return 1;
+}
+
+/* ========================================================================== */
+
+/* Operand holding an adjoint */
+static PRX_OPD *prx_adjOpd(TYP typ, int ind) {
+    PRX_OPD *pOpd;
+    PRX_NODE *p;
+
+    pOpd = (PRX_OPD *)mem_slot(DTree, sizeof(PRX_OPD));
+    pOpd->name = "";
+    pOpd->typ = typ;
+    pOpd->ind = ind;
+    pOpd->nAss = 2; /* changes during a sweep, never a stable value */
+    pOpd->bRead = 1;
+    NODED(p, OPD, NULL, (PRX_NODE *)pOpd);
+    pOpd->node = p;
+    return pOpd;
+}
+
+/* Adjoint slot of an operand: temporaries, residuals, inputs; -1 if none */
+static int prx_adjSlot(PRX_OPD *pOpd) {
+    if (pOpd->typ == TMP) {
+        return pOpd->ind;
+    }
+    if (pOpd->typ == RES) {
+        return nAdjTmp + pOpd->ind;
+    }
+    if (pOpd->typ == revTyp) {
+        return nAdjTmp + nRes + pOpd->ind;
+    }
+    return -1;
+}
+
+/* Collect the distinct operands of an expression that depend on the inputs */
+static int prx_adjOpds(PRX_NODE *p, int n) {
+    int i, s;
+
+    switch (p->opr) {
+    case OPD:
+        s = prx_adjSlot(p->c.optr);
+        if (s < 0 || !AdjDep[s]) {
+            return n;
+        }
+        for (i = 0; i < n; i++) {
+            if (AdjList[i] == p->c.optr) {
+                return n;
+            }
+        }
+        AdjList[n++] = p->c.optr;
+        return n;
+    case NUM:
+    case DOPD:
+        return n;
+    default:
+        break;
+    }
+    if (p->o1) {
+        n = prx_adjOpds(p->o1, n);
+    }
+    if (p->opr != ASS && p->c.o2) {
+        n = prx_adjOpds(p->c.o2, n);
+    }
+    return n;
+}
+
+/* Adjoints and matching if, else and fi statements */
+void prx_revInit(void) {
+    int i, nIn, level;
+    int Open[MAXLEVEL + 1], Start[MAXLEVEL + 1];
+
+    nIn = (nVar > nAux) ? nVar : nAux;
+    if (nPar > nIn) {
+        nIn = nPar;
+    }
+    nAdjTmp = nTmp;
+    nAdj = nTmp + nRes + nIn;
+    AdjOpd = (PRX_OPD **)mem_slot(DTree, (nAdj + 1) * sizeof(PRX_OPD *));
+    AdjList = (PRX_OPD **)mem_slot(DTree, (nAdj + 1) * sizeof(PRX_OPD *));
+    for (i = 0; i < nAdj; i++) {
+        if (i < nAdjTmp) {
+            AdjOpd[i] = prx_adjOpd(DTMP, i);
+        } else if (i < nAdjTmp + nRes) {
+            AdjOpd[i] = prx_adjOpd(DRES, i - nAdjTmp);
+        } else {
+            AdjOpd[i] = prx_adjOpd(DARG, i - nAdjTmp - nRes);
+        }
+    }
+    AdjDep = (char *)mem_slot(DTree, nAdj + 1);
+    AdjState = (char *)mem_slot(DTree, nAdj + 1);
+    AdjWrite = (char *)mem_slot(DTree, (MAXLEVEL + 1) * (nAdj + 1));
+    IfMatch = (int *)mem_slot(DTree, (nHead + 1) * sizeof(int));
+
+    level = 0;
+    for (i = 0; NodeH[i]; i++) {
+        switch (NodeH[i]->opr) {
+        case IF:
+            level++;
+            Open[level] = Start[level] = i;
+            break;
+        case ELSE:
+            IfMatch[Open[level]] = i;
+            Open[level] = i;
+            break;
+        case FI:
+            IfMatch[Open[level]] = i;
+            IfMatch[i] = Start[level--];
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/* Temporaries and residuals that depend on the inputs of the kind */
+void prx_revDeps(int nIn) {
+    int i, s;
+    PRX_NODE *p;
+
+    memset(AdjDep, 0, nAdj);
+    for (i = 0; i < nIn; i++) {
+        AdjDep[nAdjTmp + nRes + i] = 1;
+    }
+    for (i = 0; (p = NodeH[i]) != NULL; i++) {
+        if (p->opr == ASS && (s = prx_adjSlot(p->c.optr)) >= 0 &&
+            prx_adjOpds(p->o1, 0) > 0) {
+            AdjDep[s] = 1;
+        }
+    }
+}
+
+/* Append a statement to the code of a column or row */
+static void prx_colAdd(PRX_COL *pCol, int stmt, PRX_NODE *p) {
+    int *pStmt;
+    PRX_NODE **pTree;
+
+    if (pCol->n >= pCol->sz) {
+        pCol->sz = 2 * pCol->sz + 16;
+        pStmt = (int *)mem_slot(DTree, pCol->sz * sizeof(int));
+        pTree = (PRX_NODE **)mem_slot(DTree, pCol->sz * sizeof(PRX_NODE *));
+        if (pCol->n > 0) {
+            memcpy(pStmt, pCol->stmt, pCol->n * sizeof(int));
+            memcpy(pTree, pCol->tree, pCol->n * sizeof(PRX_NODE *));
+        }
+        pCol->stmt = pStmt;
+        pCol->tree = pTree;
+    }
+    pCol->stmt[pCol->n] = stmt;
+    pCol->tree[pCol->n++] = p;
+}
+
+/* Store the implicit value of an adjoint */
+static void prx_adjInit(PRX_COL *pCol, int stmt, int s) {
+    PRX_NODE *pD;
+
+    NODED(pD, ASS, (AdjState[s] == ADJ_ONE) ? N_1 : N_0, NULL);
+    pD->c.optr = AdjOpd[s];
+    AdjState[s] = ADJ_SET;
+    prx_colAdd(pCol, stmt, pD);
+}
+
+/* Add a contribution to an adjoint */
+static void prx_adjAdd(PRX_COL *pCol, int stmt, int s, PRX_NODE *pAdd) {
+    PRX_NODE *pD, *pS;
+
+    if (AdjState[s] == ADJ_ONE) {
+        NODED(pS, ADD, N_1, pAdd);
+    } else if (AdjState[s] == ADJ_SET) {
+        NODED(pS, ADD, AdjOpd[s]->node, pAdd);
+    } else {
+        pS = pAdd;
+    }
+    NODED(pD, ASS, pS, NULL);
+    pD->c.optr = AdjOpd[s];
+    prx_simplify(pD);
+    AdjState[s] = ADJ_SET;
+    prx_colAdd(pCol, stmt, pD);
+}
+
+/* Propagate the adjoint of an assignment to its operands */
+static void prx_revStmt(PRX_COL *pCol, int i) {
+    PRX_NODE *p, *pPart, *pAdd;
+    int s, k, n;
+
+    p = NodeH[i];
+    s = prx_adjSlot(p->c.optr);
+    if (s < 0 || !AdjDep[s] || AdjState[s] == ADJ_ZERO) {
+        return;
+    }
+    n = prx_adjOpds(p->o1, 0);
+    for (k = 0; k < n; k++) {
+        prx_deriv_expr(p, AdjList[k], NULL);
+        prx_simplify(p->abl);
+        prx_simplify(p->abl);
+        pPart = p->abl->o1;
+        if (pPart == N_0) {
+            continue;
+        }
+        if (AdjState[s] == ADJ_SET) {
+            NODED(pAdd, MUL, AdjOpd[s]->node, pPart);
+        } else {
+            pAdd = pPart;
+        }
+        prx_adjAdd(pCol, i, prx_adjSlot(AdjList[k]), pAdd);
+    }
+}
+
+/* Reverse an if block, the adjoints it may change are stored before */
+static void prx_revIf(PRX_COL *pCol, int j, int level) {
+    int i, k, n, s, e, f, bMore;
+    char *w;
+    PRX_NODE *p;
+
+    f = IfMatch[j];
+    e = -1;
+    if (NodeH[f]->opr == ELSE) {
+        e = f;
+        f = IfMatch[e];
+    }
+    w = AdjWrite + level * (nAdj + 1);
+    memset(w, 0, nAdj);
+    do {
+        bMore = 0;
+        for (i = j + 1; i < f; i++) {
+            p = NodeH[i];
+            if (p->opr != ASS) {
+                continue;
+            }
+            s = prx_adjSlot(p->c.optr);
+            if (s < 0 || !AdjDep[s] || (AdjState[s] == ADJ_ZERO && !w[s])) {
+                continue;
+            }
+            n = prx_adjOpds(p->o1, 0);
+            for (k = 0; k < n; k++) {
+                s = prx_adjSlot(AdjList[k]);
+                if (!w[s]) {
+                    w[s] = 1;
+                    bMore = 1;
+                }
+            }
+        }
+    } while (bMore);
+    for (s = 0, n = 0; s < nAdj; s++) {
+        if (w[s]) {
+            n++;
+            if (AdjState[s] != ADJ_SET) {
+                prx_adjInit(pCol, j, s);
+            }
+        }
+    }
+    if (n == 0) {
+        return; /* no adjoint changes */
+    }
+    prx_colAdd(pCol, j, NodeH[j]);
+    prx_revBlock(pCol, j + 1, ((e >= 0) ? e : f) - 1, level);
+    if (e >= 0) {
+        prx_colAdd(pCol, e, NodeH[e]);
+        prx_revBlock(pCol, e + 1, f - 1, level);
+    }
+    prx_colAdd(pCol, f, NodeH[f]);
+}
+
+/* Reverse the statements first to last */
+void prx_revBlock(PRX_COL *pCol, int first, int last, int level) {
+    int i;
+
+    for (i = last; i >= first; i--) {
+        switch (NodeH[i]->opr) {
+        case FI:
+            i = IfMatch[i];
+            prx_revIf(pCol, i, level + 1);
+            break;
+        case ASS:
+            prx_revStmt(pCol, i);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/* Reverse sweep for the derivatives of a residual to all inputs of a kind */
+void prx_revRow(PRX_COL *pCol, int r, int nIn) {
+    int i, n;
+
+    pCol->n = pCol->sz = 0;
+    pCol->stmt = NULL;
+    pCol->tree = NULL;
+    pCol->live = NULL;
+    memset(AdjState, ADJ_ZERO, nAdj);
+    AdjState[nAdjTmp + r] = ADJ_ONE;
+    for (n = 0; NodeH[n]; n++)
+        ;
+    prx_revBlock(pCol, 0, n - 1, 0);
+    for (i = 0; i < nIn; i++) {
+        if (AdjState[nAdjTmp + nRes + i] != ADJ_SET) {
+            prx_adjInit(pCol, 0, nAdjTmp + nRes + i); /* no dependence */
+        }
+    }
+}
+
+/* ========================================================================== */
+
+/* Size of the code of an expression */
+static int prx_treeCost(PRX_NODE *p) {
+    switch (p->opr) {
+    case OPD:
+    case DOPD:
+    case NUM:
+    case ELSE:
+    case FI:
+        return 1;
+    case EQU:
+        return prx_treeCost(p->o1);
+    case ASS:
+    case IF:
+        return 1 + prx_treeCost(p->o1);
+    default:
+        return 1 + (p->o1 ? prx_treeCost(p->o1) : 0) +
+               (p->c.o2 ? prx_treeCost(p->c.o2) : 0);
+    }
+}
+
+/* Size of the derivative code of a column or row, to choose the mode */
+int prx_colCost(PRX_COL *pCol) {
+    int i, cost;
+
+    for (i = 0, cost = 0; i < pCol->n; i++) {
+        cost += prx_treeCost(pCol->tree[i]);
+    }
+    return cost;
+}
+
+/* ========================================================================== */
+
+/* Output of function code and all derivative columns */
+int prx_emit(void) {
+    int i, k, c, c1;
+    PRX_NODE *p;
+    PRX_COL *pCol;
+
+    /* forget the evaluations of a previous pass */
+    for (i = 0; i < VALHASH; i++) {
+        PRX_VAL *pVal;
+        for (pVal = ValHash[i]; pVal; pVal = pVal->next) {
+            pVal->def = NULL;
+        }
+    }
+    DefNext = DefFirst;
+
+    bDeriv = 0;
+    cseCol = -1;
+    for (i = 0; (p = NodeH[i]) != NULL; i++) {
+        if (p->opr == ASS && p->c.optr->typ == TMP &&
+            !TmpLive[p->c.optr->ind]) {
+            continue; /* dead temporary */
+        }
+        cseReg = RegStmt[i];
+        if (!prx_genCode(p)) {
+            return 0;
+        }
+    }
+
+    bDeriv = 1;
+    nTmpBase = nTmp;
+    for (k = 0, c = 0; k < 3; k++) {
+        WRITEO(KindRev[k] ? SOR : SOK);
+        for (c1 = c + KindN[k]; c < c1; c++) {
+            pCol = Cols + c;
+            cseCol = c;
+            nTmpTop = nTmpBase;
+            for (i = 0; i < pCol->n; i++) {
+                p = pCol->tree[i];
+                if (p->opr == ASS && p->c.optr->typ == TMP &&
+                    !pCol->live[p->c.optr->ind]) {
+                    continue; /* dead derivative of temporary */
+                }
+                cseReg = RegStmt[pCol->stmt[i]];
+                if (!prx_genCode(p)) {
+                    return 0;
+                }
+            }
+            WRITEO(EOD);
+        }
+    }
+    bDeriv = 0;
+    return 1;
+}
+
+/* ========================================================================== */
+
+/* Regions of statements, an if or else block starts a new region */
+void prx_regions(void) {
+    int i, level, nReg;
+    int Up[MAXLEVEL + 1];
+
+    RegStmt = (int *)mem_slot(DTree, (nHead + 1) * sizeof(int));
+    RegUp = (int *)mem_slot(DTree, (nHead + 2) * sizeof(int));
+    level = 0;
+    nReg = 1;
+    RegUp[0] = -1;
+    Up[0] = 0;
+    for (i = 0; NodeH[i]; i++) {
+        switch (NodeH[i]->opr) {
+        case IF:
+            RegStmt[i] = Up[level];
+            RegUp[nReg] = Up[level];
+            Up[++level] = nReg++;
+            break;
+        case ELSE:
+            RegStmt[i] = Up[level - 1];
+            RegUp[nReg] = Up[level - 1];
+            Up[level] = nReg++;
+            break;
+        case FI:
+            RegStmt[i] = Up[--level];
+            break;
+        default:
+            RegStmt[i] = Up[level];
+            break;
+        }
+    }
+}
+
+/* ========================================================================== */
+
+/* Value numbering of all expressions */
+void prx_number(void) {
+    int i, c;
+    PRX_NODE *p;
+    PRX_VAL *pVal;
+    PRX_OPD *pOpd;
+
+    for (i = 0; (p = NodeH[i]) != NULL; i++) {
+        if (p->o1 && (p->opr == ASS || p->opr == IF || p->opr == RET)) {
+            pVal = prx_value(p->o1);
+            pOpd = p->c.optr;
+            if (p->opr == ASS && RegStmt[i] == 0 && prx_cseTarget(pOpd) &&
+                pVal->a && pVal->stable && !pVal->copy && !pOpd->node->val) {
+                /* operand is a copy of its unconditional assignment */
+                pVal->copy = pOpd;
+                pOpd->node->val = pVal;
+            }
+        }
+    }
+    for (c = 0; c < nCol; c++) {
+        for (i = 0; i < Cols[c].n; i++) {
+            p = Cols[c].tree[i];
+            if (p->o1 && (p->opr == ASS || p->opr == IF)) {
+                prx_value(p->o1);
+            }
+        }
+    }
+}
+
+/* ========================================================================== */
+
+/* Value of an expression, equal expressions get the same value */
+PRX_VAL *prx_value(PRX_NODE *p) {
+    PRX_VAL *pVal, *a, *b;
+    PRX_OPD *pOpd;
+    PRX_NUM *pNum;
+    unsigned int h;
+
+    while (p->opr == EQU) {
+        p = p->o1;
+    }
+    if (p->val) {
+        return p->val;
+    }
+    a = b = NULL;
+    pOpd = NULL;
+    pNum = NULL;
+    switch (p->opr) {
+    case OPD:
+    case DOPD:
+        pOpd = p->c.optr;
+        h = (unsigned int)pOpd->typ * 65599u + (unsigned int)pOpd->ind;
+        break;
+    case NUM:
+        pNum = p->c.nptr;
+        h = (unsigned int)pNum->ind;
+        break;
+    case AND:
+    case OR:
+    case EQ:
+    case NE:
+    case ADD:
+    case MUL: /* commutative */
+        a = prx_value(p->o1);
+        b = prx_value(p->c.o2);
+        if (a->id > b->id) {
+            pVal = a;
+            a = b;
+            b = pVal;
+        }
+        h = (unsigned int)(a->id * 31 + b->id);
+        break;
+    case LT:
+    case GT:
+    case LE:
+    case GE:
+    case SUB:
+    case DIV:
+    case POW:
+        a = prx_value(p->o1);
+        b = prx_value(p->c.o2);
+        h = (unsigned int)(a->id * 31 + b->id);
+        break;
+    default:
+        a = prx_value(p->o1);
+        h = (unsigned int)a->id;
+        break;
+    }
+    h = (h * 61 + (unsigned int)p->opr) % VALHASH;
+
+    for (pVal = ValHash[h]; pVal; pVal = pVal->next) {
+        if (pVal->opr == p->opr && pVal->a == a && pVal->b == b &&
+            pVal->opd == pOpd && pVal->num == pNum) {
+            p->val = pVal;
+            return pVal;
+        }
+    }
+    pVal = (PRX_VAL *)mem_slot(DTree, sizeof(PRX_VAL));
+    pVal->opr = p->opr;
+    pVal->a = a;
+    pVal->b = b;
+    pVal->opd = pOpd;
+    pVal->num = pNum;
+    pVal->def = NULL;
+    pVal->copy = NULL;
+    pVal->id = nVal++;
+    pVal->mark = 0;
+    pVal->cost = 1 + (a ? a->cost : 0) + (b ? b->cost : 0);
+    pVal->stable = (!a || a->stable) && (!b || b->stable) &&
+                   (!pOpd || pOpd->nAss <= 1);
+    pVal->next = ValHash[h];
+    ValHash[h] = pVal;
+    p->val = pVal;
+    return pVal;
+}
+
+/* ========================================================================== */
+
+/* Mark the temporaries an expression depends on */
+static void prx_liveVal(PRX_VAL *pVal, char *live) {
+    PRX_OPD *pOpd;
+
+    if (pVal->mark == nMark) {
+        return;
+    }
+    pVal->mark = nMark;
+    if (pVal->copy && pVal->copy->typ == TMP && !TmpLive[pVal->copy->ind]) {
+        TmpLive[pVal->copy->ind] = 1; /* may be read instead */
+        bChange = 1;
+    }
+    pOpd = pVal->opd;
+    if (pOpd && pOpd->typ == TMP) {
+        if (pVal->opr == OPD && !TmpLive[pOpd->ind]) {
+            TmpLive[pOpd->ind] = 1;
+            bChange = 1;
+        } else if (pVal->opr == DOPD && live && !live[pOpd->ind]) {
+            live[pOpd->ind] = 1;
+            bChange = 1;
+        }
+    }
+    if (pVal->a) {
+        prx_liveVal(pVal->a, live);
+    }
+    if (pVal->b) {
+        prx_liveVal(pVal->b, live);
+    }
+}
+
+/* Determine the temporaries and derivatives that are actually needed */
+void prx_live(void) {
+    int i, c, ind;
+    PRX_NODE *p;
+    PRX_COL *pCol;
+
+    TmpLive = (char *)mem_slot(DTree, nTmp + 1);
+    for (i = 0; i < nTmp; i++) {
+        TmpLive[i] = 0;
+    }
+    for (c = 0; c < nCol; c++) {
+        Cols[c].live = (char *)mem_slot(DTree, nTmp + 1);
+        memset(Cols[c].live, 0, nTmp + 1);
+    }
+    do {
+        bChange = 0;
+        nMark++;
+        for (i = 0; (p = NodeH[i]) != NULL; i++) {
+            if (!p->o1 || p->opr == ELSE || p->opr == FI) {
+                continue;
+            }
+            if (p->opr == ASS && p->c.optr->typ == TMP &&
+                !TmpLive[p->c.optr->ind]) {
+                continue;
+            }
+            prx_liveVal(prx_value(p->o1), NULL);
+        }
+        for (c = 0; c < nCol; c++) {
+            pCol = Cols + c;
+            nMark++;
+            for (i = 0; i < pCol->n; i++) {
+                p = pCol->tree[i];
+                if (!p->o1 || p->opr == ELSE || p->opr == FI) {
+                    continue;
+                }
+                if (p->opr == ASS && p->c.optr->typ == TMP) {
+                    ind = p->c.optr->ind;
+                    if (!pCol->live[ind]) {
+                        continue;
+                    }
+                    if (!TmpLive[ind]) { /* derivative needs the value */
+                        TmpLive[ind] = 1;
+                        bChange = 1;
+                    }
+                }
+                prx_liveVal(prx_value(p->o1), pCol->live);
+            }
+        }
+    } while (bChange);
+}
+
+/* ========================================================================== */
+
+/* Is it worth to keep the value of an expression for reuse */
+int prx_cseWorth(PRX_VAL *pVal) {
+    if (!pVal->stable || !pVal->a) {
+        return 0;
+    }
+    switch (pVal->opr) {
+    case DIV:
+    case POW:
+    case REV:
+    case SIN:
+    case COS:
+    case TAN:
+    case ASIN:
+    case ACOS:
+    case ATAN:
+    case EXP:
+    case LOG:
+    case LG:
+    case SQRT:
+        return 1;
+    default:
+        return (pVal->cost >= 3);
+    }
+}
+
+/* ========================================================================== */
+
+/* Earlier evaluation of a value that is available at the current position */
+PRX_DEF *prx_cseFind(PRX_VAL *pVal) {
+    PRX_DEF *pDef;
+    int reg;
+
+    for (pDef = pVal->def; pDef; pDef = pDef->next) {
+        if (pDef->col >= 0 && pDef->col != cseCol) {
+            continue; /* other derivative column */
+        }
+        for (reg = cseReg; reg >= 0 && reg != pDef->reg; reg = RegUp[reg])
+            ;
+        if (reg >= 0) { /* evaluated in the same or an enclosing block */
+            return pDef;
+        }
+    }
+    return NULL;
+}
+
+/* ========================================================================== */
+
+/* Record an evaluation of a value at the current position */
+PRX_DEF *prx_cseDef(PRX_VAL *pVal) {
+    PRX_DEF *pDef;
+
+    if (bCount) {
+        pDef = (PRX_DEF *)mem_slot(DTree, sizeof(PRX_DEF));
+        pDef->seq = NULL;
+        pDef->nUse = 0;
+        *DefLast = pDef;
+        DefLast = &pDef->seq;
+    } else { /* same order as in the counting pass */
+        pDef = DefNext;
+        assert(pDef != NULL);
+        DefNext = pDef->seq;
+    }
+    pDef->typ = -1;
+    pDef->ind = -1;
+    pDef->col = cseCol;
+    pDef->reg = cseReg;
+    pDef->next = pVal->def;
+    pVal->def = pDef;
+    return pDef;
+}
+
+/* ========================================================================== */
+
+/* Can the assigned value be read back from the operand */
+int prx_cseTarget(PRX_OPD *pOpd) {
+    return ((pOpd->typ == TMP || pOpd->typ == RES) && pOpd->nAss <= 1);
+}
+
+/* Read back an evaluation from the assigned operand */
+void prx_cseRead(PRX_DEF *pDef, PRX_OPD *pOpd) {
+    pDef->typ = pOpd->typ;
+    if (bDeriv) {
+        pDef->typ = (pOpd->typ == RES) ? DRES : DTMP;
+    }
+    pDef->ind = pOpd->ind;
+}
@@ -22,6 +22,7 @@
 #define __PRX_DEF_H
 
 #include "primtype.h"
+#include <stdint.h>
 
 /*
  * header file for PARX model code generator
@@ -30,19 +31,24 @@
 /* File identifier */
 #define FILEID "PARX interpreter code"
 /* Version */
-#define CODE_VERSION 3
-/* maximum line length in model description file (without newline) */
-#define MAXLINE 132
+#define CODE_VERSION 5
+/* compiler revision, bump whenever the code generated by prx.c changes */
+#define COMPILER_REVISION 3
 /* maximum nesting level of conditional statements */
 #define MAXLEVEL 10
-/* maximum name length */
-#define MAXNAME 16
-/* maximum number of statements (assignments, if, else, fi) */
-#define MAXEQU    4096
+
+/*
+ * A code file holds 32 bit words: the number of constants, the number of
+ * temporaries, the maximum operand stack depth, the length of FILEID
+ * followed by its characters, CODE_VERSION and the code up to STOP,
+ * followed by the constants as doubles.
+ */
+typedef int32_t CODEWORD;
 
 typedef enum {
     VAR, AUX, PAR, CON, FLG, RES, TMP,
-    DRES, DTMP
+    DRES, DTMP, DARG,
+    REG, KON /* interpreter only: registers and numerical constants */
 } TYP;
 
 typedef enum {
@@ -51,7 +57,9 @@ typedef enum {
     SIN, COS, TAN, ASIN, ACOS, ATAN,
     EXP, LOG, LG, SQRT, ABS, SGN, RET, CHKL, CHKG,
     OPD, NUM, DOPD, LDF, ASS, NASS, CLR,
-    JMP, IF, ELSE, FI, EOD, SOK, STOP
+    JMP, IF, ELSE, FI, EOD, SOK, SOR, STOP,
+    /* interpreter only: move and fused operations */
+    MOV, MADD, MSUB, NMADD, EXPM, EXPD
 } OPR;
 
 struct PRX_NODE_S {
@@ -65,6 +73,7 @@ struct PRX_NODE_S {
     } c;
 
     struct PRX_NODE_S *abl;
+    struct PRX_VAL_S *val; /* value number, shared by equal expressions */
 };
 typedef struct PRX_NODE_S PRX_NODE;
 
@@ -80,6 +89,8 @@ struct PRX_OPD_S {
     PRX_NODE *node;
     int ind;
     TYP typ;
+    int nAss; /* assignments, a read before assignment counts as one */
+    int bRead;
 };
 typedef struct PRX_OPD_S PRX_OPD;
 
@@ -89,9 +100,16 @@ struct HEADER_S {
 };
 typedef struct HEADER_S HEADER;
 
+/* relative operand slot, resolved against the bound moddat at run time */
+struct PRX_SLOT_S {
+    int typ; /* type of operand (TYP) */
+    int ind; /* index within that type */
+};
+typedef struct PRX_SLOT_S SLOT;
+
 union PRX_CODE_U {
     OPR o;
-    fnum *f;
+    SLOT s;
     union PRX_CODE_U *c;
 };
 typedef union PRX_CODE_U CODE;
@@ -109,8 +127,15 @@ extern int prx_deriv_all();
 extern int prx_error();
 extern int prx_exit(void);
 extern int prx_name(char *);
+extern int prx_stack(OPR opr);
 extern int prx_values(char *, double *, int *);
 
+extern int prx_cCode(FILE *codeFile, FILE *cFile, unsigned long long hash);
+extern int prx_genC(FILE *codeFile, FILE *cFile, char *model, int nRes,
+                    int nVar, int nAux, int nPar, int nCon, int nFlag,
+                    unsigned long long hash);
+extern int prx_hash(char *fileName, unsigned long long *hash);
+
 extern char prx_filename[];
 extern int prx_lineno;
 
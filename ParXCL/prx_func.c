@@ -38,12 +38,41 @@ int prx_name(char *ps) {
     /* 2-nd - last character */
     while (b = *(++pe), isalnum(b) || *pe == '_')
         ;
-    if (pe - ps > MAXNAME) {
-        return (int)(ps - pe);
-    }
     return (int)(pe - ps);
 }
 
+/* change of the operand stack depth by an operator */
+int prx_stack(OPR opr) {
+    switch (opr) {
+    case OPD:
+    case NUM:
+        return 1;
+    case AND:
+    case OR:
+    case LT:
+    case GT:
+    case LE:
+    case GE:
+    case EQ:
+    case NE:
+    case ADD:
+    case SUB:
+    case MUL:
+    case DIV:
+    case POW:
+    case ASS:
+    case NASS:
+    case IF:
+    case RET:
+        return -1;
+    case CHKL:
+    case CHKG:
+        return -2;
+    default:
+        return 0;
+    }
+}
+
 /* syntax check of a value list */
 int prx_values(char *ps, double *Vals, int *pNVals) {
     char *pe;
@@ -22,17 +22,264 @@
 #include "primtype.h"
 #include "prx_def.h"
 
+#include <sys/stat.h>
+
 #define FILENN 1024
 char prx_filename[FILENN]; /* name model file */
 int prx_lineno;            /* line number model file */
+int prx_ccode = 0;         /* also build a C plugin */
+
+/*
+ * Compile cache: a stamp file next to the generated code holds a hash of
+ * the model source and the code version. A model whose stamp matches is
+ * not compiled again. Models found up to date are also remembered for
+ * the rest of the session, keyed on modification time and size.
+ */
+
+typedef struct PRX_MEMO_S {
+    struct PRX_MEMO_S *next;
+    char *name;   /* model file */
+    time_t mtime; /* modification time when checked */
+    off_t size;   /* size when checked */
+} PRX_MEMO;
+
+static PRX_MEMO *prx_memo = NULL; /* models up to date in this session */
+
+/* copy a filename with another extension */
+static void prx_fileExt(char *dst, char *src, char *ext) {
+    char *pe;
+
+    strcpy(dst, src);
+    pe = strrchr(dst, '.');
+    if (pe) {
+        *pe = '\0';
+    }
+    strcat(dst, ext);
+}
+
+/* 1 = file exists */
+static int prx_exists(char *fileName) {
+    struct stat st;
+
+    return (stat(fileName, &st) == 0);
+}
+
+/* 1 = generated files of the model are present */
+static int prx_outputs(char *fileName) {
+    char name[FILENN];
+    struct stat ps, ms;
+
+    prx_fileExt(name, fileName, MODEL_CODE_EXT);
+    if (!prx_exists(name)) {
+        return 0;
+    }
+    if (prx_ccode) { /* plugin not older than the model source */
+        prx_fileExt(name, fileName, MODEL_PLUGIN_EXT);
+        if (stat(name, &ps) != 0 || stat(fileName, &ms) != 0 ||
+            ps.st_mtime < ms.st_mtime) {
+            return 0;
+        }
+    }
+    prx_fileExt(name, fileName, MODEL_INTERFACE_EXT);
+    return prx_exists(name);
+}
+
+/* hash of model source and code version: 0 = error, 1 = okay */
+int prx_hash(char *fileName, unsigned long long *hash) {
+    FILE *fp;
+    unsigned long long h;
+    char *pc;
+    int c;
+
+    fp = fopen(fileName, "rb");
+    if (!fp) {
+        return 0;
+    }
+    h = 14695981039346656037ULL; /* FNV-1a */
+    for (pc = FILEID; *pc; pc++) {
+        h = (h ^ (unsigned char)*pc) * 1099511628211ULL;
+    }
+    h = (h ^ (unsigned long long)CODE_VERSION) * 1099511628211ULL;
+    h = (h ^ (unsigned long long)COMPILER_REVISION) * 1099511628211ULL;
+    while ((c = getc(fp)) != EOF) {
+        h = (h ^ (unsigned char)c) * 1099511628211ULL;
+    }
+    fclose(fp);
+    *hash = h;
+    return 1;
+}
+
+/* 1 = model remembered as up to date in this session */
+static int prx_memoFind(char *fileName, struct stat *st) {
+    PRX_MEMO *pm;
+
+    for (pm = prx_memo; pm; pm = pm->next) {
+        if (strcmp(pm->name, fileName) == 0) {
+            return (pm->mtime == st->st_mtime && pm->size == st->st_size);
+        }
+    }
+    return 0;
+}
+
+/* remember a model as up to date in this session */
+static void prx_memoEnter(char *fileName) {
+    PRX_MEMO *pm;
+    struct stat st;
+
+    if (stat(fileName, &st) != 0) {
+        return;
+    }
+    for (pm = prx_memo; pm; pm = pm->next) {
+        if (strcmp(pm->name, fileName) == 0) {
+            break;
+        }
+    }
+    if (!pm) {
+        pm = (PRX_MEMO *)malloc(sizeof(PRX_MEMO));
+        if (!pm) {
+            return;
+        }
+        pm->name = (char *)malloc(strlen(fileName) + 1);
+        if (!pm->name) {
+            free(pm);
+            return;
+        }
+        strcpy(pm->name, fileName);
+        pm->next = prx_memo;
+        prx_memo = pm;
+    }
+    pm->mtime = st.st_mtime;
+    pm->size = st.st_size;
+}
+
+/* 1 = the generated files match the model source */
+static int prx_upToDate(char *fileName, unsigned long long hash) {
+    char name[FILENN];
+    unsigned long long stamp;
+    FILE *fp;
+    int n;
+
+    if (!prx_outputs(fileName)) {
+        return 0;
+    }
+    prx_fileExt(name, fileName, MODEL_STAMP_EXT);
+    fp = fopen(name, "r");
+    if (!fp) {
+        return 0;
+    }
+    n = fscanf(fp, "%llx", &stamp);
+    fclose(fp);
+    return (n == 1 && stamp == hash);
+}
+
+/* record the hash of a successfully compiled model */
+static void prx_writeStamp(char *fileName, unsigned long long hash) {
+    char name[FILENN];
+    FILE *fp;
+
+    prx_fileExt(name, fileName, MODEL_STAMP_EXT);
+    fp = fopen(name, "w");
+    if (!fp) {
+        return; /* no cache, not an error */
+    }
+    fprintf(fp, "%016llx\n", hash);
+    fclose(fp);
+}
+
+/* translate the code file into C source: 0 = error, 1 = okay */
+static int prx_compileC(FILE *codeFile, char *fileName, char *pe,
+                        unsigned long long hash) {
+    FILE *inFile;
+    FILE *cFile;
+    int rc;
+
+    fflush(codeFile);
+    strcpy(pe, MODEL_CODE_EXT);
+    inFile = fopen(fileName, "rb");
+    if (!inFile) {
+        printf("Error opening code file for reading '%s'\n", fileName);
+        return 0;
+    }
+    strcpy(pe, MODEL_C_EXT);
+    cFile = fopen(fileName, "w");
+    if (!cFile) {
+        printf("Error opening C file for writing '%s'\n", fileName);
+        fclose(inFile);
+        return 0;
+    }
+    printf("   Writing C file '%s'\n", fileName);
+
+    rc = prx_cCode(inFile, cFile, hash);
+
+    fclose(inFile);
+    fclose(cFile);
+    return rc;
+}
+
+/*
+ * Build the C source into a model plugin with the system C compiler. The
+ * command must make the ParX and tmc headers visible, for example
+ * PARX_CC="cc -O2 -shared -fPIC -I/usr/local/src/ParXCL". The plugin is
+ * built under another name and then renamed, so a loaded plugin of the
+ * previous source is not overwritten. 0 = error, 1 = okay
+ */
+static int prx_buildPlugin(char *fileName, char *pe) {
+    char cName[FILENN];
+    char soName[FILENN];
+    char tmpName[FILENN + 1];
+    char *cmd;
+    char *cc;
+
+    strcpy(pe, MODEL_C_EXT);
+    strcpy(cName, fileName);
+    strcpy(pe, MODEL_PLUGIN_EXT);
+    strcpy(soName, fileName);
+    strcpy(tmpName, soName);
+    strcat(tmpName, "~");
+
+    cc = getenv(MODEL_CC_ENV);
+    if (!cc || !*cc) {
+        cc = MODEL_CC;
+    }
+    cmd = (char *)malloc(strlen(cc) + strlen(tmpName) + strlen(cName) + 32);
+    if (!cmd) {
+        return 0;
+    }
+    sprintf(cmd, "%s -DPARX_PLUGIN -o \"%s\" \"%s\"", cc, tmpName, cName);
+
+    printf("   Building plugin '%s'\n", soName);
+    fflush(stdout);
+
+    if (system(cmd) != 0) {
+        printf("Error building plugin with '%s'\n", cmd);
+        free(cmd);
+        remove(tmpName);
+        return 0;
+    }
+    free(cmd);
+
+    if (rename(tmpName, soName) != 0) {
+        remove(soName); /* rename does not replace on Windows */
+        if (rename(tmpName, soName) != 0) {
+            printf("Error renaming plugin to '%s'\n", soName);
+            remove(tmpName);
+            return 0;
+        }
+    }
+    return 1;
+}
 
 int prx_compile(tmstring mdlFileName) {
     FILE *inFile;
     FILE *codeFile;
     FILE *modFile;
     char fileName[FILENN];
+    char stampName[FILENN];
     char *pe;
     int bError;
+    int bHash;
+    unsigned long long hash;
+    struct stat st;
 
     /* opening 1 input file and 2 output files */
 
@@ -54,6 +301,22 @@ int prx_compile(tmstring mdlFileName) {
 
     strcpy(prx_filename, fileName); /* copy input filename to global */
 
+    /* skip compilation of an unchanged model */
+
+    if (stat(fileName, &st) == 0 && prx_memoFind(fileName, &st) &&
+        prx_outputs(fileName)) {
+        printf("   Model code of '%s' is up to date\n\n", fileName);
+        return (0);
+    }
+    bHash = prx_hash(fileName, &hash);
+    if (bHash && prx_upToDate(fileName, hash)) {
+        printf("   Model code of '%s' is up to date\n\n", fileName);
+        prx_memoEnter(fileName);
+        return (0);
+    }
+    prx_fileExt(stampName, fileName, MODEL_STAMP_EXT);
+    remove(stampName); /* invalid until compiled */
+
     inFile = fopen(fileName, "r");
     if (!inFile) {
         printf("Error opening model file '%s'\n", fileName);
@@ -115,12 +378,23 @@ int prx_compile(tmstring mdlFileName) {
         printf("Warning(s) during creation of model code\n");
     }
 
+    if (prx_ccode && !prx_compileC(codeFile, fileName, pe, bHash ? hash : 0)) {
+        goto error;
+    }
+    if (prx_ccode && !prx_buildPlugin(fileName, pe)) {
+        goto error;
+    }
+
     prx_exit();
 
     /* closing files */
     fclose(inFile);
     fclose(codeFile);
     fclose(modFile);
+    if (bHash) {
+        prx_writeStamp(prx_filename, hash);
+        prx_memoEnter(prx_filename);
+    }
     printf("Creation of model code successfully completed\n");
     return 0;
 
@@ -134,10 +408,63 @@ error:
     return 1;
 }
 
+/*
+ * Read a line of any length into the growable buffer *pBuf, the line always
+ * ends with a newline: -1 = out of memory, 0 = end of file, 1 = okay
+ */
+static int prx_getline(char **pBuf, size_t *pSize, FILE *inFile) {
+    size_t n;
+    char *p;
+
+    n = 0;
+    while (1) {
+        if (*pSize - n < 2) {
+            p = (char *)realloc(*pBuf, 2 * *pSize);
+            if (!p) {
+                return -1;
+            }
+            *pBuf = p;
+            *pSize *= 2;
+        }
+        if (!fgets(*pBuf + n, (int)(*pSize - n), inFile)) {
+            break;
+        }
+        n += strlen(*pBuf + n);
+        if ((*pBuf)[n - 1] == '\n') {
+            return 1;
+        }
+    }
+    if (n == 0) {
+        return 0;
+    }
+    (*pBuf)[n++] = '\n'; /* last line without newline */
+    (*pBuf)[n] = 0;
+    return 1;
+}
+
+/* Room in the command buffer for another line of n characters */
+static char *prx_cmdRoom(char **pCmd, size_t *pSize, char *pa, size_t n) {
+    size_t used;
+    char *p;
+
+    used = (size_t)(pa - *pCmd);
+    if (used + n + 2 <= *pSize) {
+        return pa;
+    }
+    p = (char *)realloc(*pCmd, 2 * *pSize + n + 2);
+    if (!p) {
+        return NULL;
+    }
+    *pSize = 2 * *pSize + n + 2;
+    *pCmd = p;
+    return p + used;
+}
+
 /* parse the model file: 0 = error, 1 = okay */
 int prx_parse(FILE *inFile) {
-    char Buf[MAXLINE + 4];
-    char Cmd[4096];
+    char *Buf, *Cmd;
+    size_t szBuf, szCmd;
+    int bOk;
     char *pe, *pa;
     int bComment;     /* comment switch */
     int bLineComment; /* line comment switch */
@@ -146,6 +473,13 @@ int prx_parse(FILE *inFile) {
 
     /* parsing header part of PARX model description file */
     bComment = bLineComment = bString = bCont = prx_lineno = 0;
+    bOk = 0;
+    szBuf = szCmd = 256;
+    Buf = (char *)malloc(szBuf);
+    Cmd = (char *)malloc(szCmd);
+    if (!Buf || !Cmd) {
+        goto noroom;
+    }
     pe = Buf;
     *pe = '\n';
     pa = Cmd;
@@ -164,8 +498,15 @@ int prx_parse(FILE *inFile) {
             if (bCont) {
                 pa--;
             }
-            if (!fgets(Buf, MAXLINE, inFile)) {
-                break;
+            switch (prx_getline(&Buf, &szBuf, inFile)) {
+            case -1:
+                goto noroom;
+            case 0:
+                goto header;
+            }
+            pa = prx_cmdRoom(&Cmd, &szCmd, pa, strlen(Buf));
+            if (!pa) {
+                goto noroom;
             }
             prx_lineno++;
             pe = Buf;
@@ -228,12 +569,13 @@ int prx_parse(FILE *inFile) {
         }
         *(pa++) = *(pe++);
     }
+header:
 
     if (prx_error() & 2) {
-        return 0;
+        goto done;
     }
     if (!prx_derivLists()) {
-        return 0;
+        goto done;
     }
 
     /* parsing equation part of PARX model description file */
@@ -247,15 +589,22 @@ int prx_parse(FILE *inFile) {
             if (!bComment && !bCont) {
                 *pa = 0;
                 if (!prx_equation(Cmd)) { /* break at first error */
-                    return 0;
+                    goto done;
                 }
                 pa = Cmd;
             }
             if (bCont) {
                 pa--;
             }
-            if (!fgets(Buf, MAXLINE, inFile)) {
-                break;
+            switch (prx_getline(&Buf, &szBuf, inFile)) {
+            case -1:
+                goto noroom;
+            case 0:
+                goto equations;
+            }
+            pa = prx_cmdRoom(&Cmd, &szCmd, pa, strlen(Buf));
+            if (!pa) {
+                goto noroom;
             }
             prx_lineno++;
             pe = Buf;
@@ -298,7 +647,7 @@ int prx_parse(FILE *inFile) {
         if (*pe == ';') {
             *pa = 0;
             if (!prx_equation(Cmd)) {
-                return 0;
+                goto done;
             }
             pa = Cmd;
             pe++;
@@ -306,5 +655,14 @@ int prx_parse(FILE *inFile) {
         }
         *(pa++) = *(pe++);
     }
-    return 1;
+equations:
+    bOk = 1;
+    goto done;
+
+noroom:
+    printf("Out of memory reading the model file\n");
+done:
+    free(Buf);
+    free(Cmd);
+    return bOk;
 }
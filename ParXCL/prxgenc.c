@@ -0,0 +1,555 @@
+/*
+ * ParX - prxgenc.c
+ * Model Compiler, convert intermediate code to a C model procedure
+ *
+ * Copyright (c) 2026 M.G.Middelhoek <martin@middelhoek.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The intermediate code is a postfix walk of the expression trees of the
+ * function and all derivatives. The operand stack depth is known at every
+ * position, so each stack position becomes a local variable of the
+ * generated procedure, and the code becomes straight-line C that the
+ * system compiler can optimize freely. Conditionals map onto if/else, the
+ * derivative columns onto blocks guarded by the evaluation flags. A kind
+ * in reverse mode has a block per residual, which stores the adjoints of
+ * the inputs in a row of the Jacobian.
+ */
+
+#include "parx.h"
+#include "prx_def.h"
+
+#define READSH(V)                                                              \
+    {                                                                          \
+        if (fread((char *)&sh, sizeof(sh), 1, codeFile) != 1) {                \
+            printf("C code: premature end of code file\n");                    \
+            goto failed;                                                       \
+        }                                                                      \
+        V = sh;                                                                \
+    }
+
+static char *cOperand(TYP typ, int ind);
+static void cIndent(FILE *cFile, int level);
+static void cWanted(FILE *cFile, int kod, const char *j);
+static void cColumn(FILE *cFile, int kod, int iDvt, int level);
+static void cRow(FILE *cFile, int kod, int iDvt, int nIn, int level);
+
+static int bRevKind; /* current kind is in reverse mode */
+
+/* ========================================================================== */
+
+/* C expression of an operand */
+char *cOperand(TYP typ, int ind) {
+    static char buf[64];
+
+    switch (typ) {
+    case VAR:
+        sprintf(buf, "x[%d]", ind);
+        break;
+    case AUX:
+        sprintf(buf, "a[%d]", ind);
+        break;
+    case PAR:
+        sprintf(buf, "p[%d]", ind);
+        break;
+    case CON:
+        sprintf(buf, "c[%d]", ind);
+        break;
+    case FLG:
+        sprintf(buf, "(trunc(f[%d]) ? 1.0 : 0.0)", ind);
+        break;
+    case RES:
+        sprintf(buf, "r[%d]", ind);
+        break;
+    case TMP:
+        sprintf(buf, "t%d", ind);
+        break;
+    case DRES:
+        sprintf(buf, bRevKind ? "gr[%d]" : "jc[%d]", ind);
+        break;
+    case DTMP:
+        sprintf(buf, "dt%d", ind);
+        break;
+    case DARG:
+        sprintf(buf, "ga[%d]", ind);
+        break;
+    default:
+        sprintf(buf, "0.0");
+        break;
+    }
+    return buf;
+}
+
+/* ========================================================================== */
+
+void cIndent(FILE *cFile, int level) {
+    int i;
+
+    for (i = 0; i <= level; i++) {
+        fputs("    ", cFile);
+    }
+}
+
+/* ========================================================================== */
+
+/* condition of a requested column of kind 1 or 3, as in prx_wanted */
+static void cWanted(FILE *cFile, int kod, const char *j) {
+    static const char *flg[] = {"", "xf", "", "pf"};
+
+    fprintf(cFile, "(dat->%s == NULL || %s >= VECN(dat->%s) || ", flg[kod], j,
+            flg[kod]);
+    fprintf(cFile, "VEC(dat->%s, %s))", flg[kod], j);
+}
+
+/* open the block of a derivative column */
+void cColumn(FILE *cFile, int kod, int iDvt, int level) {
+    static const char *jac[] = {"", "jx", "ja", "jp"};
+    char j[16];
+
+    cIndent(cFile, level);
+    if (bRevKind) {
+        fputs("{\n", cFile);
+        return;
+    }
+    sprintf(j, "%d", iDvt);
+    fputs("if (", cFile);
+    if (kod == 1 || kod == 3) {
+        cWanted(cFile, kod, j);
+        fputs(" && ", cFile);
+    }
+    fprintf(cFile, "dat->%s != NULL && %d < MATN(dat->%s)) {\n", jac[kod],
+            iDvt, jac[kod]);
+    cIndent(cFile, level + 1);
+    fprintf(cFile, "jc = MATP(dat->%s, 0, %d);\n", jac[kod], iDvt);
+}
+
+/* store the adjoints of the inputs of a reverse row in the Jacobian */
+void cRow(FILE *cFile, int kod, int iDvt, int nIn, int level) {
+    static const char *jac[] = {"", "jx", "ja", "jp"};
+
+    cIndent(cFile, level);
+    fprintf(cFile, "if (dat->%s != NULL && %d < MATM(dat->%s)) {\n", jac[kod],
+            iDvt, jac[kod]);
+    cIndent(cFile, level + 1);
+    fprintf(cFile, "for (k = 0; k < %d && k < MATN(dat->%s); k++) {\n", nIn,
+            jac[kod]);
+    cIndent(cFile, level + 2);
+    if (kod == 1 || kod == 3) {
+        fputs("if (", cFile);
+        cWanted(cFile, kod, "k");
+        fputs(") {\n", cFile);
+    } else {
+        fputs("{\n", cFile);
+    }
+    cIndent(cFile, level + 3);
+    fprintf(cFile, "MAT(dat->%s, %d, k) = ga[k];\n", jac[kod], iDvt);
+    cIndent(cFile, level + 2);
+    fputs("}\n", cFile);
+    cIndent(cFile, level + 1);
+    fputs("}\n", cFile);
+    cIndent(cFile, level);
+    fputs("}\n", cFile);
+}
+
+/* ========================================================================== */
+
+/*
+ * Translation of the intermediate code into a C model procedure with the
+ * parxmodel signature. The plugin entry exports the hash of the model
+ * source. return value: 0 - error 1 - success
+ */
+int prx_genC(FILE *codeFile, FILE *cFile, char *model, int nRes, int nVar,
+             int nAux, int nPar, int nCon, int nFlag,
+             unsigned long long hash) {
+    char *cName;
+    char Buf[sizeof(FILEID)];
+    double *Nums;
+    long start;
+    int nNum, nTmp, nStack;
+    int i, l, d, dMax;
+    int kod, iDvt, level, bCol, bRev, nIn;
+    TYP typ;
+    int ind;
+    OPR opr;
+    CODEWORD sh;
+
+    /* C identifier of the model */
+
+    Nums = NULL;
+    cName = (char *)malloc(strlen(model) + 5);
+    if (cName == NULL) {
+        printf("C code: out of memory\n");
+        return 0;
+    }
+    strcpy(cName, "mod_");
+    for (i = 0, l = 4; model[i] != '\0'; i++) {
+        cName[l++] = isalnum((unsigned char)model[i]) ? model[i] : '_';
+    }
+    cName[l] = '\0';
+
+    /* header of the code file */
+
+    READSH(nNum);
+    READSH(nTmp);
+    READSH(nStack);
+    READSH(l);
+    if (l != (int)sizeof(Buf) || fread(Buf, l, 1, codeFile) != 1 ||
+        strcmp(Buf, FILEID) != 0) {
+        printf("C code: not a code file\n");
+        goto failed;
+    }
+    READSH(i);
+    if (i != CODE_VERSION) {
+        printf("C code: wrong code version\n");
+        goto failed;
+    }
+    start = ftell(codeFile);
+
+    /* 1st pass - stack depth and numerical constants */
+
+    d = dMax = 0;
+    bRev = 0;
+    for (;;) {
+        READSH(opr);
+        if (opr >= STOP) {
+            break;
+        }
+        if (opr == SOR) {
+            bRev = 1;
+        }
+        switch (opr) {
+        case OPD:
+        case ASS:
+        case NASS:
+        case CLR:
+            READSH(typ);
+            READSH(ind);
+            break;
+        case NUM:
+            READSH(ind);
+            break;
+        default:
+            break;
+        }
+        d = (opr == RET) ? 0 : d + prx_stack(opr);
+        if (d > dMax) {
+            dMax = d;
+        }
+        if (d < 0) {
+            printf("C code: operand stack underflow\n");
+            goto failed;
+        }
+    }
+    if (dMax > nStack) {
+        printf("C code: operand stack exceeds the declared depth\n");
+        goto failed;
+    }
+    Nums = (double *)malloc((nNum + 1) * sizeof(double));
+    if (Nums == NULL ||
+        fread((char *)Nums, sizeof(double), nNum, codeFile) != (size_t)nNum) {
+        printf("C code: constants missing\n");
+        goto failed;
+    }
+
+    /* procedure header */
+
+    fprintf(cFile, "/*\n * %s - generated by ParX Code Generator\n", model);
+    fprintf(cFile, " * from '%s'\n *\n", prx_filename);
+    fprintf(cFile, " * Add to the model library table in parxmods.c as:\n");
+    fprintf(cFile, " * {\"%s\", %s}\n */\n\n", model, cName);
+    fputs("#include \"error.h\"\n#include \"modlib.h\"\n#include "
+          "\"parx.h\"\n\n",
+          cFile);
+    fprintf(cFile, "static boolean %s_eval(moddat dat) {\n", cName);
+    fputs("    fnum *x = VECA(dat->x);\n", cFile);
+    fputs("    fnum *a = VECA(dat->a);\n", cFile);
+    fputs("    fnum *p = VECA(dat->p);\n", cFile);
+    fputs("    fnum *c = VECA(dat->c);\n", cFile);
+    fputs("    fnum *f = VECA(dat->f);\n", cFile);
+    fputs("    fnum *r = VECA(dat->r);\n", cFile);
+    fputs("    fnum *jc = NULL;\n", cFile);
+    for (i = 0; i < dMax; i++) {
+        fprintf(cFile, "    fnum s%d;\n", i);
+    }
+    for (i = 0; i < nTmp; i++) {
+        fprintf(cFile, "    fnum t%d = 0.0, dt%d = 0.0;\n", i, i);
+    }
+    if (bRev) { /* adjoints of inputs and residuals */
+        nIn = (nVar > nAux) ? nVar : nAux;
+        nIn = (nPar > nIn) ? nPar : nIn;
+        fprintf(cFile, "    fnum ga[%d], gr[%d];\n", nIn + 1, nRes);
+        fputs("    int k;\n", cFile);
+    }
+    fputs("\n    (void)x, (void)a, (void)p, (void)c, (void)f, (void)jc;\n",
+          cFile);
+
+    /* 2nd pass - straight-line code */
+
+    fseek(codeFile, start, SEEK_SET);
+    d = 0;
+    kod = iDvt = level = 0;
+    bCol = 0;
+    bRevKind = 0;
+    fputs("\n    /* model function */\n", cFile);
+    for (;;) {
+        READSH(opr);
+        if (opr >= STOP) {
+            break;
+        }
+        typ = VAR;
+        ind = 0;
+        switch (opr) {
+        case OPD:
+        case ASS:
+        case NASS:
+        case CLR:
+            READSH(typ);
+            READSH(ind);
+            break;
+        case NUM:
+            READSH(ind);
+            break;
+        default:
+            break;
+        }
+
+        if (opr == SOK || opr == SOR) {
+            if (kod == 0) {
+                fputs("\n    /* derivatives to externals and auxiliaries */\n",
+                      cFile);
+                fputs("    if (dat->jxf) {\n", cFile);
+                level++;
+            } else if (kod == 2) {
+                fputs("    }\n\n    /* derivatives to parameters */\n", cFile);
+                fputs("    if (dat->jpf) {\n", cFile);
+            }
+            kod++;
+            iDvt = 0;
+            bRevKind = (opr == SOR);
+            continue;
+        }
+        if (opr == EOD) {
+            if (bRevKind) {
+                if (!bCol) {
+                    cColumn(cFile, kod, iDvt, level);
+                    level++;
+                    bCol = 1;
+                }
+                nIn = (kod == 1) ? nVar : (kod == 2) ? nAux : nPar;
+                cRow(cFile, kod, iDvt, nIn, level);
+            }
+            if (bCol) {
+                cIndent(cFile, level - 1);
+                fputs("}\n", cFile);
+                level--;
+                bCol = 0;
+            }
+            iDvt++;
+            continue;
+        }
+        if (kod > 0 && !bCol) {
+            cColumn(cFile, kod, iDvt, level);
+            level++;
+            bCol = 1;
+        }
+
+        cIndent(cFile, (opr == ELSE || opr == FI) ? level - 1 : level);
+        switch (opr) {
+        case AND:
+            fprintf(cFile, "s%d = (s%d != 0 && s%d != 0);\n", d - 2, d - 2,
+                    d - 1);
+            break;
+        case OR:
+            fprintf(cFile, "s%d = (s%d != 0 || s%d != 0);\n", d - 2, d - 2,
+                    d - 1);
+            break;
+        case LT:
+            fprintf(cFile, "s%d = (s%d < s%d);\n", d - 2, d - 2, d - 1);
+            break;
+        case GT:
+            fprintf(cFile, "s%d = (s%d > s%d);\n", d - 2, d - 2, d - 1);
+            break;
+        case LE:
+            fprintf(cFile, "s%d = (s%d <= s%d);\n", d - 2, d - 2, d - 1);
+            break;
+        case GE:
+            fprintf(cFile, "s%d = (s%d >= s%d);\n", d - 2, d - 2, d - 1);
+            break;
+        case EQ:
+            fprintf(cFile, "s%d = (s%d == s%d);\n", d - 2, d - 2, d - 1);
+            break;
+        case NE:
+            fprintf(cFile, "s%d = (s%d != s%d);\n", d - 2, d - 2, d - 1);
+            break;
+        case ADD:
+            fprintf(cFile, "s%d += s%d;\n", d - 2, d - 1);
+            break;
+        case SUB:
+            fprintf(cFile, "s%d -= s%d;\n", d - 2, d - 1);
+            break;
+        case MUL:
+            fprintf(cFile, "s%d *= s%d;\n", d - 2, d - 1);
+            break;
+        case DIV:
+            fprintf(cFile, "s%d /= s%d;\n", d - 2, d - 1);
+            break;
+        case POW:
+            fprintf(cFile, "s%d = pow(s%d, s%d);\n", d - 2, d - 2, d - 1);
+            break;
+        case NOT:
+            fprintf(cFile, "s%d = (s%d == 0);\n", d - 1, d - 1);
+            break;
+        case SGN:
+            fprintf(cFile, "s%d = (s%d >= 0) ? 1.0 : -1.0;\n", d - 1, d - 1);
+            break;
+        case SIN:
+            fprintf(cFile, "s%d = sin(s%d);\n", d - 1, d - 1);
+            break;
+        case COS:
+            fprintf(cFile, "s%d = cos(s%d);\n", d - 1, d - 1);
+            break;
+        case TAN:
+            fprintf(cFile, "s%d = tan(s%d);\n", d - 1, d - 1);
+            break;
+        case ASIN:
+            fprintf(cFile, "s%d = asin(s%d);\n", d - 1, d - 1);
+            break;
+        case ACOS:
+            fprintf(cFile, "s%d = acos(s%d);\n", d - 1, d - 1);
+            break;
+        case ATAN:
+            fprintf(cFile, "s%d = atan(s%d);\n", d - 1, d - 1);
+            break;
+        case EXP:
+            fprintf(cFile, "s%d = exp(s%d);\n", d - 1, d - 1);
+            break;
+        case LOG:
+            fprintf(cFile, "s%d = log(s%d);\n", d - 1, d - 1);
+            break;
+        case LG:
+            fprintf(cFile, "s%d = log10(s%d);\n", d - 1, d - 1);
+            break;
+        case SQRT:
+            fprintf(cFile, "s%d = sqrt(s%d);\n", d - 1, d - 1);
+            break;
+        case SQR:
+            fprintf(cFile, "s%d *= s%d;\n", d - 1, d - 1);
+            break;
+        case NEG:
+            fprintf(cFile, "s%d = -s%d;\n", d - 1, d - 1);
+            break;
+        case REV:
+            fprintf(cFile, "s%d = 1.0 / s%d;\n", d - 1, d - 1);
+            break;
+        case INC:
+            fprintf(cFile, "s%d += 1.0;\n", d - 1);
+            break;
+        case DEC:
+            fprintf(cFile, "s%d -= 1.0;\n", d - 1);
+            break;
+        case ABS:
+            fprintf(cFile, "s%d = fabs(s%d);\n", d - 1, d - 1);
+            break;
+        case RET:
+            fprintf(cFile, "return (s%d != 0) ? FALSE : TRUE;\n", d - 1);
+            break;
+        case CHKL:
+            fprintf(cFile, "if (s%d < s%d) return FALSE;\n", d - 2, d - 1);
+            break;
+        case CHKG:
+            fprintf(cFile, "if (s%d > s%d) return FALSE;\n", d - 2, d - 1);
+            break;
+        case OPD:
+            fprintf(cFile, "s%d = %s;\n", d, cOperand(typ, ind));
+            break;
+        case NUM:
+            if (ind < 0 || ind >= nNum) {
+                printf("C code: illegal constant\n");
+                goto failed;
+            }
+            fprintf(cFile, "s%d = %.17e;\n", d, Nums[ind]);
+            break;
+        case ASS:
+            fprintf(cFile, "%s = s%d;\n", cOperand(typ, ind), d - 1);
+            break;
+        case NASS:
+            fprintf(cFile, "%s = -s%d;\n", cOperand(typ, ind), d - 1);
+            break;
+        case CLR:
+            fprintf(cFile, "%s = 0.0;\n", cOperand(typ, ind));
+            break;
+        case IF:
+            fprintf(cFile, "if (s%d != 0) {\n", d - 1);
+            level++;
+            break;
+        case ELSE:
+            fputs("} else {\n", cFile);
+            break;
+        case FI:
+            fputs("}\n", cFile);
+            level--;
+            break;
+        default:
+            printf("C code: illegal operator %d\n", (int)opr);
+            goto failed;
+        }
+        d = (opr == RET) ? 0 : d + prx_stack(opr);
+    }
+    if (kod > 0) {
+        fputs("    }\n", cFile);
+    }
+    fputs("\n    return TRUE;\n}\n\n", cFile);
+
+    /* model library entry */
+
+    fprintf(cFile, "boolean %s(modreq req, modres res) {\n", cName);
+    fprintf(cFile, "    if (req->nx != %d || req->np != %d) {\n", nVar, nPar);
+    fputs("        return FALSE;\n    }\n", cFile);
+    fprintf(cFile, "    res->nr = %d;\n", nRes);
+    fprintf(cFile, "    res->nx = %d;\n", nVar);
+    fprintf(cFile, "    res->na = %d;\n", nAux);
+    fprintf(cFile, "    res->np = %d;\n", nPar);
+    fprintf(cFile, "    res->nc = %d;\n", nCon);
+    fprintf(cFile, "    res->nf = %d;\n", nFlag);
+    fputs("    res->xstat = rdup_statevector(req->xstat);\n", cFile);
+    fputs("    res->pstat = rdup_statevector(req->pstat);\n", cFile);
+    fprintf(cFile, "    res->model = (procedure)%s_eval;\n", cName);
+    fputs("    return TRUE;\n}\n", cFile);
+
+    /* plugin entry, when built as a shared object with -DPARX_PLUGIN */
+
+    fputs("\n#ifdef PARX_PLUGIN\n", cFile);
+    fputs("const ModelPlugin parx_model_plugin_1[] = {\n", cFile);
+    fprintf(cFile, "    {MODEL_PLUGIN_VERSION, \"%s\", %s},\n", model, cName);
+    fputs("    {0, NULL, parxmodelNIL}};\n", cFile);
+    fprintf(cFile,
+            "const unsigned long long parx_model_hash_1 = 0x%016llxULL;\n",
+            hash);
+    fputs("#endif\n", cFile);
+
+    if (ferror(cFile)) {
+        printf("C code: error writing output file\n");
+        goto failed;
+    }
+    free(Nums);
+    free(cName);
+    return 1;
+
+failed:
+    free(Nums);
+    free(cName);
+    return 0;
+}
@@ -25,98 +25,364 @@
 #include "prxinter.h"
 
 #define BUFSIZE 1024
-#define STACKSIZE 64
 
 #define READITEM                                                               \
     if ((nItems = (int)fread((char *)&sh, sizeof(sh), 1, file)) == 0) {        \
         errcode = NPX_IERR;                                                    \
-        return FALSE;                                                          \
+        goto failed;                                                           \
     }
 
-static fnum *prx_getAddress(TYP, int, moddat);
-
-/*************************** global variables ***************************/
-static CODE *kindStart[4]; /* Start pointer for kinds of deriv.s [0]:
+/* loaded interpreter code, read only after prx_loadCode */
+struct PRX_PROG_S {
+    struct MEM_TREE *tree; /* memory tree of the program */
+    long serial;           /* unique load number */
+    CODE *kindStart[4];    /* Start pointer for kinds of deriv.s [0]:
                             * function code [1]: variables derivatives
                             * [2]: auxiliaries derivatives [3]:
                             * parameters derivatives     */
+    int nNum;              /* number of numerical constants */
+    int nTmp;              /* number of temporaries */
+    int nReg;              /* number of registers (verified stack depth) */
+    fnum *Num;             /* pointer to numerical constants */
+    CODE **colStart[4];    /* start of each derivative column per kind,
+                            * [nCol] is the end of the kind */
+    int nCol[4];           /* number of derivative columns per kind */
+    boolean bRev[4];       /* kind is in reverse mode, a column is a row */
+    int nArg;              /* adjoints of inputs (DARG) */
+    int nAdj;              /* adjoints of inputs and residuals */
+};
+
+/* execution context, private to one thread */
+struct PRX_CTX_S {
+    struct MEM_TREE *tree; /* memory tree of the context */
+    PRX_PROG *prog;        /* program executed in this context */
+    long serial;           /* load number of the program */
+    moddat dat;            /* bound model interface structure */
+    fnum *Reg;             /* registers */
+    fnum *Tmp;             /* temporaries */
+    fnum *DTmp;            /* deriv. of temporaries */
+    fnum *Adj;             /* adjoints of a reverse row */
+    inum errcode;          /* model return code of last execution */
+    inum fault;            /* interpreter error, reported on release */
+};
+
+/*************************** global variables ***************************/
+static PRX_PROG *curProg = NULL; /* current model program */
+static long nLoads = 0;          /* number of programs loaded */
+
+static THREAD_LOCAL PRX_CTX *thrCtx = NULL; /* context of this thread */
+
+/************************** register code *******************************/
+
+/*
+ * The stack code of the model file is translated into register code while
+ * loading. Stack position i becomes register i: the stack depth at every
+ * instruction is fixed, so it is verified here once and the interpreter
+ * runs without stack checks. An instruction is an opcode followed by its
+ * destination and operand slots, where a slot addresses the moddat, a
+ * register (REG) or a numerical constant (KON).
+ * Operand pushes are deferred and become operands of the instruction that
+ * consumes them; an assignment becomes the destination of the instruction
+ * that computed the value. The last instruction is held back, to fuse it
+ * with the next one into a*b+c (MADD), a*b-c (MSUB), c-a*b (NMADD),
+ * exp(a*b) (EXPM) or exp(a/b) (EXPD).
+ */
 
-static fnum *Stack;     /* operand stack */
-static fnum *Stack_end; /* pointer to end of stack */
+typedef struct {
+    OPR o;     /* operation */
+    int n;     /* number of slots */
+    SLOT s[4]; /* destination and operands */
+} PRX_INSTR;
 
-static int nNum;   /* number of numerical constants */
-static int nTmp;   /* number of temporaries */
-static int iDvt;   /* index of current deriv. variable */
-static fnum *Tmp;  /* pointer to temporaries */
-static fnum *DTmp; /* pointer to deriv. of temporaries */
-static fnum *Num;  /* pointer to numerical constants */
-static matrix jac; /* basic pointer for current Jacobian */
+/* state of the translation */
+typedef struct {
+    struct MEM_TREE *tree; /* memory tree of the program */
+    CODE *code;            /* next code position */
+    int nFree;             /* free positions in current code buffer */
+    SLOT *St;              /* stack: register or deferred operand */
+    int szSt;              /* stack size, from the code file */
+    int sp;                /* stack depth */
+    int nReg;              /* maximum stack depth */
+    PRX_INSTR last;        /* last instruction, not yet written */
+    boolean bLast;
+    CODE **mark;           /* column starts, all kinds in sequence */
+    int nMark;             /* number of column starts */
+    int szMark;            /* allocated size of mark */
+} PRX_LOAD;
 
-static struct MEM_TREE *Tree = NULL; /* memory tree */
+static SLOT noSlot = {0, 0};
 
-inum prx_errcode;
+static SLOT prx_reg(int i) {
+    SLOT s;
+
+    s.typ = REG;
+    s.ind = i;
+    return s;
+}
+
+static boolean prx_same(SLOT a, SLOT b) {
+    return (a.typ == b.typ && a.ind == b.ind) ? TRUE : FALSE;
+}
+
+/* reserve n code positions, keeping room for a buffer link */
+static CODE *prx_room(PRX_LOAD *ld, int n) {
+    CODE *code;
+
+    if (ld->nFree < n + 2) { /* add new code buffer */
+        (*ld->code++).o = JMP;
+        (*ld->code).c = (CODE *)mem_slot(ld->tree, BUFSIZE * sizeof(CODE));
+        ld->code = (*ld->code).c;
+        ld->nFree = BUFSIZE;
+    }
+    code = ld->code;
+    ld->code += n;
+    ld->nFree -= n;
+    return code;
+}
+
+static void prx_write(PRX_LOAD *ld, PRX_INSTR *in) {
+    CODE *code;
+    int i;
+
+    code = prx_room(ld, in->n + 1);
+    (*code++).o = in->o;
+    for (i = 0; i < in->n; i++) {
+        (*code++).s = in->s[i];
+    }
+}
+
+/* write the last instruction */
+static void prx_flush(PRX_LOAD *ld) {
+    if (ld->bLast) {
+        prx_write(ld, &ld->last);
+        ld->bLast = FALSE;
+    }
+}
+
+/* hold back a new instruction */
+static void prx_instr(PRX_LOAD *ld, OPR o, int n, SLOT d, SLOT a, SLOT b) {
+    prx_flush(ld);
+    ld->last.o = o;
+    ld->last.n = n;
+    ld->last.s[0] = d;
+    ld->last.s[1] = a;
+    ld->last.s[2] = b;
+    ld->bLast = TRUE;
+}
+
+/* is register r the destination of the last instruction (of kind o) */
+static boolean prx_lastIs(PRX_LOAD *ld, OPR o, SLOT r) {
+    if (!ld->bLast || r.typ != REG || !prx_same(ld->last.s[0], r)) {
+        return FALSE;
+    }
+    switch (ld->last.o) {
+    case RET:
+    case CHKL:
+    case CHKG:
+        return FALSE;
+    default:
+        return (o == INVAL || o == ld->last.o) ? TRUE : FALSE;
+    }
+}
+
+/*
+ * Load deferred operands into their registers: all of them, or only those
+ * reading slot t, which is about to be written. The loads go ahead of the
+ * last instruction, which only uses registers above them.
+ */
+static void prx_load(PRX_LOAD *ld, SLOT *t) {
+    PRX_INSTR in;
+    int i;
 
-/* Input and adaptation of interpreter code (once per PARX execution) */
-boolean prx_inCode(moddat dat, FILE *inFile) {
+    for (i = 0; i < ld->sp; i++) {
+        if (ld->St[i].typ != REG &&
+            (t == NULL || prx_same(ld->St[i], *t))) {
+            in.o = MOV;
+            in.n = 2;
+            in.s[0] = prx_reg(i);
+            in.s[1] = ld->St[i];
+            prx_write(ld, &in);
+            ld->St[i] = in.s[0];
+        }
+    }
+}
+
+static boolean prx_push(PRX_LOAD *ld, SLOT s) {
+    if (ld->sp >= ld->szSt) {
+        errcode = STK_IERR;
+        return FALSE;
+    }
+    ld->St[ld->sp++] = s;
+    if (ld->sp > ld->nReg) {
+        ld->nReg = ld->sp;
+    }
+    return TRUE;
+}
+
+static void prx_unary(PRX_LOAD *ld, OPR o) {
+    SLOT a, d;
+
+    a = ld->St[ld->sp - 1];
+    d = prx_reg(ld->sp - 1);
+    if (o == EXP && prx_lastIs(ld, MUL, a)) {
+        ld->last.o = EXPM;
+    } else if (o == EXP && prx_lastIs(ld, DIV, a)) {
+        ld->last.o = EXPD;
+    } else {
+        prx_instr(ld, o, 2, d, a, noSlot);
+    }
+    ld->St[ld->sp - 1] = d;
+}
+
+/* fuse the last multiplication with an addition of c */
+static void prx_fuse(PRX_LOAD *ld, OPR o, SLOT d, SLOT c) {
+    ld->last.o = o;
+    ld->last.n = 4;
+    ld->last.s[0] = d;
+    ld->last.s[3] = c;
+}
+
+static void prx_binary(PRX_LOAD *ld, OPR o) {
+    SLOT a, b, d;
+
+    a = ld->St[ld->sp - 2];
+    b = ld->St[ld->sp - 1];
+    d = prx_reg(ld->sp - 2);
+    ld->sp--;
+    if (o == ADD && prx_lastIs(ld, MUL, b)) {
+        prx_fuse(ld, MADD, d, a);
+    } else if (o == ADD && prx_lastIs(ld, MUL, a)) {
+        prx_fuse(ld, MADD, d, b);
+    } else if (o == SUB && prx_lastIs(ld, MUL, a)) {
+        prx_fuse(ld, MSUB, d, b);
+    } else if (o == SUB && prx_lastIs(ld, MUL, b)) {
+        prx_fuse(ld, NMADD, d, a);
+    } else if (o == MUL && prx_same(a, b)) {
+        prx_instr(ld, SQR, 2, d, a, noSlot);
+    } else {
+        prx_instr(ld, o, 3, d, a, b);
+    }
+    ld->St[ld->sp - 1] = d;
+}
+
+/* record the next code position as the start of a derivative column */
+static boolean prx_mark(PRX_LOAD *ld) {
+    CODE **mark;
+
+    if (ld->nMark >= ld->szMark) {
+        mark = (CODE **)realloc(ld->mark,
+                                (2 * ld->szMark + 16) * sizeof(CODE *));
+        if (mark == NULL) {
+            errcode = MEM_IERR;
+            return FALSE;
+        }
+        ld->mark = mark;
+        ld->szMark = 2 * ld->szMark + 16;
+    }
+    ld->mark[ld->nMark++] = ld->code;
+    return TRUE;
+}
+
+/* assignment (ASS, NASS) of the top of stack or clear (CLR) of slot t */
+static void prx_store(PRX_LOAD *ld, OPR o, SLOT t) {
+    SLOT x;
+
+    x = (o == CLR) ? noSlot : ld->St[--ld->sp];
+    prx_load(ld, &t);
+    if (o == CLR) {
+        prx_instr(ld, CLR, 1, t, noSlot, noSlot);
+    } else if (o == ASS && prx_lastIs(ld, INVAL, x)) {
+        ld->last.s[0] = t;
+    } else {
+        prx_instr(ld, (o == ASS) ? MOV : NEG, 2, t, x, noSlot);
+    }
+}
+
+/* Input of interpreter code into a shareable program */
+PRX_PROG *prx_loadCode(FILE *inFile) {
     FILE *file;
-    OPR opr;    /* current operator */
-    TYP typ;    /* type of variable */
-    int ind;    /* array index */
-    int kod;    /* kind of derivatives (var, aux or par) */
-    CODE *code; /* pointer in interpreter code */
-    int nFree;  /* available positions in current code buffer */
+    PRX_PROG *prog;
+    struct MEM_TREE *Tree; /* memory tree */
+    PRX_LOAD ld;           /* translation state */
+    OPR opr;               /* current operator */
+    SLOT slot;             /* operand */
+    int kod;               /* kind of derivatives (var, aux or par) */
+    CODE *code;            /* pointer in interpreter code */
     CODE *IfPos[MAXLEVEL + 1] = {NULL};
     CODE *ElsePos[MAXLEVEL + 1] = {NULL};
+    int IfSp[MAXLEVEL + 1];
+    int first[4]; /* first column start of each kind */
     int level;
     size_t nItems;
     int i;
-    char Buf[MAXLINE + 2];
-    short sh;
-
-    iDvt = 0; /* index of current deriv. variable */
+    char Buf[sizeof(FILEID)];
+    CODEWORD sh;
 
-    if (Tree)
-        mem_free(Tree);
     Tree = mem_tree();
+    prog = (PRX_PROG *)mem_slot(Tree, sizeof(PRX_PROG));
+    prog->tree = Tree;
+    prog->serial = ++nLoads;
+    for (i = 0; i < 4; i++) {
+        prog->kindStart[i] = NULL;
+        prog->colStart[i] = NULL;
+        prog->nCol[i] = 0;
+        prog->bRev[i] = FALSE;
+    }
+    prog->nArg = prog->nAdj = 0;
+    ld.mark = NULL;
+    ld.nMark = ld.szMark = 0;
+    ld.St = NULL;
+    ld.szSt = 0;
+
     file = inFile;
     level = 0;
     READITEM;
-    nNum = sh;
+    prog->nNum = sh;
     READITEM;
-    nTmp = sh;
+    prog->nTmp = sh;
+    READITEM;
+    ld.szSt = sh;
     READITEM;
     i = sh;
     if (i != strlen(FILEID) + 1) {
         errcode = NPX_IERR;
-        return FALSE;
+        goto failed;
     }
     nItems = fread(Buf, i, 1, file);
     if (strcmp(Buf, FILEID) != 0) {
         errcode = NPX_IERR;
-        return FALSE;
+        goto failed;
     }
     READITEM;
     i = sh;
     if (i != CODE_VERSION) {
         errcode = VER_IERR;
-        return FALSE;
+        goto failed;
     }
-    if (nNum < 0 || nTmp < 0) {
+    if (prog->nNum < 0 || prog->nTmp < 0) {
         errcode = CON_IERR;
-        return FALSE;
+        goto failed;
+    }
+    if (ld.szSt < 0) {
+        errcode = STK_IERR;
+        goto failed;
     }
-    if (nTmp) {
-        Tmp = (fnum *)mem_slot(Tree, nTmp * sizeof(fnum));
-        DTmp = (fnum *)mem_slot(Tree, nTmp * sizeof(fnum));
+    ld.St = (SLOT *)malloc((ld.szSt + 1) * sizeof(SLOT));
+    if (ld.St == NULL) {
+        errcode = MEM_IERR;
+        goto failed;
     }
-    Num = (fnum *)mem_slot(Tree, nNum * sizeof(fnum));
+    prog->Num = (fnum *)mem_slot(Tree, prog->nNum * sizeof(fnum));
 
     /* get 1st code buffer */
-    code = (CODE *)mem_slot(Tree, BUFSIZE * sizeof(CODE));
-    kindStart[0] = code;
-    nFree = BUFSIZE - 4;
+    ld.tree = Tree;
+    ld.code = (CODE *)mem_slot(Tree, BUFSIZE * sizeof(CODE));
+    ld.nFree = BUFSIZE;
+    ld.sp = 0;
+    ld.nReg = 0;
+    ld.bLast = FALSE;
+    prog->kindStart[0] = ld.code;
     kod = 0;
-    jac = NULL;
     opr = INVAL;
 
     READITEM;
@@ -125,88 +391,187 @@ boolean prx_inCode(moddat dat, FILE *inFile) {
         if (opr >= STOP) {
             break;
         }
-        if (nFree <= 0) { /* add new code buffer */
-            (*code++).o = JMP;
-            (*code).c = (CODE *)mem_slot(Tree, BUFSIZE * sizeof(CODE));
-            code = (*code).c;
-            nFree = BUFSIZE - 3;
-        }
         switch (opr) {
         default:
-            (*code++).o = opr;
-            nFree--;
+            errcode = COD_IERR;
+            goto failed;
+        case NOT:
+        case NEG:
+        case REV:
+        case SQR:
+        case INC:
+        case DEC:
+        case SIN:
+        case COS:
+        case TAN:
+        case ASIN:
+        case ACOS:
+        case ATAN:
+        case EXP:
+        case LOG:
+        case LG:
+        case SQRT:
+        case ABS:
+        case SGN:
+            if (ld.sp < 1) {
+                errcode = STK_IERR;
+                goto failed;
+            }
+            prx_unary(&ld, opr);
             break;
-        case OPD:
-            READITEM;
-            typ = (TYP)sh;
-            READITEM;
-            ind = sh;
-            (*code++).o = (typ != DRES) ? OPD : DOPD;
-            if (typ == FLG) {
-                (*(code - 1)).o = LDF;
+        case AND:
+        case OR:
+        case LT:
+        case GT:
+        case LE:
+        case GE:
+        case EQ:
+        case NE:
+        case ADD:
+        case SUB:
+        case MUL:
+        case DIV:
+        case POW:
+            if (ld.sp < 2) {
+                errcode = STK_IERR;
+                goto failed;
             }
-            (*code++).f = prx_getAddress(typ, ind, dat);
-            nFree -= 2;
+            prx_binary(&ld, opr);
             break;
-        case NUM:
-            READITEM;
-            ind = sh;
-            (*code++).o = opr;
-            (*code++).f = (Num + ind);
-            nFree -= 2;
+        case RET:
+            if (ld.sp < 1) {
+                errcode = STK_IERR;
+                goto failed;
+            }
+            ld.sp--;
+            prx_instr(&ld, RET, 1, ld.St[ld.sp], noSlot, noSlot);
+            break;
+        case CHKL:
+        case CHKG:
+            if (ld.sp < 2) {
+                errcode = STK_IERR;
+                goto failed;
+            }
+            ld.sp -= 2;
+            prx_instr(&ld, opr, 2, ld.St[ld.sp], ld.St[ld.sp + 1], noSlot);
             break;
+        case OPD:
         case ASS:
         case NASS:
+        case CLR:
             READITEM;
-            typ = (TYP)sh;
+            slot.typ = sh;
             READITEM;
-            ind = sh;
-            (*code++).o = opr;
-            (*code++).f = prx_getAddress(typ, ind, dat);
-            nFree -= 2;
+            slot.ind = sh;
+            if (slot.typ < VAR || slot.typ > DARG || slot.ind < 0 ||
+                ((slot.typ == TMP || slot.typ == DTMP) &&
+                 slot.ind >= prog->nTmp) ||
+                (slot.typ == DARG && !prog->bRev[kod])) {
+                errcode = COD_IERR;
+                goto failed;
+            }
+            if (slot.typ == DARG && slot.ind >= prog->nArg) {
+                prog->nArg = slot.ind + 1;
+            } else if (slot.typ == DRES && prog->bRev[kod] &&
+                       slot.ind >= prog->nAdj) {
+                prog->nAdj = slot.ind + 1; /* adjoints of residuals */
+            }
+            if (opr == OPD && slot.typ == FLG) {
+                if (!prx_push(&ld, prx_reg(ld.sp))) {
+                    goto failed;
+                }
+                prx_instr(&ld, LDF, 2, ld.St[ld.sp - 1], slot, noSlot);
+            } else if (opr == OPD) {
+                if (!prx_push(&ld, slot)) {
+                    goto failed;
+                }
+            } else {
+                if (opr != CLR && ld.sp < 1) {
+                    errcode = STK_IERR;
+                    goto failed;
+                }
+                prx_store(&ld, opr, slot);
+            }
             break;
-        case CLR:
-            READITEM;
-            typ = (TYP)sh;
+        case NUM:
             READITEM;
-            ind = sh;
-            (*code++).o = opr;
-            (*code++).f = prx_getAddress(typ, ind, dat);
-            nFree -= 2;
+            slot.typ = KON;
+            slot.ind = sh;
+            if (slot.ind < 0 || slot.ind >= prog->nNum) {
+                errcode = COD_IERR;
+                goto failed;
+            }
+            if (!prx_push(&ld, slot)) {
+                goto failed;
+            }
             break;
         case IF:
-            (*code++).o = IF;
-            IfPos[++level] = code++;
+            if (level >= MAXLEVEL || ld.sp < 1) {
+                errcode = COD_IERR;
+                goto failed;
+            }
+            slot = ld.St[--ld.sp];
+            prx_flush(&ld);
+            prx_load(&ld, NULL);
+            code = prx_room(&ld, 3);
+            code[0].o = IF;
+            code[1].s = slot;
+            IfPos[++level] = &code[2];
             ElsePos[level] = (CODE *)NULL;
-            nFree -= 2;
+            IfSp[level] = ld.sp;
             break;
         case ELSE:
-            (*code++).o = JMP;
-            ElsePos[level] = code++;
-            assert(IfPos[level] != NULL);
-            (*IfPos[level]).c = code;
-            nFree -= 2;
+            prx_flush(&ld);
+            prx_load(&ld, NULL);
+            if (level < 1 || ElsePos[level] || ld.sp != IfSp[level]) {
+                errcode = COD_IERR;
+                goto failed;
+            }
+            code = prx_room(&ld, 2);
+            code[0].o = JMP;
+            ElsePos[level] = &code[1];
+            (*IfPos[level]).c = ld.code;
             break;
         case FI:
+            prx_flush(&ld);
+            prx_load(&ld, NULL);
+            if (level < 1 || ld.sp != IfSp[level]) {
+                errcode = COD_IERR;
+                goto failed;
+            }
             if (ElsePos[level]) {
-                (*ElsePos[level]).c = code;
+                (*ElsePos[level]).c = ld.code;
             } else {
-                assert(IfPos[level] != NULL);
-                (*IfPos[level]).c = code;
+                (*IfPos[level]).c = ld.code;
             }
             level--;
             break;
         case EOD: /* End Of (single) Derivative */
-            (*code++).o = EOD;
-            iDvt++;
-            nFree--;
+            prx_flush(&ld);
+            if (kod == 0 || ld.sp != 0) {
+                errcode = COD_IERR;
+                goto failed;
+            }
+            (*prx_room(&ld, 1)).o = EOD;
+            if (!prx_mark(&ld)) {
+                goto failed;
+            }
             break;
         case SOK: /* Start Of Kind of derivatives */
-            kindStart[++kod] = code;
-            iDvt = 0;
-            jac = (kod == 1) ? dat->jx : (kod == 2) ? dat->ja : dat->jp;
-            (*code++).o = SOK;
-            nFree--;
+        case SOR: /* Start Of kind in Reverse mode */
+            prx_flush(&ld);
+            if (kod >= 3 || ld.sp != 0) {
+                errcode = COD_IERR;
+                goto failed;
+            }
+            code = prx_room(&ld, 1);
+            prog->kindStart[++kod] = code;
+            prog->bRev[kod] = (opr == SOR) ? TRUE : FALSE;
+            (*code).o = SOK;
+            first[kod] = ld.nMark;
+            if (!prx_mark(&ld)) {
+                goto failed;
+            }
             break;
         }
         READITEM;
@@ -214,286 +579,416 @@ boolean prx_inCode(moddat dat, FILE *inFile) {
 
     if (opr != STOP) {
         errcode = EOF_IERR;
-        return FALSE;
+        goto failed;
+    }
+    prx_flush(&ld);
+    if (ld.sp != 0 || level != 0 || kod != 3) {
+        errcode = COD_IERR;
+        goto failed;
+    }
+    (*prx_room(&ld, 1)).o = INVAL;
+    prog->nReg = ld.nReg;
+    prog->nAdj += prog->nArg; /* residual adjoints after the inputs */
+
+    /* column start table of each kind */
+    for (kod = 1; kod <= 3; kod++) {
+        prog->nCol[kod] = ((kod < 3) ? first[kod + 1] : ld.nMark) - first[kod];
+        prog->colStart[kod] =
+            (CODE **)mem_slot(Tree, prog->nCol[kod] * sizeof(CODE *));
+        for (i = 0; i < prog->nCol[kod]; i++) {
+            prog->colStart[kod][i] = ld.mark[first[kod] + i];
+        }
+        prog->nCol[kod]--;
     }
-    (*code).o = INVAL;
+    free(ld.mark);
+    free(ld.St);
 
     /* constants of model function */
-    if (!fread((char *)Num, sizeof(fnum), nNum, file)) {
+    if (!fread((char *)prog->Num, sizeof(fnum), prog->nNum, file)) {
         errcode = CON_IERR;
+        goto failed;
+    }
+
+    return prog;
+
+failed:
+    free(ld.mark);
+    free(ld.St);
+    mem_free(Tree);
+    return NULL;
+}
+
+void prx_freeCode(PRX_PROG *prog) {
+    if (prog != NULL) {
+        mem_free(prog->tree);
+    }
+}
+
+/* Creation of an execution context for a program */
+PRX_CTX *prx_newContext(PRX_PROG *prog) {
+    struct MEM_TREE *Tree;
+    PRX_CTX *ctx;
+
+    assert(prog != NULL);
+
+    Tree = mem_tree();
+    ctx = (PRX_CTX *)mem_slot(Tree, sizeof(PRX_CTX));
+    ctx->tree = Tree;
+    ctx->prog = prog;
+    ctx->serial = prog->serial;
+    ctx->dat = NULL;
+    ctx->Tmp = NULL;
+    ctx->DTmp = NULL;
+    if (prog->nTmp) {
+        ctx->Tmp = (fnum *)mem_slot(Tree, prog->nTmp * sizeof(fnum));
+        ctx->DTmp = (fnum *)mem_slot(Tree, prog->nTmp * sizeof(fnum));
+    }
+    ctx->Reg = (fnum *)mem_slot(Tree, (prog->nReg + 1) * sizeof(fnum));
+    ctx->Adj = (fnum *)mem_slot(Tree, (prog->nAdj + 1) * sizeof(fnum));
+    ctx->errcode = 0;
+    ctx->fault = 0;
+
+    return ctx;
+}
+
+void prx_freeContext(PRX_CTX *ctx) {
+    if (ctx != NULL) {
+        mem_free(ctx->tree);
+    }
+}
+
+/* Input of the current model program (once per numblock) */
+boolean prx_inCode(FILE *inFile) {
+    PRX_PROG *prog;
+
+    prog = prx_loadCode(inFile);
+    if (prog == NULL) {
         return FALSE;
     }
-    /* stack */
 
-    Stack = (fnum *)mem_slot(Tree, (STACKSIZE) * sizeof(fnum));
-    Stack_end = &(Stack[STACKSIZE - 1]);
+    /* contexts of the old program are renewed on their next use */
+    prx_freeCode(curProg);
+    curProg = prog;
 
     return TRUE;
 }
 
-fnum *prx_getAddress(TYP typ, int ind, moddat dat) {
-    fnum *adr;
-
-    switch (typ) {
-    case VAR:
-        adr = VECP(dat->x, ind);
-        break;
-    case AUX:
-        adr = VECP(dat->a, ind);
-        break;
-    case PAR:
-        adr = VECP(dat->p, ind);
-        break;
-    case CON:
-        adr = VECP(dat->c, ind);
-        break;
-    case FLG:
-        adr = VECP(dat->f, ind);
-        break;
-    case RES:
-        adr = VECP(dat->r, ind);
-        break;
-    case TMP:
-        adr = Tmp + ind;
-        break;
-    case DRES:
-        assert(jac != NULL);
-        adr = MATP(jac, ind, iDvt);
-        break;
-    case DTMP:
-        adr = DTmp + ind;
-        break;
-    default:
-        adr = 0;
-        break;
+/* Model procedure: current program, context of the calling thread */
+boolean prx_model(moddat dat) {
+    boolean rc;
+
+    assert(curProg != NULL);
+
+    if (thrCtx == NULL || thrCtx->serial != curProg->serial) {
+        prx_freeContext(thrCtx);
+        thrCtx = prx_newContext(curProg);
     }
-    return adr;
+    rc = prx_compute(thrCtx, dat);
+
+    return rc;
 }
 
-#define STCHECK(PST)                                                           \
-    {                                                                          \
-        if (PST >= Stack_end) {                                                \
-            errcode = STK_IERR;                                                \
-            error("Model interpreter");                                        \
-            return FALSE;                                                      \
-        }                                                                      \
+/* Report an interpreter error in the context of the calling thread */
+void prx_reportFault(void) {
+    if (thrCtx != NULL && thrCtx->fault != 0) {
+        errcode = thrCtx->fault;
+        thrCtx->fault = 0;
+        error("Model interpreter");
     }
+}
+
+/* Release the context of the calling thread */
+void prx_releaseContext(void) {
+    prx_reportFault();
+    prx_freeContext(thrCtx);
+    thrCtx = NULL;
+}
+
+/* address of an operand slot in the bound moddat */
+#define SLOTP(C) (base[(C).s.typ] + (C).s.ind)
 
-/* Execution of interpreter code */
-boolean prx_compute(moddat dat) {
-    int kod;    /* kind of derivatives */
-    CODE *code; /* interpreter code pointer */
-    fnum *pSt;  /* operand stack pointer */
+/* select Jacobian column of the current derivative */
+#define DCOLUMN                                                                \
+    base[DRES] = (jac != NULL && iDvt < MATN(jac)) ? MATP(jac, 0, iDvt) : NULL
 
-    prx_errcode = 0;
+/* first requested derivative column from iDvt on, nCol if none */
+static int prx_column(PRX_PROG *prog, moddat dat, int kod, int iDvt) {
+    boolvector flg;
 
-    code = kindStart[0];
-    pSt = Stack;
+    flg = (kod == 1) ? dat->xf : (kod == 3) ? dat->pf : NULL;
+    if (flg != NULL) {
+        while (iDvt < prog->nCol[kod] && iDvt < VECN(flg) &&
+               VEC(flg, iDvt) == FALSE) {
+            iDvt++;
+        }
+    }
+    return iDvt;
+}
+
+/* derivative column j of a kind is requested */
+static boolean prx_wanted(moddat dat, int kod, int j) {
+    boolvector flg;
+
+    flg = (kod == 1) ? dat->xf : (kod == 3) ? dat->pf : NULL;
+    return (flg == NULL || j >= VECN(flg) || VEC(flg, j) != FALSE);
+}
+
+/* first row of a reverse kind with ncol columns, nCol if none is requested */
+static int prx_firstRow(PRX_PROG *prog, moddat dat, int kod, int ncol) {
+    int j;
+
+    for (j = 0; j < ncol && j < prog->nArg; j++) {
+        if (prx_wanted(dat, kod, j)) {
+            return 0;
+        }
+    }
+    return prog->nCol[kod];
+}
+
+/*
+ * Dispatch of the scalar interpreter: threaded through a table of label
+ * addresses with compilers that support computed goto, a switch otherwise.
+ */
+#if defined(__GNUC__) && !defined(PRX_NO_THREADED)
+#define PRX_THREADED
+#endif
+
+#ifdef PRX_THREADED
+#define DISPATCH goto *label[(*code++).o];
+#define CASE(OP) L_##OP
+#define DEFAULT L_default
+#define NEXT goto *label[(*code++).o]
+#else
+#define DISPATCH switch ((*code++).o)
+#define CASE(OP) case OP
+#define DEFAULT default
+#define NEXT break
+#endif
+
+#define UNARY(EXPR)                                                            \
+    a = *SLOTP(code[1]);                                                       \
+    *SLOTP(code[0]) = (EXPR);                                                  \
+    code += 2;                                                                 \
+    NEXT
+
+#define BINARY(EXPR)                                                           \
+    a = *SLOTP(code[1]);                                                       \
+    b = *SLOTP(code[2]);                                                       \
+    *SLOTP(code[0]) = (EXPR);                                                  \
+    code += 3;                                                                 \
+    NEXT
+
+/* product a of the first two operands, combined with the third */
+#define FUSED(EXPR)                                                            \
+    a = *SLOTP(code[1]) * *SLOTP(code[2]);                                     \
+    c = *SLOTP(code[3]);                                                       \
+    *SLOTP(code[0]) = (EXPR);                                                  \
+    code += 4;                                                                 \
+    NEXT
+
+/*
+ * Execution of interpreter code, one point per call. The callers solve
+ * each point with its own Newton iteration, so points do not reach the
+ * model in blocks; the dispatch cost is reduced by the fused operators.
+ */
+boolean prx_compute(PRX_CTX *ctx, moddat dat) {
+    int kod;             /* kind of derivatives */
+    int iDvt;            /* index of current deriv. variable */
+    CODE *code;          /* interpreter code pointer */
+    fnum *base[KON + 1]; /* base address of each operand type */
+    matrix jac;          /* current Jacobian */
+    fnum a, b, c;        /* operand values */
+    int j;
+#ifdef PRX_THREADED
+    static void *label[EXPD + 1] = {
+        [INVAL] = &&L_INVAL, [AND] = &&L_AND,     [OR] = &&L_OR,
+        [NOT] = &&L_NOT,     [LT] = &&L_LT,       [GT] = &&L_GT,
+        [LE] = &&L_LE,       [GE] = &&L_GE,       [EQ] = &&L_EQ,
+        [NE] = &&L_NE,       [ADD] = &&L_ADD,     [SUB] = &&L_SUB,
+        [MUL] = &&L_MUL,     [DIV] = &&L_DIV,     [POW] = &&L_POW,
+        [SGN] = &&L_SGN,     [SIN] = &&L_SIN,     [COS] = &&L_COS,
+        [TAN] = &&L_TAN,     [ASIN] = &&L_ASIN,   [ACOS] = &&L_ACOS,
+        [ATAN] = &&L_ATAN,   [EXP] = &&L_EXP,     [LOG] = &&L_LOG,
+        [LG] = &&L_LG,       [SQRT] = &&L_SQRT,   [SQR] = &&L_SQR,
+        [NEG] = &&L_NEG,     [REV] = &&L_REV,     [INC] = &&L_INC,
+        [DEC] = &&L_DEC,     [ABS] = &&L_ABS,     [RET] = &&L_RET,
+        [CHKL] = &&L_CHKL,   [CHKG] = &&L_CHKG,   [LDF] = &&L_LDF,
+        [MOV] = &&L_MOV,     [CLR] = &&L_CLR,     [MADD] = &&L_MADD,
+        [MSUB] = &&L_MSUB,   [NMADD] = &&L_NMADD, [EXPM] = &&L_EXPM,
+        [EXPD] = &&L_EXPD,   [IF] = &&L_IF,       [EOD] = &&L_EOD,
+        [SOK] = &&L_SOK,     [SOR] = &&L_default, [JMP] = &&L_JMP,
+        [EQU] = &&L_default,
+        [OPD] = &&L_default, [NUM] = &&L_default, [DOPD] = &&L_default,
+        [ASS] = &&L_default, [NASS] = &&L_default, [ELSE] = &&L_default,
+        [FI] = &&L_default,  [STOP] = &&L_default};
+#endif
+
+    /* bind the model interface structure */
+
+    ctx->dat = dat;
+    ctx->errcode = 0;
+    base[VAR] = VECA(dat->x);
+    base[AUX] = VECA(dat->a);
+    base[PAR] = VECA(dat->p);
+    base[CON] = VECA(dat->c);
+    base[FLG] = VECA(dat->f);
+    base[RES] = VECA(dat->r);
+    base[TMP] = ctx->Tmp;
+    base[DRES] = NULL;
+    base[DTMP] = ctx->DTmp;
+    base[DARG] = ctx->Adj;
+    base[REG] = ctx->Reg;
+    base[KON] = ctx->prog->Num;
+
+    code = ctx->prog->kindStart[0];
     kod = 0;
+    iDvt = 0;
+    jac = NULL;
     for (;;) {
-        switch ((*code++).o) {
-        default:
-            errcode = COD_IERR;
-            error("Model interpreter");
+        DISPATCH {
+        DEFAULT:
+            ctx->fault = COD_IERR;
             return FALSE;
-        case INVAL:
+        CASE(INVAL):
             return TRUE; /* finished */
-        case AND:
-            pSt--;
-            *pSt = (*pSt != 0 && *(pSt + 1) != 0) ? 1 : 0;
-            break;
-        case OR:
-            pSt--;
-            *pSt = (*pSt != 0 || *(pSt + 1) != 0) ? 1 : 0;
-            break;
-        case NOT:
-            *pSt = (*pSt == 0) ? 1 : 0;
-            break;
-        case LT:
-            pSt--;
-            *pSt = (*pSt < *(pSt + 1)) ? 1 : 0;
-            break;
-        case GT:
-            pSt--;
-            *pSt = (*pSt > *(pSt + 1)) ? 1 : 0;
-            break;
-        case LE:
-            pSt--;
-            *pSt = (*pSt <= *(pSt + 1)) ? 1 : 0;
-            break;
-        case GE:
-            pSt--;
-            *pSt = (*pSt >= *(pSt + 1)) ? 1 : 0;
-            break;
-        case EQ:
-            pSt--;
-            *pSt = (*pSt == *(pSt + 1)) ? 1 : 0;
-            break;
-        case NE:
-            pSt--;
-            *pSt = (*pSt != *(pSt + 1)) ? 1 : 0;
-            break;
-        case ADD:
-            pSt--;
-            *pSt = *pSt + *(pSt + 1);
-            break;
-        case SUB:
-            pSt--;
-            *pSt = *pSt - *(pSt + 1);
-            break;
-        case MUL:
-            pSt--;
-            *pSt = *pSt * *(pSt + 1);
-            break;
-        case DIV:
-            pSt--;
-            *pSt = *pSt / *(pSt + 1);
-            break;
-        case POW:
-            pSt--;
-            *pSt = pow(*pSt, *(pSt + 1));
-            break;
-        case SGN:
-            *pSt = (*pSt >= 0) ? 1 : -1;
-            break;
-        case SIN:
-            *pSt = sin(*pSt);
-            break;
-        case COS:
-            *pSt = cos(*pSt);
-            break;
-        case TAN:
-            *pSt = tan(*pSt);
-            break;
-        case ASIN:
-            *pSt = asin(*pSt);
-            break;
-        case ACOS:
-            *pSt = acos(*pSt);
-            break;
-        case ATAN:
-            *pSt = atan(*pSt);
-            break;
-        case EXP:
-            *pSt = exp(*pSt);
-            break;
-        case LOG:
-            *pSt = log(*pSt);
-            break;
-        case LG:
-            *pSt = log10(*pSt);
-            break;
-        case SQRT:
-            *pSt = sqrt(*pSt);
-            break;
-        case SQR:
-            *pSt = *pSt * *pSt;
-            break;
-        case NEG:
-            *pSt = -*pSt;
-            break;
-        case REV:
-            *pSt = 1 / *pSt;
-            break;
-        case INC:
-            *pSt += 1;
-            break;
-        case DEC:
-            *pSt -= 1;
-            break;
-        case ABS:
-            if (*pSt < 0) {
-                *pSt = -*pSt;
-            }
-            break;
-        case RET:
-            prx_errcode = *pSt;
-            return (*pSt != 0) ? FALSE : TRUE;
-            break;
-        case CHKL:
-            pSt--;
-            if (*pSt < *(pSt + 1)) {
+        CASE(AND):
+            BINARY((a != 0 && b != 0) ? 1 : 0);
+        CASE(OR):
+            BINARY((a != 0 || b != 0) ? 1 : 0);
+        CASE(NOT):
+            UNARY((a == 0) ? 1 : 0);
+        CASE(LT):
+            BINARY((a < b) ? 1 : 0);
+        CASE(GT):
+            BINARY((a > b) ? 1 : 0);
+        CASE(LE):
+            BINARY((a <= b) ? 1 : 0);
+        CASE(GE):
+            BINARY((a >= b) ? 1 : 0);
+        CASE(EQ):
+            BINARY((a == b) ? 1 : 0);
+        CASE(NE):
+            BINARY((a != b) ? 1 : 0);
+        CASE(ADD):
+            BINARY(a + b);
+        CASE(SUB):
+            BINARY(a - b);
+        CASE(MUL):
+            BINARY(a * b);
+        CASE(DIV):
+            BINARY(a / b);
+        CASE(POW):
+            BINARY(pow(a, b));
+        CASE(SGN):
+            UNARY((a >= 0) ? 1 : -1);
+        CASE(SIN):
+            UNARY(sin(a));
+        CASE(COS):
+            UNARY(cos(a));
+        CASE(TAN):
+            UNARY(tan(a));
+        CASE(ASIN):
+            UNARY(asin(a));
+        CASE(ACOS):
+            UNARY(acos(a));
+        CASE(ATAN):
+            UNARY(atan(a));
+        CASE(EXP):
+            UNARY(exp(a));
+        CASE(LOG):
+            UNARY(log(a));
+        CASE(LG):
+            UNARY(log10(a));
+        CASE(SQRT):
+            UNARY(sqrt(a));
+        CASE(SQR):
+            UNARY(a * a);
+        CASE(NEG):
+            UNARY(-a);
+        CASE(REV):
+            UNARY(1 / a);
+        CASE(INC):
+            UNARY(a + 1);
+        CASE(DEC):
+            UNARY(a - 1);
+        CASE(ABS):
+            UNARY((a < 0) ? -a : a);
+        CASE(LDF):
+            UNARY(trunc(a) ? 1 : 0);
+        CASE(MOV):
+            UNARY(a);
+        CASE(MADD):
+            FUSED(a + c);
+        CASE(MSUB):
+            FUSED(a - c);
+        CASE(NMADD):
+            FUSED(c - a);
+        CASE(EXPM):
+            BINARY(exp(a * b));
+        CASE(EXPD):
+            BINARY(exp(a / b));
+        CASE(CLR):
+            *SLOTP(code[0]) = 0.0;
+            code++;
+            NEXT;
+        CASE(RET):
+            a = *SLOTP(code[0]);
+            ctx->errcode = a;
+            return (a != 0) ? FALSE : TRUE;
+        CASE(CHKL):
+            if (*SLOTP(code[0]) < *SLOTP(code[1])) {
                 return FALSE;
             }
-            pSt--;
-            break;
-        case CHKG:
-            pSt--;
-            if (*pSt > *(pSt + 1)) {
+            code += 2;
+            NEXT;
+        CASE(CHKG):
+            if (*SLOTP(code[0]) > *SLOTP(code[1])) {
                 return FALSE;
             }
-            pSt--;
-            break;
-        case DOPD:
-        case OPD:
-            *(++pSt) = *((*code++).f);
-            STCHECK(pSt);
-            break;
-        case NUM:
-            *(++pSt) = *((*code++).f);
-            STCHECK(pSt);
-            break;
-        case LDF:
-            *(++pSt) = trunc(*((*code++).f)) ? 1 : 0;
-            STCHECK(pSt);
-            break;
-        case ASS:
-            *((*code++).f) = *(pSt--);
-            break;
-        case NASS:
-            *((*code++).f) = -(*(pSt--));
-            break;
-        case CLR:
-            *((*code++).f) = 0.0;
-            break;
-        case IF:
-            if (*(pSt--) == 0) {
-                code = (*code).c;
-            } else {
-                code++;
-            }
-            break;
-        case EOD:
-            iDvt++;
-            if ((kod == 1) && (iDvt < VECN(dat->xf)) &&
-                (VEC(dat->xf, iDvt) == FALSE)) {
-                for (code++; (*code).o != EOD; code++) {
-                    /* empty */
-                }
-            }
-            if ((kod == 3) && (iDvt < VECN(dat->pf)) &&
-                (VEC(dat->pf, iDvt) == FALSE)) {
-                for (code++; (*code).o != EOD; code++) {
-                    /* empty */
+            code += 2;
+            NEXT;
+        CASE(IF):
+            code = (*SLOTP(code[0]) == 0) ? code[1].c : code + 2;
+            NEXT;
+        CASE(EOD):
+            if (ctx->prog->bRev[kod]) { /* row iDvt of the Jacobian */
+                for (j = 0; j < MATN(jac) && j < ctx->prog->nArg; j++) {
+                    if (iDvt < MATM(jac) && prx_wanted(dat, kod, j)) {
+                        MAT(jac, iDvt, j) = ctx->Adj[j];
+                    }
                 }
+                code = ctx->prog->colStart[kod][++iDvt];
+                NEXT;
             }
-            break;
-        case SOK:
+            iDvt = prx_column(ctx->prog, dat, kod, iDvt + 1);
+            code = ctx->prog->colStart[kod][iDvt];
+            DCOLUMN;
+            NEXT;
+        CASE(SOK):
             kod++;
-            iDvt = 0;
-            if (kod == 1) {
-                if (!dat->jxf) {
-                    code = kindStart[3];
-                    kod++;
-                } else if (VEC(dat->xf, iDvt) == FALSE) {
-                    for (code++; (*code).o != EOD; code++) {
-                        /* empty */
-                    }
-                }
-            } else if (kod == 3) {
-                if (!dat->jpf) {
-                    return TRUE;
-                }
-                if (VEC(dat->pf, iDvt) == FALSE) {
-                    for (code++; (*code).o != EOD; code++) {
-                        /* empty */
-                    }
-                }
+            if (kod == 1 && !dat->jxf) {
+                code = ctx->prog->kindStart[3];
+                kod++;
+                NEXT;
             }
-            break;
-        case JMP:
+            if (kod == 3 && !dat->jpf) {
+                return TRUE;
+            }
+            jac = (kod == 1) ? dat->jx : (kod == 2) ? dat->ja : dat->jp;
+            if (ctx->prog->bRev[kod]) {
+                iDvt = prx_firstRow(ctx->prog, dat, kod,
+                                    (jac != NULL) ? MATN(jac) : 0);
+                code = ctx->prog->colStart[kod][iDvt];
+                base[DRES] = ctx->Adj + ctx->prog->nArg;
+                NEXT;
+            }
+            iDvt = prx_column(ctx->prog, dat, kod, 0);
+            code = ctx->prog->colStart[kod][iDvt];
+            DCOLUMN;
+            NEXT;
+        CASE(JMP):
             code = (*code).c;
-            break;
+            NEXT;
         }
     }
 }
@@ -25,10 +25,40 @@
 #include "primtype.h"
 #include <assert.h>
 
-/* Input and adaptation of interpreter code (once per ParX execution) */
-extern boolean prx_inCode(moddat dat, FILE *inFile);
+/*
+ * A loaded model program is immutable after prx_loadCode and can be shared
+ * by any number of threads. All mutable state of an evaluation (operand
+ * stack, temporaries, bound moddat) lives in an execution context, one per
+ * thread.
+ */
+
+typedef struct PRX_PROG_S PRX_PROG; /* loaded interpreter code */
+typedef struct PRX_CTX_S PRX_CTX;   /* execution context */
+
+/* Input of interpreter code into a shareable program */
+extern PRX_PROG *prx_loadCode(FILE *inFile);
+extern void prx_freeCode(PRX_PROG *prog);
+
+/* Creation of an execution context for a program */
+extern PRX_CTX *prx_newContext(PRX_PROG *prog);
+extern void prx_freeContext(PRX_CTX *ctx);
+
+/* Execution of interpreter code on the moddat bound to the context */
+extern boolean prx_compute(PRX_CTX *ctx, moddat dat);
+
+/* Input of the current model program (once per numblock) */
+extern boolean prx_inCode(FILE *inFile);
+
+/* Model procedure: current program, context of the calling thread */
+extern boolean prx_model(moddat dat);
+
+/*
+ * Report an interpreter error in the context of the calling thread. Worker
+ * threads report on release, in their stop procedure, one at a time.
+ */
+extern void prx_reportFault(void);
 
-/* Execution of interpreter code */
-extern boolean prx_compute(moddat dat);
+/* Release the context of the calling thread */
+extern void prx_releaseContext(void);
 
 #endif
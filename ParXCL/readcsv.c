@@ -19,35 +19,255 @@
  */
 
 #include "datastruct.h"
+#include "datatpl.h"
 #include "parx.h"
 #include "primtype.h"
 
+#define CSV_BUF 65536  /* size of the read buffer */
+#define CSV_TOKEN 1024 /* maximum length of a token */
+#define CSV_DIG 19     /* maximum number of digits of an exact mantissa */
+#define CSV_EXACT 15   /* digits of a mantissa that is exact in a fnum */
+#define CSV_POW 22     /* largest exact power of ten in a fnum */
+
+static const fnum csv_pow10[CSV_POW + 1] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/*
+ * Convert the leading number in token s, like sscanf "%le". A mantissa of
+ * upto CSV_EXACT digits times an exact power of ten is correctly rounded by
+ * a single multiplication or division, all other numbers go to strtod.
+ */
+
+static boolean csv_number(const char *s, fnum *f) {
+    const char *p;
+    unsigned long long m;
+    int nd, nm, e10, ex, esign;
+    boolean neg;
+
+    p = s;
+    neg = FALSE;
+    if ((*p == '+') || (*p == '-')) {
+        neg = (*p == '-') ? TRUE : FALSE;
+        p++;
+    }
+
+    m = 0;
+    nd = nm = e10 = 0;
+
+    for (; isdigit((unsigned char)*p); p++, nm++) {
+        if ((m == 0) && (*p == '0')) {
+            continue; /* leading zero */
+        }
+        if (nd < CSV_DIG) {
+            m = 10 * m + (unsigned long long)(*p - '0');
+        } else {
+            e10++;
+        }
+        nd++;
+    }
+    if (*p == '.') {
+        for (p++; isdigit((unsigned char)*p); p++, nm++) {
+            if ((m == 0) && (*p == '0')) {
+                e10--;
+                continue;
+            }
+            if (nd < CSV_DIG) {
+                m = 10 * m + (unsigned long long)(*p - '0');
+                e10--;
+            }
+            nd++;
+        }
+    }
+    if (nm == 0) {
+        return (FALSE); /* no mantissa */
+    }
+
+    if (((*p == 'e') || (*p == 'E')) &&
+        (isdigit((unsigned char)p[1]) ||
+         (((p[1] == '+') || (p[1] == '-')) && isdigit((unsigned char)p[2])))) {
+        p++;
+        esign = 1;
+        if ((*p == '+') || (*p == '-')) {
+            esign = (*p == '-') ? -1 : 1;
+            p++;
+        }
+        for (ex = 0; isdigit((unsigned char)*p); p++) {
+            ex = (ex < 10000) ? 10 * ex + (*p - '0') : ex;
+        }
+        e10 += esign * ex;
+    }
+
+    if ((nd <= CSV_EXACT) && (e10 >= -CSV_POW) && (e10 <= CSV_POW)) {
+        *f = (fnum)m;
+        *f = (e10 < 0) ? *f / csv_pow10[-e10] : *f * csv_pow10[e10];
+        *f = (neg == TRUE) ? -*f : *f;
+    } else {
+        *f = strtod(s, NULL);
+    }
+    return (TRUE);
+}
+
+/* data type of a column header, the name is cut at the ':' */
+
+static stateflag csv_type(char *token) {
+    stateflag state;
+    char *tp;
+
+    state = FACT; /* determine type */
+    if (strstr(token, ":sw")) {
+        state = SWEEP;
+    }
+    if (strstr(token, ":x")) {
+        if (strstr(token, ":x0")) {
+            state = SWEEP;
+        } else {
+            state = STIM;
+        }
+    }
+    if (strstr(token, ":st"))
+        state = STIM;
+    if (strstr(token, ":y"))
+        state = STIM;
+    if (strstr(token, ":m"))
+        state = MEAS;
+    if (strstr(token, ":c"))
+        state = CALC;
+    if (strstr(token, ":f"))
+        state = FACT;
+    if (strstr(token, ":e"))
+        state = ERR;
+    tp = strchr(token, ':');
+    if (tp) {
+        *tp = '\0';
+    }
+    return (state);
+}
+
+/*
+ * Reorder the header in into dt: the sweep variable first, then the stimuli,
+ * measurements and facts. Column j of dt takes its value from column iv[j]
+ * of the file and its error from column ie[j], -1 if there is none.
+ */
+
+static inum csv_order(colhead_list in, datatemplate dt, inum **iv, inum **ie) {
+    colhead_list head, sweep, hv, he;
+    inum nout, idx, i;
+
+    sweep = colheadNIL;
+    for (head = in; head != colheadNIL; head = head->next) {
+        if (head->type == SWEEP) {
+            if (sweep != colheadNIL) {
+                tm_lineno = 1;
+                (void)strcpy(tm_errmsg, "multiple sweep variables");
+                return (-1);
+            } else {
+                sweep = head;
+            }
+        }
+    }
+    if (sweep != colheadNIL) { /* there is a sweep, put it first */
+        dt->header = append_colhead_list(dt->header, rdup_colhead(sweep));
+    }
+    for (head = in; head != colheadNIL; head = head->next) {
+        if (head->type == STIM) {
+            dt->header = append_colhead_list(dt->header, rdup_colhead(head));
+        }
+    }
+    for (head = in; head != colheadNIL; head = head->next) {
+        if (head->type == MEAS || head->type == CALC) {
+            dt->header = append_colhead_list(dt->header, rdup_colhead(head));
+        }
+    }
+    for (head = in; head != colheadNIL; head = head->next) {
+        if (head->type == FACT) {
+            dt->header = append_colhead_list(dt->header, rdup_colhead(head));
+        }
+    }
+
+    for (head = dt->header, nout = 0; head != colheadNIL; head = head->next) {
+        nout++;
+    }
+    *iv = TM_MALLOC(inum *, MAX(nout, 1) * sizeof(inum));
+    *ie = TM_MALLOC(inum *, MAX(nout, 1) * sizeof(inum));
+
+    for (head = dt->header, idx = 0; head != colheadNIL;
+         head = head->next, idx++) {
+        (*iv)[idx] = (*ie)[idx] = -1;
+        for (hv = in, i = 0; hv != colheadNIL; hv = hv->next, i++) {
+            if (hv->type != ERR && strcmp(head->name, hv->name) == 0) {
+                (*iv)[idx] = i;
+                break;
+            }
+        }
+        for (he = in, i = 0; he != colheadNIL; he = he->next, i++) {
+            if (he->type == ERR && strcmp(head->name, he->name) == 0) {
+                (*ie)[idx] = i;
+                break;
+            }
+        }
+    }
+    return (nout);
+}
+
+/*
+ * Read a CSV file into data table dt. The first line holds the column
+ * headers, an empty line starts a new curve. The file is read in blocks
+ * and each row goes straight into the columns of dt.
+ */
+
 inum readcsv(FILE *fp, datatemplate dt) {
+    char *buf;
+    size_t nbuf, ib;
+    boolean eof;
     int c;
-    char token[1024];
+    char token[CSV_TOKEN];
     char *tp;
     int nest, data;
-    int cc, ncol, col;
+    int cc, ncol, col, ic;
     fnum f;
+    fnum *val;
+    inum *iv, *ie;
+    inum nout, j;
+    inum rc;
 
     datatemplate dti;
-    colhead_list head, sweep, hv, he;
-    datarow_list dr, dri, dro;
-    inum crvid;
+    colhead_list head, sweep;
     stateflag state;
-    inum idx, iv, ie;
+    datacolumns dc;
+    inum r, nrow;
+    inum crvid;
     inum ssign0, ssign1, ncurve, ncurves, nflyb;
 
-    head = colheadNIL;
-    dr = datarowNIL;
-    dti = new_datatemplate(tmstringNIL, head, dr);
+    dti = new_datatemplate(tmstringNIL, colheadNIL, datacolumnsNIL);
+
+    buf = TM_MALLOC(char *, CSV_BUF);
+    val = NULL;
+    iv = ie = NULL;
+    nout = 0;
+    rc = 1;
+
+    dc = dt->data;
 
-    nest = data = ncol = col = cc = 0;
+    nest = data = ncol = col = cc = ic = 0;
     tp = token;
     tm_lineno = 1;
     crvid = 1;
 
-    while ((c = fgetc(fp)) != EOF) {
+    for (nbuf = ib = 0, eof = FALSE;;) {
+        if (ib >= nbuf) {
+            nbuf = fread(buf, 1, CSV_BUF, fp);
+            ib = 0;
+        }
+        if (ib < nbuf) {
+            c = (unsigned char)buf[ib++];
+        } else if ((eof == FALSE) &&
+                   ((tp != token) || (col > (data ? 1 : 0)))) {
+            c = '\n'; /* last line without eol */
+            eof = TRUE;
+        } else {
+            break;
+        }
         cc++;
         switch (c) {
         case '"':
@@ -61,9 +281,6 @@ inum readcsv(FILE *fp, datatemplate dt) {
         case '\n':
             if (cc == 1) { /* empty line separates curves */
                 crvid++;
-                if (data && dr) {
-                    dr->crvid = crvid;
-                }
                 tm_lineno++;
                 cc = 0;
                 continue;
@@ -74,9 +291,12 @@ inum readcsv(FILE *fp, datatemplate dt) {
             }
             if (!data) { /* header line defines number of columns */
                 ncol = ++col;
-            } else if (col != ncol) { /* eol unexpected */
+            } else if (col < ncol) { /* eol unexpected */
                 (void)strcpy(tm_errmsg, "missing data column");
                 goto error;
+            } else if (col > ncol) { /* eol expected */
+                (void)strcpy(tm_errmsg, "too many data columns");
+                goto error;
             }
             col = cc = 0;
 
@@ -89,154 +309,76 @@ inum readcsv(FILE *fp, datatemplate dt) {
             if (data == 0) {       /* parsing header */
                 if (tp == token) { /* empty header */
                     head = new_colhead(new_tmstring(""), FACT);
-                    dti->header = append_colhead_list(dti->header, head);
-                } else {          /* parse header */
-                    state = FACT; /* determine type */
-                    if (strstr(token, ":sw")) {
-                        state = SWEEP;
-                    }
-                    if (strstr(token, ":x")) {
-                        if (strstr(token, ":x0")) {
-                            state = SWEEP;
-                        } else {
-                            state = STIM;
-                        }
-                    }
-                    if (strstr(token, ":st"))
-                        state = STIM;
-                    if (strstr(token, ":y"))
-                        state = STIM;
-                    if (strstr(token, ":m"))
-                        state = MEAS;
-                    if (strstr(token, ":c"))
-                        state = CALC;
-                    if (strstr(token, ":f"))
-                        state = FACT;
-                    if (strstr(token, ":e"))
-                        state = ERR;
-                    tp = strchr(token, ':');
-                    if (tp) {
-                        *tp = '\0';
-                    }
+                } else { /* parse header */
+                    state = csv_type(token);
                     head = new_colhead(new_tmstring(token), state);
-                    dti->header = append_colhead_list(dti->header, head);
                 }
-            } else {               /* parsing data */
-                if (tp == token) { /* column is empty */
-                    assert(dr != datarowNIL);
-                    dr->row = append_fnum_list(dr->row, (fnum)0.0);
-                } else { /* a number */
-                    if (sscanf(token, "%le", &f) != 1) {
-                        (void)strcpy(tm_errmsg, " illegal number");
+                dti->header = append_colhead_list(dti->header, head);
+            } else if (ic >= ncol) { /* too many columns */
+                (void)strcpy(tm_errmsg, "too many data columns");
+                goto error;
+            } else if (tp == token) { /* column is empty */
+                val[ic] = 0.0;
+            } else if (csv_number(token, &f) == TRUE) { /* a number */
+                val[ic] = f;
+            } else {
+                (void)strcpy(tm_errmsg, " illegal number");
+                goto error;
+            }
+            if (c == '\n') { /* column terminator is eol */
+                if (data == 0) { /* header complete */
+                    nout = csv_order(dti->header, dt, &iv, &ie);
+                    if (nout < 0) {
                         goto error;
                     }
-                    dr->row = append_fnum_list(dr->row, f);
+                    val = TM_MALLOC(fnum *, ncol * sizeof(fnum));
+                    while (MATN(dc->val) < nout) {
+                        (void)add_datacolumn(dc);
+                    }
+                } else { /* row complete */
+                    r = add_datarow(dc, 1, crvid, data);
+                    for (j = 0; j < nout; j++) {
+                        MAT(dc->val, r, j) = iv[j] < 0 ? (fnum)0.0 : val[iv[j]];
+                        MAT(dc->err, r, j) = ie[j] < 0 ? (fnum)0.0 : val[ie[j]];
+                    }
                 }
-            }
-            if (c == '\n') { /* column terminator is eol */
-                dr = new_datarow(1, crvid, data + 1, new_fnum_list(),
-                                 new_fnum_list());
-                dti->data = append_datarow_list(dti->data, dr);
                 data++;
                 tm_lineno++;
+                ic = -1;
             }
             tp = token;
             col++;
+            ic++;
             continue;
 
         default:
+            if (tp >= token + CSV_TOKEN - 1) {
+                sprintf(tm_errmsg, "token too long in c%d", col + 1);
+                goto error;
+            }
             if (!data && (isalnum(c) || c == '_' ||
                           c == ':')) { /* variable name & type */
                 *(tp++) = c;
                 *tp = 0;
                 continue;
-            } else if (data && (isdigit(c) ||
-                                strchr("eE+-.", c))) { /* a valid number */
-                *(tp++) = c;
+            } else if (data &&
+                       (isdigit(c) || (c && strchr("eE+-.", c)))) {
+                *(tp++) = c; /* a valid number */
                 *tp = 0;
                 continue;
             } else {
-                sprintf(tm_errmsg, "illegal character '%c' in c%d", c, col + 1);
+                sprintf(tm_errmsg, "illegal character '%c' in c%d", c,
+                        col + 1);
                 goto error;
             }
         }
     }
 
-    /* remove any empty rows (last one!) */
-
-    for (dr = dti->data; dr != datarowNIL; dr = dr->next) {
-        if (dr->next != datarowNIL && LSTS(dr->next->row) == 0) {
-            dri = dr->next;
-            dr->next = dr->next->next;
-            rfre_datarow(dri);
-        }
-    }
-
-    /* reorder header, find sweep var */
+    /* the sweep variable, if any, is the first column */
 
     sweep = colheadNIL;
-    for (head = dti->header, col = 0; head != colheadNIL; head = head->next) {
-        if (head->type != ERR) {
-            col++;
-        }
-        if (head->type == SWEEP) {
-            if (sweep != colheadNIL) {
-                tm_lineno = 1;
-                (void)strcpy(tm_errmsg, "multiple sweep variables");
-                goto error;
-            } else {
-                sweep = head;
-            }
-        }
-    }
-    if (sweep != colheadNIL) { /* there is a sweep, put it first */
-        dt->header = append_colhead_list(dt->header, rdup_colhead(sweep));
-    }
-    for (head = dti->header; head != colheadNIL; head = head->next) {
-        if (head->type == STIM) {
-            dt->header = append_colhead_list(dt->header, rdup_colhead(head));
-        }
-    }
-    for (head = dti->header; head != colheadNIL; head = head->next) {
-        if (head->type == MEAS || head->type == CALC) {
-            dt->header = append_colhead_list(dt->header, rdup_colhead(head));
-        }
-    }
-    for (head = dti->header; head != colheadNIL; head = head->next) {
-        if (head->type == FACT) {
-            dt->header = append_colhead_list(dt->header, rdup_colhead(head));
-        }
-    }
-
-    /* create receiving datarows */
-
-    for (dri = dti->data; dri != datarowNIL; dri = dri->next) {
-        dro = new_datarow(dri->grpid, dri->crvid, dri->rowid, new_fnum_list(),
-                          new_fnum_list());
-        dt->data = append_datarow_list(dt->data, dro);
-    }
-
-    /* transpose the data */
-
-    for (head = dt->header, idx = 0; head != colheadNIL;
-         head = head->next, idx++) {
-        for (hv = dti->header, iv = 0; hv != colheadNIL; hv = hv->next, iv++) {
-            if (hv->type != ERR && strcmp(head->name, hv->name) == 0) {
-                break;
-            }
-        }
-        for (he = dti->header, ie = 0; he != colheadNIL; he = he->next, ie++) {
-            if (he->type == ERR && strcmp(head->name, he->name) == 0) {
-                break;
-            }
-        }
-        for (dri = dti->data, dro = dt->data; dri != datarowNIL;
-             dri = dri->next, dro = dro->next) {
-            dro->row = append_fnum_list(
-                dro->row, hv == colheadNIL ? (fnum)0.0 : LST(dri->row, iv));
-            dro->err = append_fnum_list(
-                dro->err, he == colheadNIL ? (fnum)0.0 : LST(dri->row, ie));
-        }
+    if ((dt->header != colheadNIL) && (dt->header->type == SWEEP)) {
+        sweep = dt->header;
     }
 
     /* determine if data is ordered in curves on sweep variable*/
@@ -246,24 +388,27 @@ inum readcsv(FILE *fp, datatemplate dt) {
     ncurves = 1;
     nflyb = 0;
 
-    if (sweep != colheadNIL && dt->data != datarowNIL) {
-        for (dr = dt->data; dr->next != datarowNIL; dr = dr->next) {
+    nrow = MATM(dc->val);
+
+    if (sweep != colheadNIL && nrow > 0) {
+        for (r = 0; r + 1 < nrow; r++) {
 
-            if (LST(dr->row, 0) == LST(dr->next->row, 0)) {
+            if (MAT(dc->val, r, 0) == MAT(dc->val, r + 1, 0)) {
                 ssign0 = 0;
-            } else if (LST(dr->row, 0) < LST(dr->next->row, 0)) {
+            } else if (MAT(dc->val, r, 0) < MAT(dc->val, r + 1, 0)) {
                 ssign0 = 1;
             } else {
                 ssign0 = -1;
             }
 
-            if (dr->crvid != dr->next->crvid) { /* curve switch */
+            if (VEC(dc->crvid, r) != VEC(dc->crvid, r + 1)) { /* curve switch */
                 ncurve++;
             }
 
             if (ssign0 == -ssign1) { /* flyback */
                 nflyb++;
-                if (dr->crvid != dr->next->crvid) { /* curve switch in sync */
+                if (VEC(dc->crvid, r) !=
+                    VEC(dc->crvid, r + 1)) { /* curve switch in sync */
                     ncurves++;
                 }
             }
@@ -277,10 +422,10 @@ inum readcsv(FILE *fp, datatemplate dt) {
         } else {              /* split in curves */
             ssign1 = 0;
             ncurve = 2;
-            for (dr = dt->data; dr->next != datarowNIL; dr = dr->next) {
-                if (LST(dr->row, 0) == LST(dr->next->row, 0)) {
+            for (r = 0; r + 1 < nrow; r++) {
+                if (MAT(dc->val, r, 0) == MAT(dc->val, r + 1, 0)) {
                     ssign0 = 0;
-                } else if (LST(dr->row, 0) < LST(dr->next->row, 0)) {
+                } else if (MAT(dc->val, r, 0) < MAT(dc->val, r + 1, 0)) {
                     ssign0 = 1;
                 } else {
                     ssign0 = -1;
@@ -289,15 +434,22 @@ inum readcsv(FILE *fp, datatemplate dt) {
                     ncurve++;
                 }
                 ssign1 = ssign0;
-                dr->crvid = ncurve / 2;
+                VEC(dc->crvid, r) = ncurve / 2;
             }
-            dr->crvid = ncurve / 2;
+            VEC(dc->crvid, r) = ncurve / 2;
         }
     }
 
-    rfre_datatemplate(dti);
-    return (0);
+    rc = 0;
 error:
+    TM_FREE(buf);
+    if (val != NULL) {
+        TM_FREE(val);
+    }
+    if (iv != NULL) {
+        TM_FREE(iv);
+        TM_FREE(ie);
+    }
     rfre_datatemplate(dti);
-    return (1);
+    return (rc);
 }
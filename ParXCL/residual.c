@@ -26,6 +26,8 @@
 
 /************************ global variables *****************************/
 
+/* problem setup, shared by all threads */
+
 static inum nc; /* number of constraints */
 static inum nr; /* number of residuals */
 static inum nx; /* number of variable x */
@@ -35,47 +37,54 @@ static inum np; /* number of variable p */
 static inum_list xtrans; /* x transformation vector */
 static inum_list ptrans; /* p transformation vector */
 
-static vector x_scale; /* scaling vector for x and Jacx */
 static vector p_scale; /* scaling vector for p and Jacp */
 
 static vector p_low; /* un-scaled vector of lower bounds */
 static vector p_up;  /* un-scaled vector of upper bounds */
 
-static procedure model_code;   /* model code pointer */
-static moddat model_interface; /* model interface structure */
+static procedure model_code; /* model code pointer */
+static moddat model_main;    /* model interface structure of the caller */
 
-static matrix jacp;   /* reduced Jacobian matrix */
-static matrix jacp_s; /* reduced Jacobian matrix */
-static vector facp;   /* row buffer Jacp */
+static inum maxiter; /* maximum number of iterations per point */
+#define IT_FAC 100   /* factor for calculation of maxiter */
 
-static matrix jacx;   /* reduced and scaled Jacobian matrix */
-static matrix jacx_s; /* reduced and scaled Jacobian matrix */
-static vector facx;   /* row buffer Jacx */
+static fnum tolerance; /* modes tolerance factor == relative model accuracy */
 
-static matrix jaca; /* auxiliary Jacobian matrix */
-static vector faca; /* row buffer Jaca */
+/* workspace, private to each thread */
 
-static vector x_ref;  /* current reference point */
-static vector dist;   /* distance from model hyperplane */
-static vector aux;    /* auxiliary variables */
-static vector lambda; /* Lagrange multipliers */
+static THREAD_LOCAL moddat model_interface; /* model interface structure */
 
-static matrix c_trans_l; /* constraint space transformation matrix */
-static matrix c_trans_x; /* constraint space transformation matrix */
-static vector c_scale;   /* constraint space scaling values */
+static THREAD_LOCAL vector x_scale; /* scaling vector for x and Jacx */
 
-static inum maxiter; /* maximum number of iterations per point */
-#define IT_FAC 100   /* factor for calculation of maxiter */
+static THREAD_LOCAL matrix jacp;   /* reduced Jacobian matrix */
+static THREAD_LOCAL matrix jacp_s; /* reduced Jacobian matrix */
+static THREAD_LOCAL vector facp;   /* row buffer Jacp */
 
-static inum model_calls_r;  /* number of model residual evaluations */
-static inum model_calls_jx; /* number of model Jacx evaluations */
-static inum model_calls_jp; /* number of model Jacp evaluations */
+static THREAD_LOCAL matrix jacx;   /* reduced and scaled Jacobian matrix */
+static THREAD_LOCAL matrix jacx_s; /* reduced and scaled Jacobian matrix */
+static THREAD_LOCAL vector facx;   /* row buffer Jacx */
 
-static fnum tolerance; /* modes tolerance factor == relative model accuracy */
+static THREAD_LOCAL matrix jaca; /* auxiliary Jacobian matrix */
+static THREAD_LOCAL vector faca; /* row buffer Jaca */
+
+static THREAD_LOCAL vector x_ref;  /* current reference point */
+static THREAD_LOCAL vector dist;   /* distance from model hyperplane */
+static THREAD_LOCAL vector aux;    /* auxiliary variables */
+static THREAD_LOCAL vector lambda; /* Lagrange multipliers */
+
+static THREAD_LOCAL matrix c_trans_l; /* constraint space transformation */
+static THREAD_LOCAL matrix c_trans_x; /* constraint space transformation */
+static THREAD_LOCAL vector c_scale;   /* constraint space scaling values */
+
+static THREAD_LOCAL inum model_calls_r;  /* model residual evaluations */
+static THREAD_LOCAL inum model_calls_jx; /* model Jacx evaluations */
+static THREAD_LOCAL inum model_calls_jp; /* model Jacp evaluations */
 
 /***********************************************************************/
 
 static boolean eval_model(boolean rf, boolean jxf, boolean jpf, inum trace);
+static void new_work(void);
+static void fre_work(void);
 
 /***********************************************************************/
 
@@ -154,6 +163,7 @@ boolean new_residual(modres mr,   /* model result structure */
 
     model_code = mr->model;
 
+    model_main = mi;
     model_interface = mi;
 
     /* setup buffer variables */
@@ -162,6 +172,20 @@ boolean new_residual(modres mr,   /* model result structure */
     na = mr->na;
     nr = nc - na;
 
+    new_work();
+
+    /* setup distance function */
+
+    maxiter = IT_FAC * (nx + na);
+
+    new_distance(nc, nx, na, prec, tol, atol);
+
+    return (TRUE);
+}
+
+/* allocate the buffers of the calling thread */
+
+static void new_work(void) {
     jacp = rnew_matrix(nc, np);
     jacp_s = new_sub_matrix(jacp);
     sub_matrix(jacp, 0, 0, nr, np, jacp_s);
@@ -185,14 +209,6 @@ boolean new_residual(modres mr,   /* model result structure */
     c_scale = rnew_vector(nr);
     c_trans_x = rnew_matrix(nr, nx);
     c_trans_l = rnew_matrix(nr, nr);
-
-    /* setup distance function */
-
-    maxiter = IT_FAC * (nx + na);
-
-    new_distance(nc, nx, na, prec, tol, atol);
-
-    return (TRUE);
 }
 
 void fre_residual(void) /* free globals */ {
@@ -202,6 +218,14 @@ void fre_residual(void) /* free globals */ {
     rfre_vector(p_low);
     rfre_vector(p_up);
 
+    fre_work();
+
+    fre_distance();
+}
+
+/* free the buffers of the calling thread */
+
+static void fre_work(void) {
     rfre_vector(lambda);
     rfre_vector(dist);
     rfre_vector(aux);
@@ -223,8 +247,96 @@ void fre_residual(void) /* free globals */ {
     rfre_vector(c_scale);
     rfre_matrix(c_trans_x);
     rfre_matrix(c_trans_l);
+}
 
-    fre_distance();
+/*
+ * Allocate the workspace of a thread, other than the one that called
+ * new_residual, with its own copy of the model interface structure
+ */
+
+void new_residual_work(void) {
+    moddat mi;
+    boolvector xf, pf;
+    inum i;
+
+    mi = model_main;
+
+    xf = rnew_boolvector(VECN(mi->xf));
+    for (i = 0; i < VECN(xf); i++) {
+        VEC(xf, i) = VEC(mi->xf, i);
+    }
+    pf = rnew_boolvector(VECN(mi->pf));
+    for (i = 0; i < VECN(pf); i++) {
+        VEC(pf, i) = VEC(mi->pf, i);
+    }
+
+    model_interface = new_moddat(
+        rdup_vector(mi->x), rdup_vector(mi->a), rdup_vector(mi->p),
+        rdup_vector(mi->c), rdup_vector(mi->f), FALSE,
+        rnew_vector(VECN(mi->r)), FALSE, xf,
+        rnew_matrix(MATM(mi->jx), MATN(mi->jx)),
+        rnew_matrix(MATM(mi->ja), MATN(mi->ja)), FALSE, pf,
+        rnew_matrix(MATM(mi->jp), MATN(mi->jp)));
+
+    new_work();
+    new_distance_work();
+}
+
+/* free the workspace of a thread allocated by new_residual_work */
+
+void fre_residual_work(void) {
+    fre_distance_work();
+    fre_work();
+
+    rfre_moddat(model_interface);
+    model_interface = moddatNIL;
+}
+
+/*
+ * Allocate the warm start state of the distance solve of a point: the
+ * distance, auxiliary variables and Lagrange multipliers
+ */
+
+vector new_residual_state(void) { return (rnew_vector(nx + na + nc)); }
+
+/* initialize the distance solve from the state, return FALSE if unusable */
+
+static boolean load_state(vector ws) {
+    inum i;
+
+    for (i = 0; i < VECN(ws); i++) {
+        if (!isfinite(VEC(ws, i))) {
+            return (FALSE);
+        }
+    }
+
+    for (i = 0; i < nx; i++) {
+        VEC(dist, i) = VEC(ws, i);
+    }
+    for (i = 0; i < na; i++) {
+        VEC(aux, i) = VEC(ws, nx + i);
+    }
+    for (i = 0; i < nc; i++) {
+        VEC(lambda, i) = VEC(ws, nx + na + i);
+    }
+
+    return (TRUE);
+}
+
+/* save the converged distance solve in the state */
+
+static void save_state(vector ws) {
+    inum i;
+
+    for (i = 0; i < nx; i++) {
+        VEC(ws, i) = VEC(dist, i);
+    }
+    for (i = 0; i < na; i++) {
+        VEC(ws, nx + i) = VEC(aux, i);
+    }
+    for (i = 0; i < nc; i++) {
+        VEC(ws, nx + na + i) = VEC(lambda, i);
+    }
 }
 
 /* un-scale distance vector for printing */
@@ -350,7 +462,7 @@ void new_pvar(pset ps,      /* parameter set with upper and lower bounds */
 ) {
     inum i;
 
-    copy_vector(ps->val, model_interface->p);
+    copy_vector(ps->val, model_main->p);
 
     *pval = rnew_vector(np);
     *plow = rnew_vector(np);
@@ -460,6 +572,8 @@ boolean residual(xset xs,     /* set of measurements */
                  matrix jp,   /* Jacobian matrix */
                  boolean sf,  /* scaling matrix request flag */
                  matrix s,    /* scaling matrix */
+                 vector ws,   /* warm start state, vectorNIL if none */
+                 boolean *wf, /* warm start state is valid */
                  inum *mc_r,  /* number of model residual evaluations */
                  inum *mc_jx, /* number of model Jacobian_x evaluations */
                  inum *mc_jp, /* number of model Jacobian_p evaluations */
@@ -468,6 +582,7 @@ boolean residual(xset xs,     /* set of measurements */
     inum rank; /* rank from singular value decomposition */
     fnum f, piv;
     boolean b;
+    boolean warm; /* distance solve started from the previous solution */
     inum ncl;
     inum i, c, a;
     inum rs, rd, rp;
@@ -477,6 +592,14 @@ boolean residual(xset xs,     /* set of measurements */
     model_calls_jx = *mc_jx;
     model_calls_jp = *mc_jp;
 
+    if (model_interface != model_main) { /* take over fixed parameters */
+        for (i = 0; i < VECN(model_interface->p); i++) {
+            if (VEC(model_interface->pf, i) == FALSE) {
+                VEC(model_interface->p, i) = VEC(model_main->p, i);
+            }
+        }
+    }
+
     T_pv_p(pv, p_scale, model_interface->p); /* substitute parm. values */
 
     copy_vector(xs->val, x_ref);
@@ -488,13 +611,33 @@ boolean residual(xset xs,     /* set of measurements */
                 fabs(VEC(xs->abserr, i)));
     }
 
-    /* we have no initial values for dist and lambda */
+    /* start from the previous solution of this point, if any */
+
+    warm = ((ws != vectorNIL) && (*wf == TRUE)) ? load_state(ws) : FALSE;
+
+    if (warm == TRUE) {
+        b = distance(dist, aux, lambda, jacx, jaca, maxiter, trace - 1);
 
-    zero_vector(dist);   /* zero distance */
-    zero_vector(lambda); /* zero Lagrange estimate */
-    zero_vector(aux);    /* zero auxiliary variables */
+        if ((b == FALSE) && (trace >= 1)) {
+            fprintf(trace_stream, "point %ld: warm start failed, cold start\n",
+                    (long)(xs->id));
+        }
+    }
 
-    b = distance(dist, aux, lambda, jacx, jaca, maxiter, trace - 1);
+    if ((warm == FALSE) || (b == FALSE)) {
+        zero_vector(dist);   /* zero distance */
+        zero_vector(lambda); /* zero Lagrange estimate */
+        zero_vector(aux);    /* zero auxiliary variables */
+
+        b = distance(dist, aux, lambda, jacx, jaca, maxiter, trace - 1);
+    }
+
+    if (ws != vectorNIL) {
+        *wf = b;
+        if (b == TRUE) {
+            save_state(ws);
+        }
+    }
 
     *mc_r = model_calls_r;
     *mc_jx = model_calls_jx;
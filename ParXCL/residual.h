@@ -33,6 +33,8 @@ residual(xset xs,     /* set of measurements */
          matrix jp,   /* Jacobian matrix */
          boolean sf,  /* scaling matrix request flag */
          matrix s,    /* scaling matrix */
+         vector ws,   /* warm start state, vectorNIL if none */
+         boolean *wf, /* warm start state is valid */
          inum *mc_r,  /* number of model residual evaluations */
          inum *mc_jx, /* number of model Jacobian_x evaluations */
          inum *mc_jp, /* number of model Jacobian_p evaluations */
@@ -49,6 +51,11 @@ extern boolean new_residual(modres mr,   /* model result structure */
 
 extern void fre_residual(void);
 
+extern void new_residual_work(void);
+extern void fre_residual_work(void);
+
+extern vector new_residual_state(void);
+
 extern void new_pvar(pset ps, /* parameter set with upper and lower bounds */
                      vector *pval, /* scaled values */
                      vector *plow, /* scaled lower bounds */
@@ -22,20 +22,87 @@
 #include "error.h"
 #include "newton.h"
 #include "parx.h"
+#include "prxinter.h"
 #include "simulate.h"
+#include "threads.h"
 #include "vecmat.h"
 
 /*********************** global data ***********************************/
 
-static procedure model_code;   /* model procedure code */
-static moddat model_interface; /* model data interface block */
-static inum_list xtrans;       /* transpose index list */
+static procedure model_code; /* model procedure code */
+static moddat model_main;    /* model data interface block of the caller */
+static inum_list xtrans;     /* transpose index list */
 
 static inum nxv; /* number of unknowns */
 static inum nav; /* number of aux unknowns */
 
+static fnum sim_tol;       /* simulation tolerance */
+static vector sim_aval;    /* values of the internals, for their tolerance */
+static inum sim_maxiter;   /* maximum number of Newton iterations */
+static inum sim_nbroyden;  /* Broyden updates between Jacobians */
+static inum sim_cont;      /* continuation mode */
+
+/*
+ * The points of a group are solved in parallel by a pool of threads, each
+ * with its own model data interface block and Newton workspace. A run of
+ * points, a curve with continuation or else a single point, is solved by
+ * one thread in order, so the solutions do not depend on the number of
+ * threads. The serial loop then reports and regroups the points in list
+ * order.
+ */
+
+static THREAD_POOL *pool; /* worker threads, NULL if serial */
+static xset *sim_pnt;     /* points of the current group */
+static boolean *sim_first; /* point starts a new run */
+static inum *sim_runs;    /* first point of each run, and the end */
+static inum *sim_nr;      /* Newton-Raphson return code of each point */
+static inum *sim_stage;   /* continuation stage of each point */
+static inum *sim_level;   /* step halvings of each point */
+
+#define SIM_DIRECT 0 /* solved without continuation */
+#define SIM_PRED   1 /* solved from the predicted start */
+#define SIM_SUB    2 /* solved by sub-steps */
+#define SIM_COLD   3 /* solved from the measured values */
+
+typedef struct {
+    inum trace; /* trace level */
+} SIM_JOB;
+
+static THREAD_LOCAL moddat model_interface; /* model data interface block */
+
+static THREAD_LOCAL vector w_xvec; /* unknown vector */
+static THREAD_LOCAL vector w_xv;   /* unknown x vector */
+static THREAD_LOCAL vector w_av;   /* unknown a vector */
+static THREAD_LOCAL vector w_abs;  /* absolute error vector */
+static THREAD_LOCAL vector w_rel;  /* relative error vector */
+static THREAD_LOCAL vector w_cold; /* start without continuation */
+
+/* continuation along the curves of a sweep */
+
+#define CONT_SPLIT 4 /* maximum number of step halvings */
+
+static boolvector cont_xf;                /* unknown x elements */
+static THREAD_LOCAL vector cont_rel;      /* initial relative tolerances */
+static THREAD_LOCAL vector cont_abs;      /* initial absolute tolerances */
+static THREAD_LOCAL vector cont_u1; /* unknowns of the last solution on the curve */
+static THREAD_LOCAL vector cont_u2; /* unknowns of the solution before that */
+static THREAD_LOCAL vector cont_s1; /* externals of the last solution */
+static THREAD_LOCAL vector cont_s2; /* externals of the solution before that */
+static THREAD_LOCAL vector cont_u;  /* unknowns of the last sub-step */
+static THREAD_LOCAL inum cont_n; /* number of solutions on the curve, upto 2 */
+
 /***********************************************************************/
 
+static void new_sim_work(void);
+static void fre_sim_work(void);
+static void sim_start(void);
+static void sim_stop(void);
+static void sim_point(inum k, inum trace);
+static void sim_run(void *arg, inum r);
+static void sim_report(inum k, inum trace);
+static void cont_predict(vector s);
+static void cont_stimulus(vector s, fnum t);
+static inum cont_substep(vector s, inum *level, inum trace);
 static void init_x(xset xs, fnum tol, vector xv, vector relerr, vector abserr);
 static void finish_x(xset xs, vector xv, vector relerr, vector abserr);
 static void jx2jxv(matrix jx, matrix jxv);
@@ -44,22 +111,33 @@ static void xs2xv(vector xs, vector xv);
 
 /***********************************************************************/
 
-boolean simulate(numblock numb, fnum tol, inum maxiter, inum trace) {
+/*
+ * Solve the model equations for all x sets. With cont > 0 the points of a
+ * curve, consecutive rows with the same crvid in dc, start from the last
+ * solution on the curve (cont = 1) or from the secant through the last two
+ * solutions (cont = 2). A failed start is retried by stepping the externals
+ * from the last solution in 2, 4, .. 2^CONT_SPLIT parts, and finally from
+ * the measured values as without continuation.
+ */
+
+boolean simulate(numblock numb, datacolumns dc, fnum tol, inum maxiter,
+                 inum nbroyden, inum cont, inum trace) {
     modres mod;            /* model data */
     boolvector xf;         /* variant x elements */
-    vector xvec;           /* unknown vector */
-    vector xv;             /* unknown x vector */
-    vector av;             /* unknown a vector */
-    vector abserr, relerr; /* absolute and relative error vectors */
 
     xgroup xg, xg_invalid; /* x groups */
     xset xs, xs_tmp;       /* current x set */
     xset_list xsv, xsi;    /* lists of valid and invalid x sets */
     inum npoints;          /* number of valid points in group */
     inum nxgv, nxgi;       /* number of valid and invalid x sets */
-    inum nr;               /* Newton-Raphson return code */
-    inum i;
-    TMPRINTSTATE *pst;
+    inum maxpnt;           /* maximum number of points in a group */
+    inum nrun;             /* number of runs in the group */
+    boolean par;           /* solve the runs in parallel */
+    SIM_JOB job;           /* parallel solve */
+    inum r;                /* data row of the current x set */
+    inum crvid;            /* current curve */
+    inum nstage[4];        /* points solved in each continuation stage */
+    inum i, k;
 
     mod = numb->mod;
 
@@ -100,30 +178,51 @@ boolean simulate(numblock numb, fnum tol, inum maxiter, inum trace) {
 
     model_code = mod->model;
 
-    model_interface = numb->modi;
+    model_main = numb->modi;
 
-    copy_vector(numb->p->val, model_interface->p);
-    copy_vector(numb->c->val, model_interface->c);
-    copy_vector(numb->f->val, model_interface->f);
-    model_interface->rf = FALSE;
-    model_interface->jxf = FALSE;
-    model_interface->jpf = FALSE;
+    copy_vector(numb->p->val, model_main->p);
+    copy_vector(numb->c->val, model_main->c);
+    copy_vector(numb->f->val, model_main->f);
+    model_main->rf = FALSE;
+    model_main->jxf = FALSE;
+    model_main->jpf = FALSE;
 
-    xvec = rnew_vector(nxv + nav);
-    xv = new_sub_vector(xvec);
-    sub_vector(xvec, 0, nxv, xv);
-    av = new_sub_vector(xvec);
-    sub_vector(xvec, nxv, nav, av);
+    model_interface = model_main;
 
-    abserr = rnew_vector(nxv + nav);
-    relerr = rnew_vector(nxv + nav);
+    sim_tol = tol;
+    sim_aval = numb->a->val;
+    sim_maxiter = maxiter;
+    sim_nbroyden = nbroyden;
+    sim_cont = cont;
+    cont_xf = xf;
 
-    /* solve equations for all x groups and sets */
+    new_sim_work();
 
-    new_newton(nxv + nav);
+    /* setup threads for the parallel solve of the points */
+
+    for (maxpnt = 1, xg = numb->x; xg != xgroupNIL; xg = xg->next) {
+        maxpnt = MAX(maxpnt, xg->n);
+    }
+
+    sim_pnt = TM_MALLOC(xset *, maxpnt * sizeof(xset));
+    sim_first = TM_MALLOC(boolean *, maxpnt * sizeof(boolean));
+    sim_runs = TM_MALLOC(inum *, (maxpnt + 1) * sizeof(inum));
+    sim_nr = TM_MALLOC(inum *, maxpnt * sizeof(inum));
+    sim_stage = TM_MALLOC(inum *, maxpnt * sizeof(inum));
+    sim_level = TM_MALLOC(inum *, maxpnt * sizeof(inum));
+
+    pool = NULL;
+    if ((trace < 2) && (MIN(thread_count(), maxpnt) > 1)) {
+        pool = new_pool(MIN(thread_count(), maxpnt), sim_start, sim_stop);
+    }
+
+    /* solve equations for all x groups and sets */
 
     xsi = new_xset_list();
     nxgi = 0;
+    nstage[SIM_DIRECT] = nstage[SIM_PRED] = 0;
+    nstage[SIM_SUB] = nstage[SIM_COLD] = 0;
+    crvid = 0;
 
     /* MAIN LOOP */
 
@@ -140,112 +239,63 @@ boolean simulate(numblock numb, fnum tol, inum maxiter, inum trace) {
                     (long)(xg->id), (long)(xg->n));
         }
 
-        xs = xg->g;
-        xsv = new_xset_list();
-        nxgv = 0;
-
-        while (xs != xsetNIL) {
-
-            if (trace >= 1) {
-                fprintf(trace_stream, "\nsim: point %ld\n", (long)(xs->id));
+        /* split the group in runs, the curves with continuation */
+
+        for (k = 0, nrun = 0, xs = xg->g; xs != xsetNIL; xs = xs->next, k++) {
+            sim_pnt[k] = xs;
+            sim_first[k] = TRUE;
+
+            if ((cont > 0) && (dc != datacolumnsNIL)) {
+                r = xs->id - 1; /* row ids are numbered by make_xextgrp */
+                if ((r >= 0) && (r < VECN(dc->crvid))) {
+                    if ((k > 0) && (VEC(dc->crvid, r) == crvid)) {
+                        sim_first[k] = FALSE;
+                    }
+                    crvid = VEC(dc->crvid, r);
+                } else {
+                    crvid = 0;
+                }
             }
-            if (trace >= 3) {
-                pst = tm_setprint(trace_stream, 1, 80, 8, 0);
-                fputs("[val] =\n", trace_stream);
-                print_vector(pst, xs->val);
-                fputs("[err] =\n", trace_stream);
-                print_vector(pst, xs->err);
-                fputs("[abserr] =\n", trace_stream);
-                print_vector(pst, xs->abserr);
-                tm_endprint(pst);
+
+            if (sim_first[k] == TRUE) {
+                sim_runs[nrun++] = k;
             }
+        }
+        sim_runs[nrun] = k;
 
-            copy_vector(xs->val, model_interface->x);
+        par = (pool != NULL) ? TRUE : FALSE;
 
-            /* calculate initial values and accuracies */
+        if (par == TRUE) {
+            job.trace = trace;
+            pool_for(pool, nrun, MAX(nrun / (4 * pool_size(pool)), 1),
+                     sim_run, &job);
+        }
 
-            zero_vector(av); /* no initial value */
+        xs = xg->g;
+        xsv = new_xset_list();
+        nxgv = 0;
 
-            zero_vector(relerr);
-            zero_vector(abserr);
+        for (k = 0; xs != xsetNIL; k++) {
 
-            for (i = 0; i < nav; i++) {
-                VEC(abserr, nxv + i) = fabs(VEC(numb->a->val, i));
-                VEC(relerr, nxv + i) = tol;
+            if (trace >= 1) {
+                fprintf(trace_stream, "\nsim: point %ld\n", (long)(xs->id));
             }
 
-            init_x(xs, tol, xv, relerr, abserr);
-
-            if (trace >= 3) {
-                pst = tm_setprint(trace_stream, 1, 80, 8, 0);
-                fputs("[relerr] =\n", trace_stream);
-                print_vector(pst, relerr);
-                fputs("[abserr] =\n", trace_stream);
-                print_vector(pst, abserr);
-                tm_endprint(pst);
+            if (par == FALSE) {
+                sim_point(k, trace);
             }
 
-            nr = newton_raphson(xvec, relerr, abserr, maxiter, trace - 2);
-
-            /* transfer solution back to x set if valid */
+            sim_report(k, trace);
 
-            if (nr >= 0) {
-                finish_x(xs, xv, relerr, abserr);
-            }
-
-            if (trace >= 2) {
-                pst = tm_setprint(trace_stream, 1, 80, 8, 0);
-                fprintf(trace_stream, "result:\n");
-                if (trace >= 3) {
-                    fputs("[var] =\n", trace_stream);
-                    print_vector(pst, xv);
-                    fputs("[aux] =\n", trace_stream);
-                    print_vector(pst, av);
-                }
-                fputs("[val] =\n", trace_stream);
-                print_vector(pst, xs->val);
-                fputs("[delta] =\n", trace_stream);
-                print_vector(pst, xs->delta);
-                tm_endprint(pst);
-            }
-            if (trace >= 1) {
-                switch (nr) {
-                case 0: /* all is well */
-                    break;
-
-                case 1: /* maybe a valid solution */
-                    fprintf(trace_stream,
-                            "Warning: No better solution can be found\n");
-                    break;
-
-                case -1: /* no valid solution */
-                    fprintf(trace_stream,
-                            "Error: Illegal evaluation of model equations\n");
-                    break;
-                case -2:
-                    fprintf(trace_stream,
-                            "Error: Rate of convergence too slow\n");
-                    break;
-                case -3:
-                    fprintf(trace_stream,
-                            "Error: No search direction can be found\n");
-                    break;
-                case -4:
-                    fprintf(trace_stream,
-                            "Error: No better solution can be found\n");
-                    break;
-                default:
-                    fprintf(trace_stream,
-                            "Error: Unknown error in simulation\n");
-                    break;
-                }
+            if (sim_nr[k] == 0) {
+                nstage[sim_stage[k]]++;
             }
 
             xs_tmp = xs;
             xs = xs->next;          /* goto next, before set is moved */
             xs_tmp->next = xsetNIL; /* change list to element */
 
-            if (nr == 0) { /* move set to valid group */
+            if (sim_nr[k] == 0) { /* move set to valid group */
                 nxgv++;
                 xsv = append_xset_list(xsv, xs_tmp);
             } else { /* move set to invalid group */
@@ -263,7 +313,19 @@ boolean simulate(numblock numb, fnum tol, inum maxiter, inum trace) {
         }
     }
 
-    fre_newton();
+    prx_reportFault();
+
+    if (pool != NULL) {
+        fre_pool(pool);
+        pool = NULL;
+    }
+
+    if ((trace >= 1) && (cont > 0)) {
+        fprintf(trace_stream,
+                "\ncontinuation: predicted %ld, sub-steps %ld, restart %ld\n",
+                (long)nstage[SIM_PRED], (long)nstage[SIM_SUB],
+                (long)nstage[SIM_COLD]);
+    }
 
     /* create a new x group for invalid x sets */
 
@@ -273,12 +335,16 @@ boolean simulate(numblock numb, fnum tol, inum maxiter, inum trace) {
 
     /* clean up data structures */
 
+    fre_sim_work();
+
+    TM_FREE(sim_pnt);
+    TM_FREE(sim_first);
+    TM_FREE(sim_runs);
+    TM_FREE(sim_nr);
+    TM_FREE(sim_stage);
+    TM_FREE(sim_level);
+
     fre_inum_list(xtrans);
-    rfre_vector(xvec);
-    fre_sub_vector(xv);
-    fre_sub_vector(av);
-    rfre_vector(abserr);
-    rfre_vector(relerr);
 
     if (trace >= 1) {
         fflush(trace_stream);
@@ -292,6 +358,365 @@ boolean simulate(numblock numb, fnum tol, inum maxiter, inum trace) {
     return (TRUE);
 }
 
+/* allocate the workspace of the calling thread */
+
+void new_sim_work(void) {
+    w_xvec = rnew_vector(nxv + nav);
+    w_xv = new_sub_vector(w_xvec);
+    sub_vector(w_xvec, 0, nxv, w_xv);
+    w_av = new_sub_vector(w_xvec);
+    sub_vector(w_xvec, nxv, nav, w_av);
+
+    w_abs = rnew_vector(nxv + nav);
+    w_rel = rnew_vector(nxv + nav);
+    w_cold = rnew_vector(nxv + nav);
+
+    cont_rel = rnew_vector(nxv + nav);
+    cont_abs = rnew_vector(nxv + nav);
+    cont_u1 = rnew_vector(nxv + nav);
+    cont_u2 = rnew_vector(nxv + nav);
+    cont_u = rnew_vector(nxv + nav);
+    cont_s1 = rnew_vector(VECN(model_main->x));
+    cont_s2 = rnew_vector(VECN(model_main->x));
+    cont_n = 0;
+
+    new_newton(nxv + nav);
+}
+
+/* free the workspace of the calling thread */
+
+void fre_sim_work(void) {
+    fre_newton();
+
+    rfre_vector(w_xvec);
+    fre_sub_vector(w_xv);
+    fre_sub_vector(w_av);
+    rfre_vector(w_abs);
+    rfre_vector(w_rel);
+    rfre_vector(w_cold);
+
+    rfre_vector(cont_rel);
+    rfre_vector(cont_abs);
+    rfre_vector(cont_u1);
+    rfre_vector(cont_u2);
+    rfre_vector(cont_u);
+    rfre_vector(cont_s1);
+    rfre_vector(cont_s2);
+}
+
+/* worker thread start and stop, with a copy of the model interface block */
+
+void sim_start(void) {
+    moddat mi;
+    boolvector xf, pf;
+    inum i;
+
+    mi = model_main;
+
+    xf = rnew_boolvector(VECN(mi->xf));
+    for (i = 0; i < VECN(xf); i++) {
+        VEC(xf, i) = VEC(mi->xf, i);
+    }
+    pf = rnew_boolvector(VECN(mi->pf));
+    for (i = 0; i < VECN(pf); i++) {
+        VEC(pf, i) = VEC(mi->pf, i);
+    }
+
+    model_interface = new_moddat(
+        rdup_vector(mi->x), rdup_vector(mi->a), rdup_vector(mi->p),
+        rdup_vector(mi->c), rdup_vector(mi->f), FALSE,
+        rnew_vector(VECN(mi->r)), FALSE, xf,
+        rnew_matrix(MATM(mi->jx), MATN(mi->jx)),
+        rnew_matrix(MATM(mi->ja), MATN(mi->ja)), FALSE, pf,
+        rnew_matrix(MATM(mi->jp), MATN(mi->jp)));
+
+    new_sim_work();
+}
+
+void sim_stop(void) {
+    fre_sim_work();
+
+    rfre_moddat(model_interface);
+    model_interface = moddatNIL;
+
+    prx_releaseContext();
+}
+
+/* solve the points of run r */
+
+void sim_run(void *arg, inum r) {
+    SIM_JOB *job;
+    inum k;
+
+    job = (SIM_JOB *)arg;
+
+    for (k = sim_runs[r]; k < sim_runs[r + 1]; k++) {
+        sim_point(k, job->trace);
+    }
+}
+
+/* solve point k of the current group */
+
+void sim_point(inum k, inum trace) {
+    xset xs;
+    inum nr; /* Newton-Raphson return code */
+    inum i;
+    TMPRINTSTATE *pst;
+
+    xs = sim_pnt[k];
+
+    sim_stage[k] = SIM_DIRECT;
+    sim_level[k] = 0;
+
+    if (sim_first[k] == TRUE) {
+        cont_n = 0; /* new curve */
+    }
+
+    if (trace >= 3) {
+        pst = tm_setprint(trace_stream, 1, 80, 8, 0);
+        fputs("[val] =\n", trace_stream);
+        print_vector(pst, xs->val);
+        fputs("[err] =\n", trace_stream);
+        print_vector(pst, xs->err);
+        fputs("[abserr] =\n", trace_stream);
+        print_vector(pst, xs->abserr);
+        tm_endprint(pst);
+    }
+
+    copy_vector(xs->val, model_interface->x);
+
+    /* calculate initial values and accuracies */
+
+    zero_vector(w_av); /* no initial value */
+
+    zero_vector(w_rel);
+    zero_vector(w_abs);
+
+    for (i = 0; i < nav; i++) {
+        VEC(w_abs, nxv + i) = fabs(VEC(sim_aval, i));
+        VEC(w_rel, nxv + i) = sim_tol;
+    }
+
+    init_x(xs, sim_tol, w_xv, w_rel, w_abs);
+
+    if (trace >= 3) {
+        pst = tm_setprint(trace_stream, 1, 80, 8, 0);
+        fputs("[relerr] =\n", trace_stream);
+        print_vector(pst, w_rel);
+        fputs("[abserr] =\n", trace_stream);
+        print_vector(pst, w_abs);
+        tm_endprint(pst);
+    }
+
+    /* continue along the curve of the previous point */
+
+    if (cont_n > 0) {
+        copy_vector(w_xvec, w_cold);
+        copy_vector(w_rel, cont_rel);
+        copy_vector(w_abs, cont_abs);
+
+        cont_predict(xs->val);
+
+        nr = newton_raphson(w_xvec, w_rel, w_abs, sim_maxiter, sim_nbroyden,
+                            trace - 2);
+        sim_stage[k] = SIM_PRED;
+
+        if (nr != 0) {
+            nr = cont_substep(xs->val, sim_level + k, trace);
+            sim_stage[k] = SIM_SUB;
+        }
+
+        if (nr != 0) { /* start from the measured values */
+            copy_vector(xs->val, model_interface->x);
+            copy_vector(w_cold, w_xvec);
+            copy_vector(cont_rel, w_rel);
+            copy_vector(cont_abs, w_abs);
+            nr = newton_raphson(w_xvec, w_rel, w_abs, sim_maxiter,
+                                sim_nbroyden, trace - 2);
+            sim_stage[k] = SIM_COLD;
+        }
+    } else {
+        nr = newton_raphson(w_xvec, w_rel, w_abs, sim_maxiter, sim_nbroyden,
+                            trace - 2);
+    }
+
+    /* transfer solution back to x set if valid */
+
+    if (nr >= 0) {
+        finish_x(xs, w_xv, w_rel, w_abs);
+    }
+
+    if ((nr == 0) && (sim_cont > 0)) {
+        copy_vector(cont_u1, cont_u2);
+        copy_vector(cont_s1, cont_s2);
+        copy_vector(w_xvec, cont_u1);
+        copy_vector(xs->val, cont_s1);
+        cont_n = MIN(cont_n + 1, 2);
+    }
+
+    if (trace >= 2) {
+        pst = tm_setprint(trace_stream, 1, 80, 8, 0);
+        fprintf(trace_stream, "result:\n");
+        if (trace >= 3) {
+            fputs("[var] =\n", trace_stream);
+            print_vector(pst, w_xv);
+            fputs("[aux] =\n", trace_stream);
+            print_vector(pst, w_av);
+        }
+        fputs("[val] =\n", trace_stream);
+        print_vector(pst, xs->val);
+        fputs("[delta] =\n", trace_stream);
+        print_vector(pst, xs->delta);
+        tm_endprint(pst);
+    }
+
+    sim_nr[k] = nr;
+}
+
+/* report the solution of point k of the current group */
+
+void sim_report(inum k, inum trace) {
+    inum level;
+
+    if (trace < 1) {
+        return;
+    }
+
+    if (sim_stage[k] >= SIM_SUB) {
+        fputs("sim: continuation by sub-steps\n", trace_stream);
+        for (level = 1; level <= sim_level[k]; level++) {
+            fprintf(trace_stream, "sim: %ld sub-steps, %s\n", 1L << level,
+                    ((sim_stage[k] == SIM_SUB) && (level == sim_level[k]))
+                        ? "converged"
+                        : "failed");
+        }
+    }
+    if (sim_stage[k] == SIM_COLD) {
+        fputs("sim: continuation failed\n", trace_stream);
+    }
+
+    switch (sim_nr[k]) {
+    case 0: /* all is well */
+        break;
+
+    case 1: /* maybe a valid solution */
+        fprintf(trace_stream, "Warning: No better solution can be found\n");
+        break;
+
+    case -1: /* no valid solution */
+        fprintf(trace_stream,
+                "Error: Illegal evaluation of model equations\n");
+        break;
+    case -2:
+        fprintf(trace_stream, "Error: Rate of convergence too slow\n");
+        break;
+    case -3:
+        fprintf(trace_stream, "Error: No search direction can be found\n");
+        break;
+    case -4:
+        fprintf(trace_stream, "Error: No better solution can be found\n");
+        break;
+    default:
+        fprintf(trace_stream, "Error: Unknown error in simulation\n");
+        break;
+    }
+}
+
+/*
+ * Predict the unknowns at externals s from the last solutions on the curve.
+ * The secant is scaled by the projection of the step in the known externals
+ * on the previous step.
+ */
+
+void cont_predict(vector s) {
+    fnum ds, ds1, num, den, t;
+    inum i;
+
+    t = 0.0;
+
+    if ((sim_cont >= 2) && (cont_n >= 2)) {
+        num = den = 0.0;
+        for (i = 0; i < VECN(s); i++) {
+            if (VEC(cont_xf, i) == FALSE) {
+                ds = VEC(s, i) - VEC(cont_s1, i);
+                ds1 = VEC(cont_s1, i) - VEC(cont_s2, i);
+                num += ds * ds1;
+                den += ds1 * ds1;
+            }
+        }
+        t = (den > 0.0) ? num / den : 0.0;
+    }
+
+    for (i = 0; i < VECN(w_xvec); i++) {
+        VEC(w_xvec, i) =
+            VEC(cont_u1, i) + t * (VEC(cont_u1, i) - VEC(cont_u2, i));
+    }
+}
+
+/* set the known externals of the model to a fraction t of the step to s */
+
+void cont_stimulus(vector s, fnum t) {
+    inum i;
+
+    for (i = 0; i < VECN(s); i++) {
+        if (VEC(cont_xf, i) == FALSE) {
+            VEC(model_interface->x, i) =
+                VEC(cont_s1, i) + t * (VEC(s, i) - VEC(cont_s1, i));
+        }
+    }
+}
+
+/* solve at externals s by equal sub-steps from the last solution */
+
+inum cont_substep(vector s, inum *level, inum trace) {
+    inum nstep, j, i;
+    inum nr;
+    fnum u;
+
+    nr = -1;
+
+    for (*level = 1; *level <= CONT_SPLIT; (*level)++) {
+
+        nstep = 1L << *level;
+
+        copy_vector(cont_u1, w_xvec);
+        copy_vector(cont_u1, cont_u);
+
+        for (j = 1; j <= nstep; j++) {
+
+            /* secant through the last two sub-step solutions */
+
+            if ((sim_cont >= 2) && (j > 1)) {
+                for (i = 0; i < VECN(w_xvec); i++) {
+                    u = VEC(w_xvec, i);
+                    VEC(w_xvec, i) = 2.0 * u - VEC(cont_u, i);
+                    VEC(cont_u, i) = u;
+                }
+            }
+
+            cont_stimulus(s, (fnum)j / (fnum)nstep);
+
+            copy_vector(cont_rel, w_rel);
+            copy_vector(cont_abs, w_abs);
+
+            nr = newton_raphson(w_xvec, w_rel, w_abs, sim_maxiter,
+                                sim_nbroyden, trace - 2);
+
+            if (nr != 0) {
+                break;
+            }
+        }
+
+        if (nr == 0) {
+            break;
+        }
+    }
+
+    *level = MIN(*level, CONT_SPLIT);
+
+    return (nr);
+}
+
 /* calculate the value and absolute and relative tolerances for unknown x */
 
 void init_x(xset xs, fnum tol, vector xv, vector relerr, vector abserr) {
@@ -25,7 +25,8 @@
 #include "numdat.h"
 #include "primtype.h"
 
-extern boolean simulate(numblock numb, fnum tol, inum maxiter, inum trace);
+extern boolean simulate(numblock numb, datacolumns dc, fnum tol,
+                        inum maxiter, inum nbroyden, inum cont, inum trace);
 
 extern boolean sim_constraints(vector x,     /* variable vector */
                                boolean *rf,  /* want residuals? */
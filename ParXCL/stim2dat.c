@@ -23,7 +23,7 @@
 #include "stim2dat.h"
 
 static colhead_list makeheader(stimtemplate_list st, modeltemplate mt);
-static datarow_list makedata(colhead_list header, stimtemplate_list st);
+static datacolumns makedata(colhead_list header, stimtemplate_list st);
 static boolean teststim(stimtemplate_list st);
 static boolean test_setup(stimtemplate st);
 
@@ -32,7 +32,7 @@ static boolean test_setup(stimtemplate st);
 datatemplate stim2dat(stimtemplate_list st, modeltemplate mt) {
     datatemplate dt;
     colhead_list header;
-    datarow_list dat;
+    datacolumns dat;
 
     dt = datatemplateNIL;
 
@@ -169,20 +169,22 @@ boolean test_setup(stimtemplate st) {
 
 /* first column changes fastest                                */
 
-datarow_list makedata(colhead_list header, stimtemplate_list st) {
+datacolumns makedata(colhead_list header, stimtemplate_list st) {
     stimtemplate_list s;
     colhead_list h;
-    datarow_list data, dr;
+    datacolumns data;
 
-    inum np;
+    inum np, nc;
     fnum lowerb, upperb, step, val;
-    inum i, n, rep, same, sig, crvid;
+    inum i, j, n, rep, same, sig, crvid;
 
     /* calculate the number of data points */
 
     np = 0; /* number of points */
+    nc = 0; /* number of columns */
 
     for (h = header; h != colheadNIL; h = h->next) {
+        nc++;
 
         if ((h->type == STIM) || (h->type == SWEEP)) {
             s = find_stim(st, h->name);
@@ -195,26 +197,23 @@ datarow_list makedata(colhead_list header, stimtemplate_list st) {
         }
     }
 
-    /* create data table */
+    /* create data table, all entries are zero */
 
-    data = new_datarow_list();
+    data = rnew_datacolumns(np, nc);
 
-    for (i = 1; i <= np; i++) {
-        data = append_datarow_list(
-            data, new_datarow(0, 1, i, new_fnum_list(), new_fnum_list()));
+    for (i = 0; i < np; i++) {
+        VEC(data->grpid, i) = 0;
+        VEC(data->crvid, i) = 1;
+        VEC(data->rowid, i) = i + 1;
     }
 
     rep = 0; /* number of times one value is repeated in a column */
 
     /* fill all columns, from left to right */
 
-    for (h = header; h != colheadNIL; h = h->next) {
+    for (h = header, j = 0; h != colheadNIL; h = h->next, j++) {
 
         if (h->type == UNKN) { /* skip unknown externals */
-            for (dr = data; dr != datarowNIL; dr = dr->next) {
-                dr->row = append_fnum_list(dr->row, 0.0);
-                dr->err = append_fnum_list(dr->err, 0.0);
-            }
             continue;
         }
 
@@ -257,7 +256,7 @@ datarow_list makedata(colhead_list header, stimtemplate_list st) {
         n = 0;
         crvid = 1;
 
-        for (dr = data; dr != datarowNIL; dr = dr->next) {
+        for (i = 0; i < np; i++) {
 
             switch (s->scale) { /* un-scale */
             case SLIN:
@@ -275,10 +274,9 @@ datarow_list makedata(colhead_list header, stimtemplate_list st) {
                 val = sig > 0 ? val : -val;
                 break;
             }
-            dr->row = append_fnum_list(dr->row, val);
-            dr->err = append_fnum_list(dr->err, 0.0);
+            MAT(data->val, i, j) = val;
             if (rep == 0) {
-                dr->crvid = crvid;
+                VEC(data->crvid, i) = crvid;
             }
 
             if (++same >= rep) {
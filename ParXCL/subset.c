@@ -22,11 +22,6 @@
 #include "parx.h"
 #include "subset.h"
 
-typedef struct _indextab { /* index table to data rows */
-    datarow dr;
-    boolean del; /* deleted ? */
-} indextab;
-
 datatemplate subset_data(meastemplate_list meast, datatemplate datat) {
     meastemplate_list ml;
     inum mtype;
@@ -36,13 +31,12 @@ datatemplate subset_data(meastemplate_list meast, datatemplate datat) {
     inum msubs;
     colhead_list h;
     inum ix;
-    datarow dr;
-    inum nr, delnr, i;
-    indextab *idx;
+    datacolumns dc, s_dc;
+    fnum *col;
+    inum nr, delnr, i, j, r;
+    boolean *del; /* deleted ? */
     tmstring si, s_info;
     colhead_list s_head;
-    datarow_list s_data;
-    datarow n_data, l_data;
 
     /* get the index of all externals */
 
@@ -77,19 +71,13 @@ datatemplate subset_data(meastemplate_list meast, datatemplate datat) {
         }
     }
 
-    dr = datat->data;
-
-    for (nr = 0; dr != datarowNIL; nr++, dr = dr->next)
-        ; /* count the points */
+    dc = datat->data;
+    nr = MATM(dc->val); /* the number of points */
 
-    idx =
-        TM_MALLOC(indextab *, nr * sizeof(indextab)); /* allocate index table */
+    del = TM_MALLOC(boolean *, MAX(nr, 1) * sizeof(boolean));
 
-    dr = datat->data;
-
-    for (i = 0; dr != datarowNIL; i++, dr = dr->next) { /* initialize index */
-        idx[i].del = FALSE;
-        idx[i].dr = dr;
+    for (i = 0; i < nr; i++) { /* initialize deletion flags */
+        del[i] = FALSE;
     }
 
     for (ml = meast; ml != meastemplateNIL; ml = ml->next) { /* select points */
@@ -110,59 +98,54 @@ datatemplate subset_data(meastemplate_list meast, datatemplate datat) {
             muvali = roundi(muval);
         }
 
-        for (i = 0; i < nr; i++) { /* for all data rows */
-
-            if (idx[i].del == TRUE) {
-                continue;
-            } /* already deleted */
-
-            if (mtype == 0) { /* group id */
-                idx[i].del = ((idx[i].dr)->grpid < mlvali) ? TRUE : idx[i].del;
-                idx[i].del = ((idx[i].dr)->grpid > muvali) ? TRUE : idx[i].del;
+        if (mtype == 0) { /* group id */
+            for (i = 0; i < nr; i++) {
+                del[i] = (VEC(dc->grpid, i) < mlvali) ? TRUE : del[i];
+                del[i] = (VEC(dc->grpid, i) > muvali) ? TRUE : del[i];
             }
+        }
 
-            if (mtype > 0) { /* curve id */
-                idx[i].del =
-                    (((idx[i].dr)->crvid) < mlvali) ? TRUE : idx[i].del;
-                idx[i].del =
-                    (((idx[i].dr)->crvid) > muvali) ? TRUE : idx[i].del;
-                idx[i].del =
-                    (((((idx[i].dr)->crvid)) % msubs) != 0) ? TRUE : idx[i].del;
+        if (mtype > 0) { /* curve id */
+            for (i = 0; i < nr; i++) {
+                del[i] = (VEC(dc->crvid, i) < mlvali) ? TRUE : del[i];
+                del[i] = (VEC(dc->crvid, i) > muvali) ? TRUE : del[i];
+                del[i] = ((VEC(dc->crvid, i) % msubs) != 0) ? TRUE : del[i];
             }
+        }
 
-            if (mtype < 0) { /* external */
-                idx[i].del = ((LST((idx[i].dr)->row, -mtype - 1)) < mlval)
-                                 ? TRUE
-                                 : idx[i].del;
-                idx[i].del = ((LST((idx[i].dr)->row, -mtype - 1)) > muval)
-                                 ? TRUE
-                                 : idx[i].del;
+        if (mtype < 0) { /* external, scan its column */
+            col = MATP(dc->val, 0, -mtype - 1);
+            for (i = 0; i < nr; i++) {
+                del[i] = (col[i] < mlval) ? TRUE : del[i];
+                del[i] = (col[i] > muval) ? TRUE : del[i];
             }
         }
     }
 
-    s_data = new_datarow_list();
-    l_data = s_data;
-
-    for (i = 0, delnr = 0; i < nr; i++) { /* for all data rows */
-
-        if (idx[i].del == TRUE) {
-            delnr++;
-            continue;
-        }
+    for (i = 0, delnr = 0; i < nr; i++) {
+        delnr += (del[i] == TRUE) ? 1 : 0;
+    }
 
-        /* add to new data list */
+    /* copy the selected rows, column by column */
 
-        n_data = rdup_datarow(idx[i].dr);
-        n_data->next = datarow_listNIL;
+    s_dc = rnew_datacolumns(nr - delnr, MATN(dc->val));
 
-        if (s_data == datarow_listNIL) {
-            s_data = n_data;
-        } else {
-            l_data->next = n_data;
+    for (i = 0, r = 0; i < nr; i++) {
+        if (del[i] == FALSE) {
+            VEC(s_dc->grpid, r) = VEC(dc->grpid, i);
+            VEC(s_dc->crvid, r) = VEC(dc->crvid, i);
+            VEC(s_dc->rowid, r) = VEC(dc->rowid, i);
+            r++;
+        }
+    }
+    for (j = 0; j < MATN(dc->val); j++) {
+        for (i = 0, r = 0; i < nr; i++) {
+            if (del[i] == FALSE) {
+                MAT(s_dc->val, r, j) = MAT(dc->val, i, j);
+                MAT(s_dc->err, r, j) = MAT(dc->err, i, j);
+                r++;
+            }
         }
-
-        l_data = n_data;
     }
 
     if ((nr - delnr) != nr) {
@@ -170,7 +153,7 @@ datatemplate subset_data(meastemplate_list meast, datatemplate datat) {
                 (long)(nr - delnr), (long)nr);
     }
 
-    TM_FREE(idx); /* free the index table */
+    TM_FREE(del); /* free the deletion flags */
 
     si = TM_MALLOC(char *, (strlen(datat->info) + 13) * sizeof(char));
     si = strcpy(si, ((nr - delnr) != nr) ? "Subset of : " : "");
@@ -179,5 +162,5 @@ datatemplate subset_data(meastemplate_list meast, datatemplate datat) {
 
     s_head = rdup_colhead_list(datat->header);
 
-    return new_datatemplate(s_info, s_head, s_data);
+    return new_datatemplate(s_info, s_head, s_dc);
 }
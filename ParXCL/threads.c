@@ -0,0 +1,231 @@
+/*
+ * ParX - threads.c
+ * Pool of worker threads for data parallel loops
+ *
+ * Copyright (c) 2026 M.G.Middelhoek <martin@middelhoek.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "parx.h"
+#include "threads.h"
+
+#include <pthread.h>
+
+#if defined(WINDOWS) || defined(WIN32) || defined(WIN64)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+int parx_threads = 0; /* number of threads, 0: one per processor */
+
+struct THREAD_POOL_S {
+    inum n;                /* number of threads, the caller included */
+    pthread_t *tid;        /* extra threads */
+    pthread_mutex_t lock;  /* guards the fields below */
+    pthread_cond_t work;   /* a new loop is started */
+    pthread_cond_t done;   /* a thread is ready or finished its part */
+    long gen;              /* loop generation */
+    boolean quit;          /* threads should end */
+    inum ready;            /* threads started */
+    inum busy;             /* threads still working on the loop */
+    void (*start)(void);   /* thread start procedure */
+    void (*stop)(void);    /* thread end procedure */
+    void (*body)(void *arg, inum i); /* loop body */
+    void *arg;             /* loop body argument */
+    inum nloop;            /* loop count */
+    inum chunk;            /* indices per chunk */
+    inum next;             /* next index to hand out */
+};
+
+/* start and stop procedures of all pools run one at a time */
+static pthread_mutex_t hook_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/***********************************************************************/
+
+inum thread_count(void) {
+    long n;
+
+    if (parx_threads > 0) {
+        return ((inum)parx_threads);
+    }
+#if defined(WINDOWS) || defined(WIN32) || defined(WIN64)
+    {
+        SYSTEM_INFO si;
+
+        GetSystemInfo(&si);
+        n = (long)si.dwNumberOfProcessors;
+    }
+#elif defined(_SC_NPROCESSORS_ONLN)
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    n = 1;
+#endif
+    return ((n > 1) ? (inum)n : 1);
+}
+
+/* run chunks of the current loop until all are handed out */
+
+static void pool_run(THREAD_POOL *pool) {
+    inum i, first, last;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        first = pool->next;
+        last = MIN(first + pool->chunk, pool->nloop);
+        pool->next = last;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (first >= last) {
+            break;
+        }
+        for (i = first; i < last; i++) {
+            (*pool->body)(pool->arg, i);
+        }
+    }
+}
+
+static void *pool_thread(void *arg) {
+    THREAD_POOL *pool;
+    long gen;
+
+    pool = (THREAD_POOL *)arg;
+
+    pthread_mutex_lock(&hook_lock);
+    if (pool->start != NULL) {
+        (*pool->start)();
+    }
+    pthread_mutex_unlock(&hook_lock);
+
+    pthread_mutex_lock(&pool->lock);
+    gen = pool->gen;
+    pool->ready++;
+    pthread_cond_signal(&pool->done);
+
+    for (;;) {
+        while ((pool->gen == gen) && (pool->quit == FALSE)) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->quit == TRUE) {
+            break;
+        }
+        gen = pool->gen;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool_run(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_mutex_lock(&hook_lock);
+    if (pool->stop != NULL) {
+        (*pool->stop)();
+    }
+    pthread_mutex_unlock(&hook_lock);
+
+    return (NULL);
+}
+
+THREAD_POOL *new_pool(inum n, void (*start)(void), void (*stop)(void)) {
+    THREAD_POOL *pool;
+    inum i;
+
+    pool = TM_MALLOC(THREAD_POOL *, sizeof(THREAD_POOL));
+    pool->tid = TM_MALLOC(pthread_t *, MAX(n, 1) * sizeof(pthread_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->gen = 0;
+    pool->quit = FALSE;
+    pool->ready = 0;
+    pool->busy = 0;
+    pool->start = start;
+    pool->stop = stop;
+    pool->nloop = pool->next = 0;
+    pool->chunk = 1;
+    pool->n = 1;
+
+    /* start the threads one by one, a failed start limits the pool */
+
+    for (i = 1; i < n; i++) {
+        if (pthread_create(&pool->tid[i - 1], NULL, pool_thread, pool) != 0) {
+            break;
+        }
+        pthread_mutex_lock(&pool->lock);
+        while (pool->ready < i) {
+            pthread_cond_wait(&pool->done, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+        pool->n++;
+    }
+
+    return (pool);
+}
+
+inum pool_size(THREAD_POOL *pool) { return (pool->n); }
+
+void pool_for(THREAD_POOL *pool, inum n, inum chunk,
+              void (*body)(void *arg, inum i), void *arg) {
+
+    if (n <= 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->body = body;
+    pool->arg = arg;
+    pool->nloop = n;
+    pool->chunk = MAX(chunk, 1);
+    pool->next = 0;
+    pool->busy = pool->n - 1;
+    pool->gen++;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    pool_run(pool); /* the caller takes part */
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void fre_pool(THREAD_POOL *pool) {
+    inum i;
+
+    if (pool == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = TRUE;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->n - 1; i++) {
+        pthread_join(pool->tid[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+    pthread_mutex_destroy(&pool->lock);
+    TM_FREE(pool->tid);
+    TM_FREE(pool);
+}
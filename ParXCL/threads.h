@@ -0,0 +1,50 @@
+/*
+ * ParX - threads.h
+ * Pool of worker threads for data parallel loops
+ *
+ * Copyright (c) 2026 M.G.Middelhoek <martin@middelhoek.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __THREADS_H
+#define __THREADS_H
+
+#include "primtype.h"
+
+typedef struct THREAD_POOL_S THREAD_POOL;
+
+/* number of threads to use, from parx_threads or the processor count */
+extern inum thread_count(void);
+
+/*
+ * Start a pool of n threads, the calling thread included. The start and stop
+ * procedures, which may be NULL, run in each extra thread when it starts and
+ * when it ends, one thread at a time, so they may allocate and free data.
+ */
+extern THREAD_POOL *new_pool(inum n, void (*start)(void), void (*stop)(void));
+
+extern inum pool_size(THREAD_POOL *pool);
+
+/*
+ * Call body(arg, i) for i = 0 .. n-1 on all threads of the pool, handing
+ * out chunks of indices, and return when all calls are done. The indices of
+ * a chunk, i / chunk, are done by one thread in increasing order.
+ */
+extern void pool_for(THREAD_POOL *pool, inum n, inum chunk,
+                     void (*body)(void *arg, inum i), void *arg);
+
+extern void fre_pool(THREAD_POOL *pool);
+
+#endif
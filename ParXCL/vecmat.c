@@ -36,13 +36,13 @@
  * match de integer and double types used by BLAS and LAPACK
  */
 
-/* manage workspace */
+/* manage workspace, each thread that calls new_vecmat has its own */
 
 #define FWORK_MIN 4096
 #define IWORK_MIN 4096
 
-static vector fnum_wrk;     /* global fnum workspace */
-static inumvector inum_wrk; /* global inum workspace */
+static THREAD_LOCAL vector fnum_wrk;     /* fnum workspace */
+static THREAD_LOCAL inumvector inum_wrk; /* inum workspace */
 
 void new_vecmat(inum m, inum n) {
     inum sizef, sizei;
@@ -646,3 +646,55 @@ boolean cholesky(matrix a, matrix x, matrix b) {
 
     return (TRUE);
 }
+
+/*
+ * update the upper triangular factor R of a QR decomposition with the rows
+ * of B, such that Rt.R + Bt.B is replaced by Rt.R, B is destroyed
+ */
+
+void qr_addrows(matrix r, matrix b) {
+    inum i, j, k, m, n;
+    fnum rjj, vtv, alpha, v0, s;
+
+#ifdef RANGECHECK
+    assert(MATM(r) == MATN(r));
+    assert(MATN(r) == MATN(b));
+#endif
+
+    m = MATM(b);
+    n = MATN(r);
+
+    for (j = 0; j < n; j++) { /* Householder reflection of column j */
+
+        rjj = MAT(r, j, j);
+
+        for (vtv = 0.0, i = 0; i < m; i++) {
+            vtv += MAT(b, i, j) * MAT(b, i, j);
+        }
+        if (vtv == 0.0) { /* column already reduced */
+            continue;
+        }
+
+        alpha = (rjj > 0.0) ? -sqrt(rjj * rjj + vtv) : sqrt(rjj * rjj + vtv);
+        v0 = rjj - alpha;
+        vtv += v0 * v0;
+
+        for (k = j + 1; k < n; k++) {
+            s = v0 * MAT(r, j, k);
+            for (i = 0; i < m; i++) {
+                s += MAT(b, i, j) * MAT(b, i, k);
+            }
+            s *= 2.0 / vtv;
+
+            MAT(r, j, k) -= s * v0;
+            for (i = 0; i < m; i++) {
+                MAT(b, i, k) -= s * MAT(b, i, j);
+            }
+        }
+
+        MAT(r, j, j) = alpha;
+        for (i = 0; i < m; i++) {
+            MAT(b, i, j) = 0.0;
+        }
+    }
+}
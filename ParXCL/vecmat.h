@@ -52,5 +52,6 @@ extern boolean crout(matrix a, vector x, vector b);
 extern boolean solvesym_v(matrix a, vector x, vector b);
 extern boolean solvesym_m(matrix a, matrix x, matrix b);
 extern boolean cholesky(matrix a, matrix x, matrix b);
+extern void qr_addrows(matrix r, matrix b);
 
 #endif